@@ -0,0 +1,17 @@
+# - Try to find liburing, the io_uring helper library of Linux
+# Once done this will define
+#  LIBURING_FOUND - System has liburing
+#  LIBURING_INCLUDE_DIR - The liburing include directory
+#  LIBURING_LIBRARY - The library needed to use liburing
+
+find_path(LIBURING_INCLUDE_DIR liburing.h)
+
+find_library(LIBURING_LIBRARY NAMES uring liburing)
+
+include(FindPackageHandleStandardArgs)
+# handle the QUIETLY and REQUIRED arguments and set LIBURING_FOUND to TRUE
+# if all listed variables are TRUE
+find_package_handle_standard_args(LibUring  DEFAULT_MSG
+	LIBURING_LIBRARY LIBURING_INCLUDE_DIR)
+
+mark_as_advanced(LIBURING_INCLUDE_DIR LIBURING_LIBRARY )
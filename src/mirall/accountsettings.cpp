@@ -49,6 +49,19 @@ static const char progressBarStyleC[] =
         "background-color: %1; width: 1px;"
         "}";
 
+// progress events are coalesced and displayed at most this often
+static const int progressFlushMsec = 250;
+// how long the progress of a finished sync stays visible
+static const int hideProgressMsec = 5000;
+
+static void setDataIfChanged( QStandardItem *item, const QVariant& value, int role )
+{
+    // spares the view a repaint of the row for unchanged roles.
+    if( item->data(role) != value ) {
+        item->setData(value, role);
+    }
+}
+
 AccountSettings::AccountSettings(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::AccountSettings),
@@ -99,6 +112,17 @@ AccountSettings::AccountSettings(QWidget *parent) :
 
     ui->connectLabel->setWordWrap( true );
 
+    _progressTimer = new QTimer(this);
+    _progressTimer->setSingleShot(true);
+    _progressTimer->setInterval(progressFlushMsec);
+    connect(_progressTimer, SIGNAL(timeout()), SLOT(slotFlushProgress()));
+
+    // one timer for all folders, it only runs while progress is shown.
+    _hideProgressTimer = new QTimer(this);
+    _hideProgressTimer->setInterval(1000);
+    connect(_hideProgressTimer, SIGNAL(timeout()), SLOT(slotHideProgress()));
+    _progressClock.start();
+
     setFolderList(FolderMan::instance()->map());
 
     slotCheckConnection();
@@ -287,17 +311,10 @@ void AccountSettings::slotRemoveCurrentFolder()
             if( ret == QMessageBox::No ) {
                 return;
             }
-            /* Remove the selected item from the timer hash. */
-            QStandardItem *item = NULL;
-            if( selected.isValid() )
-                item = _model->itemFromIndex(selected);
-
-            if( selected.isValid() && item && _hideProgressTimers.contains(item) ) {
-                QTimer *t = _hideProgressTimers[item];
-                t->stop();
-                _hideProgressTimers.remove(item);
-                delete(t);
-            }
+            /* Forget the progress of the folder. */
+            _hideProgressAt.remove(alias);
+            _pendingProgress.remove(alias);
+            _kindContext.remove(alias);
 
             FolderMan *folderMan = FolderMan::instance();
             folderMan->slotRemoveFolder( alias );
@@ -376,11 +393,10 @@ void AccountSettings::setFolderList( const Folder::Map &folders )
 {
     _model->clear();
 
-    foreach(QTimer *t, _hideProgressTimers) {
-        t->stop();
-        delete t;
-    }
-    _hideProgressTimers.clear();
+    _hideProgressAt.clear();
+    _hideProgressTimer->stop();
+    _pendingProgress.clear();
+    _progressTimer->stop();
 
     foreach( Folder *f, folders ) {
         slotAddFolder( f );
@@ -610,11 +626,7 @@ void AccountSettings::slotProgressProblem(const QString& folder, const Progress:
 void AccountSettings::slotSetProgress(const QString& folder, const Progress::Info &progress )
 {
     // qDebug() << "================================> Progress for folder " << folder << " progress " << Progress::asResultString(progress.kind);
-    QStandardItem *item = itemForFolder( folder );
-    qint64 prog1 = progress.current_file_bytes;
-    qint64 prog2 = progress.file_size;
-
-    if( item == NULL ) {
+    if( folder.isEmpty() ) {
         return;
     }
 
@@ -629,129 +641,147 @@ void AccountSettings::slotSetProgress(const QString& folder, const Progress::Inf
         return;
     }
 
+    // stay with the previous kind for Context.
+    if( progress.kind != Progress::Context ) {
+        _kindContext.insert(folder, progress.kind);
+    }
+
+    switch( progress.kind ) {
+    case Progress::StartSync:
+        if( QStandardItem *item = itemForFolder( folder ) ) {
+            item->setData( QVariant(0), FolderStatusDelegate::WarningCount );
+        }
+        break;
+    case Progress::StartDownload:
+    case Progress::StartUpload:
+    case Progress::StartDelete:
+        // the progress of the previous sync is still shown.
+        _hideProgressAt.remove(folder);
+        break;
+    case Progress::EndSync:
+        _hideProgressAt.insert(folder, _progressClock.elapsed() + hideProgressMsec);
+        if( !_hideProgressTimer->isActive() ) {
+            _hideProgressTimer->start();
+        }
+        break;
+    default:
+        break;
+    }
+
+    // only the latest snapshot of each folder gets displayed.
+    _pendingProgress.insert(folder, progress);
+    if( progress.kind == Progress::EndSync ) {
+        slotFlushProgress();
+    } else if( !_progressTimer->isActive() ) {
+        _progressTimer->start();
+    }
+}
+
+void AccountSettings::slotFlushProgress()
+{
+    _progressTimer->stop();
+
+    QHash<QString, Progress::Info>::const_iterator it = _pendingProgress.constBegin();
+    for( ; it != _pendingProgress.constEnd(); ++it ) {
+        QStandardItem *item = itemForFolder( it.key() );
+        if( item ) {
+            showProgress( item, it.key(), it.value() );
+        }
+    }
+    _pendingProgress.clear();
+}
+
+void AccountSettings::showProgress(QStandardItem *item, const QString& folder, const Progress::Info& progress)
+{
     QString itemFileName = shortenFilename(folder, progress.current_file);
     QString syncFileProgressString;
 
-    // stay with the previous kind-string for Context.
-    if( progress.kind != Progress::Context ) {
-        _kindContext = Progress::asActionString(progress.kind);
-    } else {
-        if( _kindContext.isEmpty() ) {
-            // empty kind context means that the dialog was opened after the action
+    Progress::Kind kind = progress.kind;
+    if( kind == Progress::Context ) {
+        kind = _kindContext.value(folder, Progress::Invalid);
+        if( kind == Progress::Invalid ) {
+            // no kind context means that the dialog was opened after the action
             // was started.
-            Progress::Kind kind = ProgressDispatcher::instance()->currentFolderContext(progress.folder);
-            if( kind != Progress::Invalid ) {
-                _kindContext = Progress::asActionString(kind);
-            }
+            kind = ProgressDispatcher::instance()->currentFolderContext(progress.folder);
         }
     }
-    QString kindString = _kindContext;
+    QString kindString;
+    if( kind != Progress::Invalid ) {
+        kindString = Progress::asActionString(kind);
+    }
 
     switch( progress.kind ) {
-    case Progress::StartSync:
-        item->setData( QVariant(0), FolderStatusDelegate::WarningCount );
-        break;
     case Progress::StartDownload:
     case Progress::StartUpload:
     case Progress::StartDelete:
         syncFileProgressString = tr("Start");
-        if( _hideProgressTimers.contains(item) ) {
-            // The timer is still running.
-            QTimer *t = _hideProgressTimers.take(item);
-            t->stop();
-            t->deleteLater();
-        }
         break;
     case Progress::Context:
         syncFileProgressString = tr("Currently");
         break;
-    case Progress::EndDownload:
-    case Progress::EndUpload:
-    case Progress::EndDelete:
-        break;
     case Progress::EndSync:
         syncFileProgressString = tr("Completely");
-
-        // start a timer to stop the progress display
-        QTimer *timer;
-        if( _hideProgressTimers.contains(item) ) {
-            timer = _hideProgressTimers[item];
-            // there is already one timer running.
-        } else {
-            timer = new QTimer;
-            connect(timer, SIGNAL(timeout()), this, SLOT(slotHideProgress()));
-            timer->setSingleShot(true);
-            _hideProgressTimers.insert(item, timer);
-        }
-        timer->start(5000);
         break;
-    case Progress::Invalid:
-    case Progress::Download:
-    case Progress::Upload:
-    case Progress::Inactive:
-    case Progress::Error:
+    default:
         break;
     }
 
-    QString fileProgressString;
-    QString s1 = Utility::octetsToString( prog1 );
-    QString s2 = Utility::octetsToString( prog2 );
-
     // switch on extra space.
-    item->setData( QVariant(true), FolderStatusDelegate::AddProgressSpace );
+    setDataIfChanged( item, QVariant(true), FolderStatusDelegate::AddProgressSpace );
 
+    QString fileProgressString;
     if( progress.kind != Progress::EndSync ) {
         // Example text: "Currently uploading foobar.png (1MB of 2MB)"
         fileProgressString = tr("%1 %2 %3 (%4 of %5)").arg(syncFileProgressString).arg(kindString).
-                arg(itemFileName).arg(s1).arg(s2);
+                arg(itemFileName).arg(Utility::octetsToString(progress.current_file_bytes))
+                .arg(Utility::octetsToString(progress.file_size));
     } else {
         fileProgressString = tr("Completely finished.");
     }
-    item->setData( fileProgressString,FolderStatusDelegate::SyncProgressItemString);
+    setDataIfChanged( item, fileProgressString, FolderStatusDelegate::SyncProgressItemString );
 
     // overall progress
-    s1 = Utility::octetsToString( progress.overall_current_bytes );
-    s2 = Utility::octetsToString( progress.overall_transmission_size );
+    QString s1 = Utility::octetsToString( progress.overall_current_bytes );
+    QString s2 = Utility::octetsToString( progress.overall_transmission_size );
     QString overallSyncString = tr("%1 of %2, file %3 of %4").arg(s1).arg(s2)
             .arg(progress.current_file_no).arg(progress.overall_file_count);
-    item->setData( overallSyncString, FolderStatusDelegate::SyncProgressOverallString );
+    if( progress.kind != Progress::EndSync && progress.current_rate > 0 && progress.estimated_time_left > 0 ) {
+        // Example text: "1 MB of 10 MB, file 1 of 4 (200 kB/s, 45s left)"
+        overallSyncString += tr(" (%1/s, %2 left)").arg(Utility::octetsToString(progress.current_rate))
+                .arg(Utility::durationToString(progress.estimated_time_left));
+    }
+    setDataIfChanged( item, overallSyncString, FolderStatusDelegate::SyncProgressOverallString );
 
     int overallPercent = 0;
     if( progress.overall_transmission_size > 0 ) {
         overallPercent = qRound(double(progress.overall_current_bytes)/double(progress.overall_transmission_size) * 100.0);
     }
-    item->setData( overallPercent, FolderStatusDelegate::SyncProgressOverallPercent);
+    setDataIfChanged( item, overallPercent, FolderStatusDelegate::SyncProgressOverallPercent );
 }
 
 void AccountSettings::slotHideProgress()
 {
-    QTimer *send_timer = qobject_cast<QTimer*>(this->sender());
-    QHash<QStandardItem*, QTimer*>::const_iterator i = _hideProgressTimers.constBegin();
-    while (i != _hideProgressTimers.constEnd()) {
-        if( i.value() == send_timer ) {
-            QStandardItem *item = i.key();
-
-            /* Check if this item is still existing */
-            bool ok = false;
-            for( int r = 0; !ok && r < _model->rowCount(); r++) {
-                if( item == _model->item(r,0) ) {
-                    ok = true;
-                }
-            }
+    const qint64 now = _progressClock.elapsed();
 
-            if( ok ) {
-                item->setData( QVariant(false),  FolderStatusDelegate::AddProgressSpace );
-                item->setData( QVariant(QString::null), FolderStatusDelegate::SyncProgressOverallString );
-                item->setData( QVariant(QString::null), FolderStatusDelegate::SyncProgressItemString );
-                item->setData( 0,                       FolderStatusDelegate::SyncProgressOverallPercent );
-            }
-            _hideProgressTimers.remove(item);
-            break;
+    QMutableHashIterator<QString, qint64> it(_hideProgressAt);
+    while( it.hasNext() ) {
+        it.next();
+        if( it.value() > now ) {
+            continue;
+        }
+        QStandardItem *item = itemForFolder( it.key() );
+        if( item ) {
+            item->setData( QVariant(false),  FolderStatusDelegate::AddProgressSpace );
+            item->setData( QVariant(QString::null), FolderStatusDelegate::SyncProgressOverallString );
+            item->setData( QVariant(QString::null), FolderStatusDelegate::SyncProgressItemString );
+            item->setData( 0,                       FolderStatusDelegate::SyncProgressOverallPercent );
         }
-        ++i;
+        it.remove();
     }
 
-    send_timer->deleteLater();
+    if( _hideProgressAt.isEmpty() ) {
+        _hideProgressTimer->stop();
+    }
 }
 
 void AccountSettings::slotUpdateQuota(qint64 total, qint64 used)
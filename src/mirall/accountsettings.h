@@ -19,6 +19,7 @@
 #include <QPointer>
 #include <QHash>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QStandardItem>
 
 #include "mirall/folder.h"
@@ -85,19 +86,25 @@ protected slots:
     void slotFolderWizardRejected();
     void slotOpenAccountWizard();
     void slotHideProgress();
+    void slotFlushProgress();
 
 private:
     QString shortenFilename( const QString& folder, const QString& file ) const;
     void folderToModelItem( QStandardItem *, Folder * );
     QStandardItem* itemForFolder(const QString& );
+    void showProgress( QStandardItem *item, const QString& folder, const Progress::Info& progress );
     void showConnectionLabel( const QString& message, const QString& tooltip = QString() );
 
     Ui::AccountSettings *ui;
     QPointer<IgnoreListEditor> _ignoreEditor;
     QStandardItemModel *_model;
     QUrl   _OCUrl;
-    QHash<QStandardItem*, QTimer*> _hideProgressTimers;
-    QString _kindContext;
+    QHash<QString, Progress::Info> _pendingProgress; // latest snapshot per folder alias
+    QHash<QString, Progress::Kind> _kindContext;
+    QHash<QString, qint64> _hideProgressAt;           // alias -> time on _progressClock
+    QTimer *_progressTimer;
+    QTimer *_hideProgressTimer;
+    QElapsedTimer _progressClock;
     QStringList _generalErrors;
     bool _wasDisabledBefore;
 };
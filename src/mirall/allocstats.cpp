@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/allocstats.h"
+#include "mirall/utility.h"
+
+#include <QStringList>
+
+#ifdef WITH_ALLOC_STATS
+
+#include <stdlib.h>
+#include <new>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+#if defined(_MSC_VER)
+# define ALLOCSTATS_TLS __declspec(thread)
+#else
+// the default TLS model of a shared library may allocate on the first
+// access of a thread, which would recurse into the hooks below.
+# define ALLOCSTATS_TLS __thread __attribute__((tls_model("initial-exec")))
+#endif
+
+namespace {
+
+struct Counter {
+    volatile qint64 allocations;
+    volatile qint64 bytes;
+    volatile qint64 frees;
+};
+
+ALLOCSTATS_TLS int currentPhase = Mirall::AllocStats::NoPhase;
+Counter counters[Mirall::AllocStats::PhaseCount];
+
+inline void atomicAdd(volatile qint64 *value, qint64 delta)
+{
+#if defined(_MSC_VER)
+    InterlockedExchangeAdd64(value, delta);
+#else
+    __sync_fetch_and_add(value, delta);
+#endif
+}
+
+inline void bookAlloc(size_t size)
+{
+    const int phase = currentPhase;
+    if( phase < 0 ) return;
+    atomicAdd(&counters[phase].allocations, 1);
+    atomicAdd(&counters[phase].bytes, size);
+}
+
+inline void bookFree(void *ptr)
+{
+    const int phase = currentPhase;
+    if( phase < 0 || !ptr ) return;
+    atomicAdd(&counters[phase].frees, 1);
+}
+
+}
+
+#if defined(__GLIBC__)
+// With glibc the C allocator itself is replaced, so the QString and
+// QByteArray data (qMalloc) as well as the allocations of csync and neon
+// are accounted. operator new ends up in malloc as well.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) __THROW
+{
+    bookAlloc(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) __THROW
+{
+    bookAlloc(nmemb * size);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) __THROW
+{
+    bookAlloc(size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) __THROW
+{
+    bookFree(ptr);
+    __libc_free(ptr);
+}
+}
+#else
+// Elsewhere only operator new is hooked. On Windows this only covers
+// the allocations done by code in this library.
+void *operator new(size_t size)
+{
+    bookAlloc(size);
+    void *ptr = malloc(size ? size : 1);
+    if( !ptr ) throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *ptr) throw()
+{
+    bookFree(ptr);
+    free(ptr);
+}
+
+void operator delete[](void *ptr) throw()
+{
+    operator delete(ptr);
+}
+#endif
+
+#endif // WITH_ALLOC_STATS
+
+namespace Mirall {
+
+#ifdef WITH_ALLOC_STATS
+bool AllocStats::isEnabled()
+{
+    return true;
+}
+
+AllocStats::Phase AllocStats::setPhase(Phase phase)
+{
+    Phase previous = static_cast<Phase>(currentPhase);
+    currentPhase = phase;
+    return previous;
+}
+
+void AllocStats::reset()
+{
+    for( int i = 0; i < PhaseCount; ++i ) {
+        counters[i].allocations = 0;
+        counters[i].bytes = 0;
+        counters[i].frees = 0;
+    }
+}
+
+QVector<AllocStats::Counts> AllocStats::snapshot()
+{
+    // the copy is not part of the counts.
+    AllocScope scope(NoPhase);
+
+    QVector<Counts> counts(PhaseCount);
+    for( int i = 0; i < PhaseCount; ++i ) {
+        counts[i].allocations = counters[i].allocations;
+        counts[i].bytes = counters[i].bytes;
+        counts[i].frees = counters[i].frees;
+    }
+    return counts;
+}
+#endif
+
+QString AllocStats::report(const QVector<Counts>& counts)
+{
+    // do not let the report book itself on the caller's phase.
+    AllocScope scope(NoPhase);
+
+    QStringList parts;
+    for( int i = 0; i < counts.size() && i < PhaseCount; ++i ) {
+        parts.append(QString::fromLatin1("%1: %2 allocs, %3, %4 frees")
+                     .arg(phaseName(static_cast<Phase>(i)))
+                     .arg(counts.at(i).allocations)
+                     .arg(Utility::octetsToString(counts.at(i).bytes))
+                     .arg(counts.at(i).frees));
+    }
+    return parts.join(QLatin1String("; "));
+}
+
+QString AllocStats::phaseName(Phase phase)
+{
+    switch( phase ) {
+    case TreeWalkPhase:
+        return QLatin1String("tree walk");
+    case JobBuildPhase:
+        return QLatin1String("job build");
+    case PropagationPhase:
+        return QLatin1String("propagation");
+    case JournalPhase:
+        return QLatin1String("journal");
+    case ProgressPhase:
+        return QLatin1String("progress");
+    case LoggingPhase:
+        return QLatin1String("logging");
+    default:
+        break;
+    }
+    return QLatin1String("none");
+}
+
+}
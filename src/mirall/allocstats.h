@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_ALLOCSTATS_H
+#define MIRALL_ALLOCSTATS_H
+
+#include "config.h"
+
+#include <QString>
+#include <QVector>
+
+namespace Mirall {
+
+/**
+ * @brief Counts heap allocations per sync phase.
+ *
+ * Only compiled in if the build is configured with WITH_ALLOC_STATS.
+ * The allocator is hooked globally, and every allocation is booked on
+ * the phase the allocating thread is currently in, see AllocScope.
+ * Allocations outside of any phase are not counted.
+ *
+ * Without WITH_ALLOC_STATS all of this reduces to empty inline functions.
+ */
+class AllocStats
+{
+public:
+    enum Phase {
+        NoPhase = -1,
+        TreeWalkPhase = 0,
+        JobBuildPhase,
+        PropagationPhase,
+        JournalPhase,
+        ProgressPhase,
+        LoggingPhase,
+        PhaseCount
+    };
+
+    struct Counts {
+        Counts() : allocations(0), bytes(0), frees(0) {}
+        qint64 allocations;
+        qint64 bytes;
+        qint64 frees;
+    };
+
+    static bool isEnabled();
+
+    /** Sets the phase of the current thread, returns the previous one. */
+    static Phase setPhase(Phase phase);
+
+    /** Clears the counters, to be called when a sync starts. */
+    static void reset();
+
+    /** The counters since the last reset, one per phase. Empty if not enabled. */
+    static QVector<Counts> snapshot();
+
+    /** One line summary of a snapshot, empty for an empty one. */
+    static QString report(const QVector<Counts>& counts);
+
+    static QString phaseName(Phase phase);
+};
+
+/**
+ * @brief RAII helper that books the allocations of a block on a phase.
+ */
+class AllocScope
+{
+public:
+#ifdef WITH_ALLOC_STATS
+    explicit AllocScope(AllocStats::Phase phase)
+        : _previous(AllocStats::setPhase(phase)) {}
+    ~AllocScope() { AllocStats::setPhase(_previous); }
+private:
+    AllocStats::Phase _previous;
+#else
+    explicit AllocScope(AllocStats::Phase) {}
+#endif
+private:
+    Q_DISABLE_COPY(AllocScope)
+};
+
+typedef QVector<AllocStats::Counts> AllocCounts;
+
+#ifndef WITH_ALLOC_STATS
+inline bool AllocStats::isEnabled() { return false; }
+inline AllocStats::Phase AllocStats::setPhase(Phase) { return NoPhase; }
+inline void AllocStats::reset() {}
+inline QVector<AllocStats::Counts> AllocStats::snapshot() { return QVector<Counts>(); }
+#endif
+
+}
+
+#endif // MIRALL_ALLOCSTATS_H
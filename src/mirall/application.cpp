@@ -34,6 +34,7 @@
 #include "mirall/utility.h"
 #include "mirall/connectionvalidator.h"
 #include "mirall/socketapi.h"
+#include "mirall/networkmonitor.h"
 
 #include "creds/abstractcredentials.h"
 
@@ -92,6 +93,7 @@ Application::Application(int &argc, char **argv) :
     _theme(Theme::instance()),
     _helpOnly(false),
     _startupNetworkError(false),
+    _connectionFailed(false),
     _showLogWindow(false),
     _logExpire(0),
     _logFlush(false)
@@ -128,6 +130,8 @@ Application::Application(int &argc, char **argv) :
 #endif
 
 //    connect(_networkMgr, SIGNAL(onlineStateChanged(bool)), SLOT(slotCheckConnection()));
+    _networkMonitor = new NetworkMonitor(this);
+    connect( _networkMonitor, SIGNAL(networkStateChanged(bool)), SLOT(slotNetworkStateChanged(bool)));
 
     MirallConfigFile cfg;
     _theme->setSystrayUseMonoIcons(cfg.monoIcons());
@@ -206,11 +210,33 @@ void Application::slotCredentialsFetched()
 void Application::runValidator()
 {
     _conValidator = new ConnectionValidator();
+    _conValidator->setUseCachedServerInfo(!_connectionFailed);
     connect( _conValidator, SIGNAL(connectionResult(ConnectionValidator::Status)),
              this, SLOT(slotConnectionValidatorResult(ConnectionValidator::Status)) );
+    connect( _conValidator, SIGNAL(connectionOptimistic()),
+             this, SLOT(slotConnectionOptimistic()) );
     _conValidator->checkConnection();
 }
 
+void Application::slotNetworkStateChanged(bool online)
+{
+    if( online && _startupNetworkError ) {
+        // the connection was never validated, do that now instead of
+        // waiting for the retry timer.
+        slotCheckConnection();
+        return;
+    }
+    FolderMan::instance()->slotNetworkStateChanged(online);
+}
+
+void Application::slotConnectionOptimistic()
+{
+    // the server was fine not long ago, start while the validation finishes.
+    FolderMan *folderMan = FolderMan::instance();
+    folderMan->setSyncEnabled(true);
+    folderMan->slotStartupScheduleFolders();
+}
+
 void Application::slotConnectionValidatorResult(ConnectionValidator::Status status)
 {
     qDebug() << "Connection Validator Result: " << _conValidator->statusString(status);
@@ -219,12 +245,23 @@ void Application::slotConnectionValidatorResult(ConnectionValidator::Status stat
     if( status == ConnectionValidator::Connected ) {
         FolderMan *folderMan = FolderMan::instance();
         qDebug() << "######## Connection and Credentials are ok!";
+        _startupNetworkError = false;
+        _connectionFailed = false;
         folderMan->setSyncEnabled(true);
-        // queue up the sync for all folders.
-        folderMan->slotScheduleAllFolders();
+        // queue up the sync for all folders that changed meanwhile.
+        if( !_conValidator->usedCachedServerInfo() ) {
+            folderMan->slotStartupScheduleFolders();
+        }
     } else {
         // if we have problems here, it's unlikely that syncing will work.
-        FolderMan::instance()->setSyncEnabled(false);
+        FolderMan *folderMan = FolderMan::instance();
+        folderMan->setSyncEnabled(false);
+        if( _conValidator->usedCachedServerInfo() ) {
+            // syncs and etag requests might have been started optimistically.
+            folderMan->cancelStartupSyncs();
+            folderMan->terminateSyncProcess();
+        }
+        _connectionFailed = true;
 
         startupFails = _conValidator->errors();
         _startupNetworkError = _conValidator->networkError();
@@ -44,6 +44,7 @@ class ownCloudInfo;
 class SslErrorDialog;
 class SettingsDialog;
 class SocketApi;
+class NetworkMonitor;
 
 class Application : public SharedTools::QtSingleApplication
 {
@@ -80,6 +81,8 @@ protected slots:
     void slotParseOptions( const QString& );
     void slotCheckConnection();
     void slotConnectionValidatorResult(ConnectionValidator::Status);
+    void slotConnectionOptimistic();
+    void slotNetworkStateChanged(bool online);
     void slotSSLFailed( QNetworkReply *reply, QList<QSslError> errors );
     void slotStartUpdateDetector();
     void slotSetupProxy();
@@ -93,6 +96,7 @@ private:
     QPointer<ownCloudGui> _gui;
     QPointer<SocketApi> _socketApi;
     // QNetworkConfigurationManager *_networkMgr;
+    NetworkMonitor *_networkMonitor;
 
     SslErrorDialog      *_sslErrorDialog;
     ConnectionValidator *_conValidator;
@@ -101,6 +105,7 @@ private:
 
     bool _helpOnly;
     bool _startupNetworkError;
+    bool _connectionFailed; // the last validation failed, retries do not use the cache
 
     // options from command line:
     bool _showLogWindow;
@@ -21,7 +21,13 @@
 namespace Mirall {
 
 ConnectionValidator::ConnectionValidator(QObject *parent) :
-    QObject(parent)
+    QObject(parent),
+    _networkError(false),
+    _statusChecked(false),
+    _authStatus(Undefined),
+    _resultReported(false),
+    _usedCache(false),
+    _useCache(true)
 {
 
 }
@@ -29,7 +35,12 @@ ConnectionValidator::ConnectionValidator(QObject *parent) :
 ConnectionValidator::ConnectionValidator(const QString& connection, QObject *parent)
     : QObject(parent),
       _connection(connection),
-      _networkError(QNetworkReply::NoError)
+      _networkError(QNetworkReply::NoError),
+      _statusChecked(false),
+      _authStatus(Undefined),
+      _resultReported(false),
+      _usedCache(false),
+      _useCache(true)
 {
     ownCloudInfo::instance()->setCustomConfigHandle(_connection);
 }
@@ -44,6 +55,16 @@ bool ConnectionValidator::networkError() const
     return _networkError;
 }
 
+bool ConnectionValidator::usedCachedServerInfo() const
+{
+    return _usedCache;
+}
+
+void ConnectionValidator::setUseCachedServerInfo( bool use )
+{
+    _useCache = use;
+}
+
 QString ConnectionValidator::statusString( Status stat ) const
 {
     QString re;
@@ -92,22 +113,44 @@ void ConnectionValidator::checkConnection()
         connect( ownCloudInfo::instance(),SIGNAL(noOwncloudFound(QNetworkReply*)),
                  SLOT(slotNoStatusFound(QNetworkReply*)));
 
-        // checks for status.php
+        // status.php and the authenticated request do not depend on each
+        // other, so both are sent right away.
         ownCloudInfo::instance()->checkInstallation();
+        slotCheckAuthentication();
+
+        // With a recent enough answer from a previous run, the client
+        // can start to work while the checks are still running.
+        MirallConfigFile cfgFile(_connection);
+        const QString cachedVersion = _useCache ? cfgFile.cachedServerVersion(_connection) : QString();
+        if( !cachedVersion.isEmpty() && !serverTooOld(cachedVersion) ) {
+            qDebug() << "** Using cached server version" << cachedVersion << "until the checks are done.";
+            cfgFile.setOwnCloudVersion( cachedVersion );
+            _usedCache = true;
+            emit connectionOptimistic();
+        }
     } else {
         _errors << tr("No ownCloud connection configured");
         emit connectionResult( NotConfigured );
     }
 }
 
-void ConnectionValidator::slotStatusFound( const QString& url, const QString& versionStr, const QString& version, const QString& /*edition*/)
+bool ConnectionValidator::serverTooOld( const QString& version ) const
 {
-    // status.php was found.
-    qDebug() << "** Application: ownCloud found: " << url << " with version " << versionStr << "(" << version << ")";
-    // now check the authentication
-    MirallConfigFile cfgFile(_connection);
+    return version.startsWith("4.0");
+}
+
+void ConnectionValidator::reportResult( Status stat )
+{
+    if( _resultReported ) {
+        return;
+    }
+    _resultReported = true;
+
+    // the next start must not trust a server that fails now
+    if( stat != Connected ) {
+        MirallConfigFile(_connection).clearCachedServerVersion(_connection);
+    }
 
-    cfgFile.setOwnCloudVersion( version );
     // disconnect from ownCloudInfo
     disconnect( ownCloudInfo::instance(),SIGNAL(ownCloudInfoFound(QString,QString,QString,QString)),
                 this, SLOT(slotStatusFound(QString,QString,QString,QString)));
@@ -115,31 +158,41 @@ void ConnectionValidator::slotStatusFound( const QString& url, const QString& ve
     disconnect( ownCloudInfo::instance(),SIGNAL(noOwncloudFound(QNetworkReply*)),
                 this, SLOT(slotNoStatusFound(QNetworkReply*)));
 
-    if( version.startsWith("4.0") ) {
+    disconnect( ownCloudInfo::instance(),SIGNAL(ownCloudDirExists(QString,QNetworkReply*)),
+                this,SLOT(slotAuthCheck(QString,QNetworkReply*)));
+
+    emit connectionResult( stat );
+}
+
+void ConnectionValidator::slotStatusFound( const QString& url, const QString& versionStr, const QString& version, const QString& /*edition*/)
+{
+    // status.php was found.
+    qDebug() << "** Application: ownCloud found: " << url << " with version " << versionStr << "(" << version << ")";
+    MirallConfigFile cfgFile(_connection);
+
+    cfgFile.setOwnCloudVersion( version );
+    cfgFile.setCachedServerVersion( version, _connection );
+
+    if( serverTooOld(version) ) {
         _errors.append( tr("The configured server for this client is too old") );
         _errors.append( tr("Please update to the latest server and restart the client.") );
-        emit connectionResult( ServerVersionMismatch );
+        reportResult( ServerVersionMismatch );
         return;
     }
 
-    QTimer::singleShot( 0, this, SLOT( slotCheckAuthentication() ));
+    _statusChecked = true;
+    if( _authStatus != Undefined ) {
+        reportResult( _authStatus );
+    }
 }
 
 // status.php could not be loaded.
 void ConnectionValidator::slotNoStatusFound(QNetworkReply *reply)
 {
-    // disconnect from ownCloudInfo
-    disconnect( ownCloudInfo::instance(),SIGNAL(ownCloudInfoFound(QString,QString,QString,QString)),
-                this, SLOT(slotStatusFound(QString,QString,QString,QString)));
-
-    disconnect( ownCloudInfo::instance(),SIGNAL(noOwncloudFound(QNetworkReply*)),
-                this, SLOT(slotNoStatusFound(QNetworkReply*)));
-
     _errors.append(tr("Unable to connect to %1").arg(reply->url().toString()));
     _errors.append( reply->errorString() );
     _networkError = (reply->error() != QNetworkReply::NoError);
-    emit connectionResult( StatusNotFound );
-
+    reportResult( StatusNotFound );
 }
 
 void ConnectionValidator::slotCheckAuthentication()
@@ -170,7 +223,12 @@ void ConnectionValidator::slotAuthCheck( const QString&, QNetworkReply *reply )
     disconnect( ownCloudInfo::instance(),SIGNAL(ownCloudDirExists(QString,QNetworkReply*)),
              this,SLOT(slotAuthCheck(QString,QNetworkReply*)));
 
-    emit connectionResult( stat );
+    _authStatus = stat;
+    // wrong credentials are reported right away, everything else waits
+    // for status.php which might still find a too old server.
+    if( stat != Connected || _statusChecked ) {
+        reportResult( stat );
+    }
 }
 
 
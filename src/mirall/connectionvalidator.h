@@ -48,8 +48,18 @@ public:
 
     QString statusString( Status ) const;
 
+    /** true if connectionOptimistic() was emitted during the check */
+    bool usedCachedServerInfo() const;
+    /** Retries after a failed check should not start anything early. */
+    void setUseCachedServerInfo( bool use );
+
 signals:
     void connectionResult( ConnectionValidator::Status );
+    /**
+     * Emitted right at the start of the check if a recent server version
+     * is cached. The final result follows with connectionResult().
+     */
+    void connectionOptimistic();
     // void connectionAvailable();
     // void connectionFailed();
 
@@ -63,9 +73,17 @@ protected slots:
     void slotAuthCheck( const QString& ,QNetworkReply * );
 
 private:
+    bool serverTooOld( const QString& version ) const;
+    void reportResult( Status );
+
     QStringList _errors;
     QString     _connection;
     bool  _networkError;
+    bool  _statusChecked;
+    Status _authStatus;
+    bool  _resultReported;
+    bool  _usedCache;
+    bool  _useCache;
 };
 
 }
@@ -17,7 +17,12 @@
 #include "mirall/mirallconfigfile.h"
 #include "mirall/theme.h"
 #include "mirall/logger.h"
+#include "mirall/resourcegovernor.h"
+#include "mirall/allocstats.h"
+#include "mirall/serverbackoff.h"
 #include "mirall/owncloudinfo.h"
+#include "mirall/movematcher.h"
+#include "mirall/latencyprobe.h"
 #include "owncloudpropagator.h"
 #include "syncjournaldb.h"
 #include "syncjournalfilerecord.h"
@@ -34,6 +39,7 @@
 #include <QDebug>
 #include <QSslSocket>
 #include <QDir>
+#include <QMap>
 #include <QMutexLocker>
 #include <QThread>
 #include <QStringList>
@@ -50,6 +56,7 @@ void csyncLogCatcher(int /*verbosity*/,
                      const char *buffer,
                      void */*userdata*/)
 {
+  AllocScope allocScope(AllocStats::LoggingPhase);
   Logger::instance()->csyncLog( QString::fromUtf8(buffer) );
 }
 
@@ -64,11 +71,18 @@ CSyncThread::CSyncThread(CSYNC *csync, const QString &localPath, const QString &
     _remotePath = remotePath;
     _csync_ctx = csync;
     _journal = journal;
+    _recursiveDiscovery = false;
+    _uploading = false;
     _mutex.unlock();
     qRegisterMetaType<SyncFileItem>("SyncFileItem");
     qRegisterMetaType<SyncFileItem::Status>("SyncFileItem::Status");
 }
 
+void CSyncThread::setRecursiveDiscovery(bool recursive)
+{
+    _recursiveDiscovery = recursive;
+}
+
 CSyncThread::~CSyncThread()
 {
 
@@ -231,6 +245,9 @@ int CSyncThread::treewalkFile( TREE_WALK_FILE *file, bool remote )
     case CSYNC_INSTRUCTION_CONFLICT:
         _progressInfo.overall_file_count++;
         _progressInfo.overall_transmission_size += file->size;
+        if( !remote ) {
+            _progressInfo.upload_transmission_size += file->size;
+        }
         //fall trough
     default:
         _needsUpdate = true;
@@ -310,6 +327,8 @@ void CSyncThread::handleSyncError(CSYNC *ctx, const char *state) {
         emit csyncError(errStr);
     }
     csync_commit(_csync_ctx);
+
+    _crossFolderMoves.clear();
     emit finished();
     _syncMutex.unlock();
     thread()->quit();
@@ -351,6 +370,10 @@ void CSyncThread::startSync()
         qDebug() << "=====sync DB has only" << fileRecordCount << "items, enable recursive PROPFIND if csync supports it";
         bool no_recursive_propfind = false;
         csync_set_module_property(_csync_ctx, "no_recursive_propfind", &no_recursive_propfind);
+    } else if (_recursiveDiscovery) {
+        qDebug() << "=====many remote directories changed, enable recursive PROPFIND if csync supports it";
+        bool no_recursive_propfind = false;
+        csync_set_module_property(_csync_ctx, "no_recursive_propfind", &no_recursive_propfind);
     } else {
         qDebug() << "=====sync with existing DB";
     }
@@ -380,40 +403,52 @@ void CSyncThread::startSync()
     csync_set_log_level( 11 );
 
     _syncTime.start();
+    AllocStats::reset();
 
     QElapsedTimer updateTime;
     updateTime.start();
     qDebug() << "#### Update start #################################################### >>";
 
-    if( csync_update(_csync_ctx) < 0 ) {
-        handleSyncError(_csync_ctx, "csync_update");
-        return;
-    }
-    qDebug() << "<<#### Update end #################################################### " << updateTime.elapsed();
+    {
+        // the discovery and the reconcile are booked on the tree walk.
+        AllocScope allocScope(AllocStats::TreeWalkPhase);
+        {
+            // the discovery is the disk heavy part of the sync
+            DiskJobLocker diskJob;
+            if( csync_update(_csync_ctx) < 0 ) {
+                handleSyncError(_csync_ctx, "csync_update");
+                return;
+            }
+        }
+        qDebug() << "<<#### Update end #################################################### " << updateTime.elapsed();
 
-    if( csync_reconcile(_csync_ctx) < 0 ) {
-        handleSyncError(_csync_ctx, "csync_reconcile");
-        return;
-    }
+        if( csync_reconcile(_csync_ctx) < 0 ) {
+            handleSyncError(_csync_ctx, "csync_reconcile");
+            return;
+        }
 
-    _progressInfo = Progress::Info();
+        _progressInfo = Progress::Info();
+        _uploading = false;
 
-    _hasFiles = false;
-    bool walkOk = true;
-    if( csync_walk_local_tree(_csync_ctx, &treewalkLocal, 0) < 0 ) {
-        qDebug() << "Error in local treewalk.";
-        walkOk = false;
-    }
-    if( walkOk && csync_walk_remote_tree(_csync_ctx, &treewalkRemote, 0) < 0 ) {
-        qDebug() << "Error in remote treewalk.";
-    }
+        _hasFiles = false;
+        bool walkOk = true;
+        if( csync_walk_local_tree(_csync_ctx, &treewalkLocal, 0) < 0 ) {
+            qDebug() << "Error in local treewalk.";
+            walkOk = false;
+        }
+        if( walkOk && csync_walk_remote_tree(_csync_ctx, &treewalkRemote, 0) < 0 ) {
+            qDebug() << "Error in remote treewalk.";
+        }
 
-    // Adjust the paths for the renames.
-    for (SyncFileItemVector::iterator it = _syncedItems.begin();
-            it != _syncedItems.end(); ++it) {
-        it->_file = adjustRenamedPath(it->_file);
+        // Adjust the paths for the renames.
+        for (SyncFileItemVector::iterator it = _syncedItems.begin();
+                it != _syncedItems.end(); ++it) {
+            it->_file = adjustRenamedPath(it->_file);
+        }
     }
 
+    matchCrossFolderMoves();
+
     if (!_hasFiles && !_syncedItems.isEmpty()) {
         qDebug() << Q_FUNC_INFO << "All the files are going to be removed, asking the user";
         bool cancel = false;
@@ -434,11 +469,28 @@ void CSyncThread::startSync()
 
     _propagator.reset(new OwncloudPropagator (session, _localPath, _remotePath,
                                               _journal, &_abortRequested));
+    _propagator->_serverKey = ServerBackoff::serverKey(QUrl(cfg.ownCloudUrl()));
+    _propagator->_tarArchives = cfg.serverSendsTarArchives();
+    if (fileRecordCount == 0 && cfg.seedInitialSync()) {
+        // the local data was restored from a backup, take over what matches
+        qDebug() << "=====initial sync, seeding from the local files";
+        _propagator->_seedMtimeTolerance = cfg.seedMtimeTolerance();
+    }
     connect(_propagator.data(), SIGNAL(completed(SyncFileItem)),
             this, SLOT(transferCompleted(SyncFileItem)), Qt::QueuedConnection);
     connect(_propagator.data(), SIGNAL(progress(Progress::Kind,QString,quint64,quint64)),
             this, SLOT(slotProgress(Progress::Kind,QString,quint64,quint64)));
     connect(_propagator.data(), SIGNAL(finished()), this, SLOT(slotFinished()));
+    if (!_crossFolderMoves.isEmpty()) {
+        // direct, the source folder is told as soon as the item moved
+        connect(_propagator.data(), SIGNAL(completed(SyncFileItem)),
+                this, SLOT(slotCrossFolderMoveDone(SyncFileItem)));
+    }
+    if (LatencyProbe::instance()->isEnabled()) {
+        // when the job is done, transferCompleted only runs after slotFinished
+        connect(_propagator.data(), SIGNAL(completed(SyncFileItem)),
+                this, SLOT(slotItemCommitted(SyncFileItem)));
+    }
 
     int downloadLimit = 0;
     if (cfg.useDownloadLimit()) {
@@ -456,6 +508,10 @@ void CSyncThread::startSync()
     _propagator->_uploadLimit = uploadLimit;
 
     slotProgress(Progress::StartSync, QString(), 0, 0);
+    // the jobs run from the event loop of this thread, everything that
+    // is not booked otherwise until slotFinished is propagation.
+    AllocStats::setPhase(AllocStats::PropagationPhase);
+    LatencyProbe::instance()->discoveryFinished(_localPath);
     _propagator->start(_syncedItems);
 }
 
@@ -469,6 +525,7 @@ void CSyncThread::transferCompleted(const SyncFileItem &item)
         _syncedItems[idx]._instruction = item._instruction;
         _syncedItems[idx]._errorString = item._errorString;
         _syncedItems[idx]._status = item._status;
+        _syncedItems[idx]._moveSource = item._moveSource;
     }
 
     if (item._status == SyncFileItem::FatalError) {
@@ -476,6 +533,20 @@ void CSyncThread::transferCompleted(const SyncFileItem &item)
     }
 }
 
+void CSyncThread::slotCrossFolderMoveDone(const SyncFileItem &item)
+{
+    // the source folder forgets what was moved from it for real. The
+    // contents of a moved directory go with the directory record.
+    if (item._status == SyncFileItem::Success && !item._moveSource.isEmpty()) {
+        MoveMatcher::instance()->moved(_crossFolderMoves.value(item._file));
+    }
+}
+
+void CSyncThread::slotItemCommitted(const SyncFileItem &item)
+{
+    LatencyProbe::instance()->itemCommitted(_localPath, item);
+}
+
 void CSyncThread::slotFinished()
 {
     // emit the treewalk results.
@@ -484,8 +555,22 @@ void CSyncThread::slotFinished()
     csync_commit(_csync_ctx);
 
     qDebug() << "CSync run took " << _syncTime.elapsed() << " Milliseconds";
+    if( AllocStats::isEnabled() ) {
+        AllocStats::setPhase(AllocStats::NoPhase);
+        emit allocationCounts(AllocStats::snapshot());
+    }
+    if( LatencyProbe::instance()->isEnabled() ) {
+        LatencyProbe::instance()->syncFinished(_localPath);
+        qDebug() << "Change" << LatencyProbe::instance()->report();
+    }
     slotProgress(Progress::EndSync,QString(), 0 , 0);
     emit finished();
+
+    MirallConfigFile cfg;
+    if( !_propagator->_tarArchives && cfg.serverSendsTarArchives() ) {
+        // do not ask for archives the client can not extract again
+        cfg.setServerSendsTarArchives(false);
+    }
     _propagator.reset(0);
     _syncMutex.unlock();
     thread()->quit();
@@ -493,6 +578,7 @@ void CSyncThread::slotFinished()
 
 void CSyncThread::slotProgress(Progress::Kind kind, const QString &file, quint64 curr, quint64 total)
 {
+    AllocScope allocScope(AllocStats::ProgressPhase);
     Progress::Info pInfo = _progressInfo;
 
     pInfo.kind                  = kind;
@@ -500,13 +586,130 @@ void CSyncThread::slotProgress(Progress::Kind kind, const QString &file, quint64
     pInfo.file_size             = total;
     pInfo.current_file_bytes    = curr;
 
+    if( kind == Progress::StartUpload || kind == Progress::StartDownload ) {
+        _uploading = (kind == Progress::StartUpload);
+    }
+
     pInfo.overall_current_bytes += curr;
+    if( _uploading ) {
+        pInfo.upload_current_bytes += curr;
+    }
     pInfo.timestamp = QDateTime::currentDateTime();
 
+    // finished files count into the overall numbers of the following infos,
+    // the throughput estimation relies on that. An adopted file is done
+    // without a transfer.
+    if( kind == Progress::EndDownload || kind == Progress::EndUpload || kind == Progress::Adopted ) {
+        _progressInfo.overall_current_bytes += total;
+        if( kind == Progress::EndUpload ) {
+            _progressInfo.upload_current_bytes += total;
+        }
+        _progressInfo.current_file_no++;
+        pInfo.overall_current_bytes = _progressInfo.overall_current_bytes;
+        pInfo.upload_current_bytes = _progressInfo.upload_current_bytes;
+        pInfo.current_file_no = _progressInfo.current_file_no;
+    }
+
     // Connect to something in folder!
     transmissionProgress( pInfo );
 }
 
+/* Items moved out of one folder into another show up as a remote delete in
+ * the source and as a new local item here. Hold the deletes back and turn the
+ * new items that match a vanished one into a MOVE on the server. */
+void CSyncThread::matchCrossFolderMoves()
+{
+    _crossFolderMoves.clear();
+    MoveMatcher *matcher = MoveMatcher::instance();
+    if (matcher->folderCount() < 2) {
+        return;
+    }
+
+    // only the deletes of items that might have shown up in another folder
+    QStringList movedAway;
+    foreach (const SyncFileItem &item, _syncedItems) {
+        if (item._instruction != CSYNC_INSTRUCTION_REMOVE || item._dir != SyncFileItem::Up) {
+            continue;
+        }
+        SyncJournalFileRecord rec = _journal->getFileRecord(item._file);
+        if (rec.isValid() && matcher->isPendingCreate(_localPath, rec._inode, item._isDirectory, rec._fileSize)) {
+            movedAway.append(item._file);
+        }
+    }
+    if (!movedAway.isEmpty() && matcher->holdDeletes(_localPath)) {
+        // they stay in the journal and come again with the next sync,
+        // the contents of a held directory as well.
+        SyncFileItemVector kept;
+        foreach (const SyncFileItem &item, _syncedItems) {
+            bool held = false;
+            if (item._instruction == CSYNC_INSTRUCTION_REMOVE && item._dir == SyncFileItem::Up) {
+                foreach (const QString &path, movedAway) {
+                    if (item._file == path || item._file.startsWith(path + QLatin1Char('/'))) {
+                        held = true;
+                        break;
+                    }
+                }
+            }
+            if (!held) {
+                kept.append(item);
+            }
+        }
+        _syncedItems = kept;
+    }
+
+    // sorted by path, parents come before their contents
+    QMap<QString, int> newItems;
+    for (int i = 0; i < _syncedItems.size(); ++i) {
+        const SyncFileItem &item = _syncedItems.at(i);
+        if (item._instruction == CSYNC_INSTRUCTION_NEW && item._dir == SyncFileItem::Up) {
+            newItems.insert(item._file, i);
+        }
+    }
+
+    for (QMap<QString, int>::const_iterator it = newItems.constBegin(); it != newItems.constEnd(); ++it) {
+        SyncFileItem &item = _syncedItems[it.value()];
+
+        QString movedDir;
+        int slash = -1;
+        while ((slash = item._file.indexOf(QLatin1Char('/'), slash + 1)) > 0) {
+            if (_crossFolderMoves.contains(item._file.left(slash))) {
+                movedDir = item._file.left(slash);
+                break;
+            }
+        }
+        if (!movedDir.isEmpty()) {
+            // comes along with the directory if the source knows it
+            const MoveMatcher::Match &dirMatch = _crossFolderMoves[movedDir];
+            const QString source = dirMatch.file + item._file.mid(movedDir.length());
+            SyncJournalFileRecord rec = matcher->sourceRecord(dirMatch, source);
+            if (rec.isValid() && (rec._type == SyncFileItem::Directory) == item._isDirectory) {
+                item._moveSource = dirMatch.remotePath + source;
+                item._etag = rec._etag.toUtf8();
+                item._fileId = rec._fileId;
+                // local changes after the move are uploaded with the next sync
+                item._modtime = rec._modtime.toTime_t();
+                item._size = rec._fileSize;
+            }
+            continue;
+        }
+
+        const quint64 inode = SyncJournalFileRecord(item, _localPath + item._file)._inode;
+        const MoveMatcher::Match match = matcher->findVanished(_localPath, inode, item._isDirectory,
+                                                               item._size, item._modtime);
+        if (!match.isValid()) {
+            continue;
+        }
+        qDebug() << "Moved from another folder:" << match.localPath + match.file << "=>" << item._file;
+        item._moveSource = match.remotePath + match.file;
+        if (item._isDirectory) {
+            SyncJournalFileRecord rec = matcher->sourceRecord(match, match.file);
+            item._etag = rec._etag.toUtf8();
+            item._fileId = rec._fileId;
+        }
+        _crossFolderMoves.insert(item._file, match);
+    }
+}
+
 /* Given a path on the remote, give the path as it is when the rename is done */
 QString CSyncThread::adjustRenamedPath(const QString& original)
 {
@@ -30,6 +30,8 @@
 
 #include "mirall/syncfileitem.h"
 #include "mirall/progressdispatcher.h"
+#include "mirall/movematcher.h"
+#include "mirall/allocstats.h"
 
 class QProcess;
 
@@ -58,6 +60,9 @@ public:
 
     Q_INVOKABLE void startSync();
 
+    /* fetch the remote tree with one recursive PROPFIND, set before startSync */
+    void setRecursiveDiscovery(bool recursive);
+
     /* Abort the sync.  Called from the main thread */
     void abort();
 
@@ -66,6 +71,7 @@ signals:
     void csyncWarning( const QString& );
     void csyncUnavailable();
     void treeWalkResult(const SyncFileItemVector&);
+    void allocationCounts(const AllocCounts&);
 
     void transmissionProgress( const Progress::Info& progress );
     void csyncStateDbFile( const QString& );
@@ -78,6 +84,8 @@ signals:
 
 private slots:
     void transferCompleted(const SyncFileItem& item);
+    void slotItemCommitted(const SyncFileItem& item);
+    void slotCrossFolderMoveDone(const SyncFileItem& item);
     void slotFinished();
     void slotProgress(Progress::Kind kind, const QString& file, quint64, quint64);
 
@@ -107,10 +115,16 @@ private:
     QHash<QString, QString> _renamedFolders;
     QString adjustRenamedPath(const QString &original);
 
+    // items moved here from other folders, by destination
+    QHash<QString, MoveMatcher::Match> _crossFolderMoves;
+    void matchCrossFolderMoves();
+
     bool _hasFiles; // true if there is at least one file that is not ignored or removed
     Progress::Info _progressInfo;
+    bool _uploading; // direction of the file the progress is reported for
     int _downloadLimit;
     int _uploadLimit;
+    bool _recursiveDiscovery;
 
     QAtomicInt _abortRequested;
 
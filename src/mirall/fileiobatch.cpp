@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "config.h"
+
+#include "mirall/fileiobatch.h"
+
+#include <QDebug>
+#include <QFile>
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef WITH_IO_URING
+#include <liburing.h>
+#endif
+
+namespace Mirall {
+
+FileIoBatch::FileIoBatch(int depth, Backend backend)
+    : _depth(qMax(depth, 1)),
+      _backend(backend),
+      _ring(0),
+      _ringFailed(false),
+      _noUnlinkAt(false)
+{
+}
+
+FileIoBatch::~FileIoBatch()
+{
+    shutdownRing();
+}
+
+int FileIoBatch::read(int fd, char *buffer, int len, qint64 offset)
+{
+    Op op;
+    op.type = Op::Read;
+    op.fd = fd;
+    op.buffer = buffer;
+    op.len = len;
+    op.offset = offset;
+    op.result = 0;
+    op.done = false;
+    _ops.append(op);
+    return _ops.size() - 1;
+}
+
+int FileIoBatch::unlink(const QString &fileName)
+{
+    Op op;
+    op.type = Op::Unlink;
+    op.fd = -1;
+    op.buffer = 0;
+    op.len = 0;
+    op.offset = 0;
+    op.path = QFile::encodeName(fileName);
+    op.result = 0;
+    op.done = false;
+    _ops.append(op);
+    return _ops.size() - 1;
+}
+
+bool FileIoBatch::usesIoUring() const
+{
+#ifdef WITH_IO_URING
+    return _backend == Automatic && !_ringFailed;
+#else
+    return false;
+#endif
+}
+
+bool FileIoBatch::setupRing()
+{
+#ifdef WITH_IO_URING
+    if (_ring) {
+        return true;
+    }
+    if (!usesIoUring()) {
+        return false;
+    }
+    _ring = new io_uring;
+    const int ret = io_uring_queue_init(_depth, _ring, 0);
+    if (ret < 0) {
+        // seccomp filters and old kernels, the syscalls will do
+        qDebug() << "FileIoBatch: io_uring not available:" << strerror(-ret);
+        delete _ring;
+        _ring = 0;
+        _ringFailed = true;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void FileIoBatch::shutdownRing()
+{
+#ifdef WITH_IO_URING
+    if (_ring) {
+        io_uring_queue_exit(_ring);
+        delete _ring;
+        _ring = 0;
+    }
+#endif
+}
+
+void FileIoBatch::submitRing(int first, int count)
+{
+#ifdef WITH_IO_URING
+    int queued = 0;
+    for (int i = first; i < first + count; ++i) {
+        Op &op = _ops[i];
+        if (op.type == Op::Unlink && _noUnlinkAt) {
+            continue;
+        }
+        io_uring_sqe *sqe = io_uring_get_sqe(_ring);
+        if (!sqe) {
+            break;
+        }
+        if (op.type == Op::Read) {
+            io_uring_prep_read(sqe, op.fd, op.buffer, op.len, op.offset);
+        } else {
+            io_uring_prep_unlinkat(sqe, AT_FDCWD, op.path.constData(), 0);
+        }
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void *>(quintptr(i)));
+        ++queued;
+    }
+    if (queued == 0) {
+        return;
+    }
+
+    int submitted = io_uring_submit(_ring);
+    if (submitted < 0) {
+        qDebug() << "FileIoBatch: io_uring submit failed:" << strerror(-submitted);
+        submitted = 0;
+    }
+    for (int reaped = 0; reaped < submitted; ++reaped) {
+        io_uring_cqe *cqe = 0;
+        int ret;
+        do {
+            ret = io_uring_wait_cqe(_ring, &cqe);
+        } while (ret == -EINTR);
+        if (ret < 0) {
+            submitted = reaped;
+            break;
+        }
+        Op &op = _ops[int(quintptr(io_uring_cqe_get_data(cqe)))];
+        if (op.type == Op::Unlink && cqe->res == -EINVAL) {
+            // no IORING_OP_UNLINKAT, left to the syscall below
+            _noUnlinkAt = true;
+        } else {
+            op.result = cqe->res;
+            op.done = true;
+        }
+        io_uring_cqe_seen(_ring, cqe);
+    }
+    if (submitted < queued) {
+        // do not leave half a batch in the ring, the rest runs as syscalls
+        shutdownRing();
+        _ringFailed = true;
+    }
+#else
+    Q_UNUSED(first);
+    Q_UNUSED(count);
+#endif
+}
+
+void FileIoBatch::runSyscall(Op &op)
+{
+    if (op.type == Op::Read) {
+#ifdef Q_OS_WIN
+        if (_lseeki64(op.fd, op.offset, SEEK_SET) < 0) {
+            op.result = -errno;
+        } else {
+            const int r = _read(op.fd, op.buffer, op.len);
+            op.result = r < 0 ? -errno : r;
+        }
+#else
+        ssize_t r;
+        do {
+            r = pread(op.fd, op.buffer, op.len, op.offset);
+        } while (r < 0 && errno == EINTR);
+        op.result = r < 0 ? -errno : r;
+#endif
+    } else {
+#ifdef Q_OS_WIN
+        op.result = QFile::remove(QFile::decodeName(op.path)) ? 0 : -EACCES;
+#else
+        op.result = ::unlink(op.path.constData()) < 0 ? -errno : 0;
+#endif
+    }
+    op.done = true;
+}
+
+int FileIoBatch::submit()
+{
+    // a ring is not worth setting up for a single operation
+    const bool ring = _ops.size() > 1 && setupRing();
+    for (int first = 0; first < _ops.size(); first += _depth) {
+        const int count = qMin(_depth, _ops.size() - first);
+        if (ring && _ring) {
+            submitRing(first, count);
+        }
+        for (int i = first; i < first + count; ++i) {
+            if (!_ops.at(i).done) {
+                runSyscall(_ops[i]);
+            }
+        }
+    }
+
+    int failed = 0;
+    for (int i = 0; i < _ops.size(); ++i) {
+        Op &op = _ops[i];
+        // reads may come back short, complete them up to the end of the file
+        while (op.type == Op::Read && op.result > 0 && op.result < op.len) {
+            Op rest = op;
+            rest.buffer += op.result;
+            rest.len -= int(op.result);
+            rest.offset += op.result;
+            runSyscall(rest);
+            if (rest.result <= 0) {
+                break;
+            }
+            op.result += rest.result;
+        }
+        if (op.result < 0) {
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+}
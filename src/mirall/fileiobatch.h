@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_FILEIOBATCH_H
+#define MIRALL_FILEIOBATCH_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+struct io_uring;
+
+namespace Mirall {
+
+/**
+ * @brief Runs many local file operations at once.
+ *
+ * Reads and unlinks are queued and run by submit(). When built with
+ * WITH_IO_URING on Linux they go to the kernel as one io_uring batch of up
+ * to depth operations, which keeps the queue of fast disks full and costs
+ * one syscall per batch instead of one per operation. Without it, or when
+ * the kernel does not support an operation, they run one after the other.
+ *
+ * Reads are complete after submit() unless the end of the file was hit.
+ */
+class FileIoBatch
+{
+public:
+    enum Backend { Automatic, Syscalls };
+
+    explicit FileIoBatch(int depth = 64, Backend backend = Automatic);
+    ~FileIoBatch();
+
+    /** Queues reading len bytes at offset of fd into buffer, returns the index of the operation. */
+    int read(int fd, char *buffer, int len, qint64 offset);
+
+    /** Queues removing a file, returns the index of the operation. */
+    int unlink(const QString &fileName);
+
+    /** Runs the queued operations and returns how many of them failed. */
+    int submit();
+
+    /** Bytes read or 0 for an unlink, a negative errno if the operation failed. */
+    qint64 result(int index) const { return _ops.at(index).result; }
+
+    int count() const { return _ops.size(); }
+
+    /** Forgets the operations, the results of the last submit() included. */
+    void clear() { _ops.clear(); }
+
+    bool usesIoUring() const;
+
+private:
+    struct Op {
+        enum Type { Read, Unlink };
+        Type       type;
+        int        fd;
+        char      *buffer;
+        int        len;
+        qint64     offset;
+        QByteArray path;
+        qint64     result;
+        bool       done;
+    };
+
+    bool setupRing();
+    void shutdownRing();
+    void submitRing(int first, int count);
+    void runSyscall(Op &op);
+
+    QVector<Op> _ops;
+    int         _depth;
+    Backend     _backend;
+    io_uring   *_ring;
+    bool        _ringFailed;
+    bool        _noUnlinkAt;   // the kernel is older than 5.11
+};
+
+}
+
+#endif // MIRALL_FILEIOBATCH_H
@@ -22,6 +22,12 @@
 #include "mirall/logger.h"
 #include "mirall/owncloudinfo.h"
 #include "mirall/utility.h"
+#include "mirall/resourcegovernor.h"
+#include "mirall/serverbackoff.h"
+#include "mirall/journallocation.h"
+#include "mirall/movematcher.h"
+#include "mirall/latencyprobe.h"
+#include "mirall/synctrace.h"
 #include "folderman.h"
 #include "creds/abstractcredentials.h"
 #include "mirall/syncjournalfilerecord.h"
@@ -46,11 +52,19 @@ CSYNC_EXCLUDE_TYPE csync_excluded(CSYNC *ctx, const char *path, int filetype);
 #include <QUrl>
 #include <QFileSystemWatcher>
 #include <QDir>
+#include <QDateTime>
 #include <QMessageBox>
 #include <QPushButton>
 
 namespace Mirall {
 
+// polls without a change before the interval starts to grow
+static const int dormantAfterPolls = 3;
+// without input for that long the user counts as idle
+static const qint64 userIdleMsec = 10 * 60 * 1000;
+// an idle user allows this many times the max poll interval
+static const int idlePollFactor = 4;
+
 Folder::Folder(const QString &alias, const QString &path, const QString& secondPath, QObject *parent)
     : QObject(parent)
       , _path(path)
@@ -63,7 +77,10 @@ Folder::Folder(const QString &alias, const QString &path, const QString& secondP
       , _csyncUnavail(false)
       , _wipeDb(false)
       , _proxyDirty(true)
-      , _journal(path)
+      , _unchangedPolls(0)
+      , _recursiveRemoteDiscovery(false)
+      , _journal(JournalLocation::prepare(path))
+      , _traceRecorder(0)
       , _csync_ctx(0)
 {
     qsrand(QTime::currentTime().msec());
@@ -89,6 +106,13 @@ Folder::Folder(const QString &alias, const QString &path, const QString& secondP
     QObject::connect(&_pollTimer, SIGNAL(timeout()), this, SLOT(slotPollTimerTimeout()));
     _pollTimer.start();
 
+    const QString traceDir = cfg.syncTraceDirectory();
+    if (!traceDir.isEmpty() && QDir().mkpath(traceDir)) {
+        const QString traceFile = QString::fromLatin1("%1/%2-%3.trace").arg(traceDir, alias,
+                                  QDateTime::currentDateTime().toString(QLatin1String("yyyyMMdd-hhmmss")));
+        _traceRecorder = new SyncTraceRecorder(traceFile, path);
+    }
+
     _syncResult.setFolder(alias);
 }
 
@@ -107,6 +131,8 @@ bool Folder::init()
 
         MirallConfigFile cfgFile;
         csync_set_config_dir( _csync_ctx, cfgFile.configPath().toUtf8() );
+        // the journal might be kept outside of the sync root, see JournalLocation
+        csync_set_statedb_file( _csync_ctx, journalDbFile().toUtf8() );
 
         csync_enable_conflictcopys(_csync_ctx);
         setIgnoredFiles();
@@ -137,6 +163,8 @@ Folder::~Folder()
     delete _csync;
     // Destroy csync here.
     csync_destroy(_csync_ctx);
+    MoveMatcher::instance()->unregisterFolder(path());
+    delete _traceRecorder;
 }
 
 void Folder::checkLocalPath()
@@ -246,10 +274,34 @@ void Folder::evaluateSync(const QStringList &/*pathList*/)
 
 }
 
+QString Folder::journalDbFile()
+{
+    return _journal.databaseFilePath();
+}
+
+QStringList Folder::ignoredPatterns() const
+{
+    return _watcher->ignores();
+}
+
+void Folder::setInSyncAtStartup(const QString& etag)
+{
+    qDebug() << "* Folder" << alias() << "is in sync, no startup sync needed.";
+    _lastEtag = etag;
+    _timeSinceLastSync.restart();
+    _syncResult.setStatus(SyncResult::Success);
+    emit syncStateChange();
+}
+
 void Folder::slotPollTimerTimeout()
 {
     qDebug() << "* Polling" << alias() << "for changes. (time since next sync:" << (_timeSinceLastSync.elapsed() / 1000) << "s)";
 
+    if (ServerBackoff::instance()->remaining(ServerBackoff::serverKey(QUrl(ownCloudInfo::instance()->webdavUrl()))) > 0) {
+        qDebug() << "** Server busy, not polling";
+        return;
+    }
+
     if (quint64(_timeSinceLastSync.elapsed()) > MirallConfigFile().forceSyncInterval() ||
             _syncResult.status() != SyncResult::Success ) {
         qDebug() << "** Force Sync now";
@@ -262,6 +314,21 @@ void Folder::slotPollTimerTimeout()
     }
 }
 
+QString Folder::lastEtag() const
+{
+    return _lastEtag;
+}
+
+void Folder::setRecursiveRemoteDiscovery()
+{
+    _recursiveRemoteDiscovery = true;
+}
+
+int Folder::watchCount() const
+{
+    return _watcher->watchCount();
+}
+
 void Folder::etagRetreived(const QString& etag)
 {
     qDebug() << "* Compare etag  with previous etag: " << (_lastEtag != etag);
@@ -269,12 +336,43 @@ void Folder::etagRetreived(const QString& etag)
     // re-enable sync if it was disabled because network was down
     FolderMan::instance()->setSyncEnabled(true);
 
+    updatePollInterval(_lastEtag != etag);
     if (_lastEtag != etag) {
         _lastEtag = etag;
+        LatencyProbe::instance()->remoteChangeDetected(path());
         evaluateSync(QStringList());
     }
 }
 
+void Folder::updatePollInterval(bool changed)
+{
+    MirallConfigFile cfg;
+    const int base = cfg.remotePollInterval();
+    int interval = base;
+
+    // Folders that change are polled at the configured interval, the
+    // interval of dormant ones doubles with every poll up to the max.
+    if (changed) {
+        _unchangedPolls = 0;
+    } else if (++_unchangedPolls > dormantAfterPolls) {
+        qint64 cap = cfg.maxRemotePollInterval();
+        const qint64 idle = Utility::userIdleTime();
+        if (idle > userIdleMsec) {
+            cap *= idlePollFactor;
+        }
+        interval = int(qBound(qint64(base), 2 * qint64(_pollTimer.interval()), cap));
+    } else {
+        interval = qMax(base, qMin(_pollTimer.interval(), cfg.maxRemotePollInterval()));
+    }
+
+    if (interval != _pollTimer.interval()) {
+        qDebug() << "* Poll interval of" << alias() << "is now" << interval / 1000 << "s,"
+                 << _unchangedPolls << "polls without a change";
+        // restarts the timer if it is running
+        _pollTimer.setInterval(interval);
+    }
+}
+
 void Folder::slotNetworkUnavailable()
 {
     _syncResult.setStatus(SyncResult::Unavailable);
@@ -284,6 +382,10 @@ void Folder::slotNetworkUnavailable()
 void Folder::slotChanged(const QStringList &pathList)
 {
     qDebug() << "** Changed was notified on " << pathList;
+    // what appeared here might have been moved out of another folder
+    MoveMatcher::instance()->noteChanges(path(), pathList);
+    // someone works in the folder, others likely do on the server too.
+    updatePollInterval(true);
     evaluateSync(pathList);
 }
 
@@ -412,6 +514,22 @@ QString Folder::configFile()
 void Folder::slotThreadTreeWalkResult(const SyncFileItemVector& items)
 {
     _syncResult.setSyncFileItemVector(items);
+    if (_traceRecorder) {
+        _traceRecorder->syncFinished(items);
+    }
+}
+
+void Folder::slotAllocationCounts(const AllocCounts& counts)
+{
+    _syncResult.setAllocationCounts(counts);
+    qDebug() << "Allocations of the sync run:" << AllocStats::report(counts);
+}
+
+void Folder::slotForgetMovedItem(const QString& file)
+{
+    // the record itself and, for directories, everything below
+    _journal.deleteFileRecord(file, true);
+    _journal.deleteFileRecord(file);
 }
 
 void Folder::slotCatchWatcherError(const QString& error)
@@ -447,23 +565,14 @@ void Folder::slotTerminateSync(bool block)
 // See http://bugs.owncloud.org/thebuggenie/owncloud/issues/oc-788
 void Folder::wipe()
 {
-    QString stateDbFile = path()+QLatin1String(".csync_journal.db");
+    QString stateDbFile = journalDbFile();
 
-    QFile file(stateDbFile);
-    if( file.exists() ) {
-        if( !file.remove()) {
-            qDebug() << "WRN: Failed to remove existing csync StateDB " << stateDbFile;
-        } else {
-            qDebug() << "wipe: Removed csync StateDB " << stateDbFile;
-        }
+    // the journal might be kept outside of the sync root, see JournalLocation.
+    // This also removes the temporary files of csync and SQLite next to it.
+    if( !JournalLocation::remove(path()) ) {
+        qDebug() << "WRN: Failed to remove existing csync StateDB " << stateDbFile;
     } else {
-        qDebug() << "WRN: statedb is empty, can not remove.";
-    }
-    // Check if the tmp database file also exists
-    QString ctmpName = path() + QLatin1String(".csync_journal.db.ctmp");
-    QFile ctmpFile( ctmpName );
-    if( ctmpFile.exists() ) {
-        ctmpFile.remove();
+        qDebug() << "wipe: Removed csync StateDB " << stateDbFile;
     }
 }
 
@@ -572,14 +681,23 @@ void Folder::startSync(const QStringList &pathList)
     _csyncUnavail = false;
 
     _syncResult.clearErrors();
+    _syncResult.setAllocationCounts(AllocCounts());
     _syncResult.setStatus( SyncResult::SyncPrepare );
     emit syncStateChange();
 
 
     qDebug() << "*** Start syncing";
+    LatencyProbe::instance()->syncStarted(path());
+    if (_traceRecorder) {
+        _traceRecorder->syncStarted();
+    }
     _thread = new QThread(this);
     setIgnoredFiles();
-    _csync = new CSyncThread( _csync_ctx, path(), QUrl(ownCloudInfo::instance()->webdavUrl() + secondPath()).path(), &_journal);
+    const QString remotePath = QUrl(ownCloudInfo::instance()->webdavUrl() + secondPath()).path();
+    MoveMatcher::instance()->registerFolder(path(), remotePath, journalDbFile(), this);
+    _csync = new CSyncThread( _csync_ctx, path(), remotePath, &_journal);
+    _csync->setRecursiveDiscovery(_recursiveRemoteDiscovery);
+    _recursiveRemoteDiscovery = false;
     _csync->moveToThread(_thread);
 
     qRegisterMetaType<SyncFileItemVector>("SyncFileItemVector");
@@ -587,6 +705,9 @@ void Folder::startSync(const QStringList &pathList)
 
     connect( _csync, SIGNAL(treeWalkResult(const SyncFileItemVector&)),
               this, SLOT(slotThreadTreeWalkResult(const SyncFileItemVector&)), Qt::QueuedConnection);
+    qRegisterMetaType<AllocCounts>("AllocCounts");
+    connect( _csync, SIGNAL(allocationCounts(AllocCounts)),
+             this, SLOT(slotAllocationCounts(AllocCounts)), Qt::QueuedConnection);
 
     connect(_csync, SIGNAL(started()),  SLOT(slotCSyncStarted()), Qt::QueuedConnection);
     connect(_csync, SIGNAL(finished()), SLOT(slotCSyncFinished()), Qt::QueuedConnection);
@@ -599,7 +720,9 @@ void Folder::startSync(const QStringList &pathList)
     connect(_csync, SIGNAL(transmissionProgress(Progress::Info)), this, SLOT(slotTransmissionProgress(Progress::Info)));
 
     _thread->start();
+    // the sync thread sets its I/O class and nice level itself, see ResourceGovernor
     _thread->setPriority(QThread::LowPriority);
+    qDebug() << "*** Resource limits for" << alias() << ":" << ResourceGovernor::instance()->description();
 
     QMetaObject::invokeMethod(_csync, "startSync", Qt::QueuedConnection);
 
@@ -39,6 +39,7 @@ class QThread;
 namespace Mirall {
 
 class FolderWatcher;
+class SyncTraceRecorder;
 
 typedef enum SyncFileStatus_s {
     FILE_STATUS_NONE,
@@ -122,6 +123,39 @@ public:
       */
      virtual void wipe();
 
+     /**
+      * the sync journal database file of this folder
+      */
+     QString journalDbFile();
+
+     /**
+      * the exclude patterns, as read from the exclude files
+      */
+     QStringList ignoredPatterns() const;
+
+     /**
+      * Marks the folder as in sync without running csync. Used if the startup
+      * check found the journal to match the local tree and the server.
+      * The etag is the one the poll timer compares against.
+      */
+     void setInSyncAtStartup(const QString& etag);
+
+     /**
+      * The etag of the remote folder as of the last poll.
+      */
+     QString lastEtag() const;
+
+     /**
+      * Many remote directories changed, the next sync fetches the remote
+      * tree with one recursive PROPFIND. See RemoteDiscoveryPrefetcher.
+      */
+     void setRecursiveRemoteDiscovery();
+
+     /**
+      * Number of watches the folder watcher holds.
+      */
+     int watchCount() const;
+
 signals:
     void syncStateChange();
     void syncStarted();
@@ -178,7 +212,10 @@ private slots:
      */
     void slotLocalPathChanged( const QString& );
     void slotThreadTreeWalkResult(const SyncFileItemVector& );
+    void slotAllocationCounts(const AllocCounts& );
     void slotCatchWatcherError( const QString& );
+    /** The item was moved to another folder on the server, see MoveMatcher. */
+    void slotForgetMovedItem( const QString& file );
 
 protected:
     bool init();
@@ -193,6 +230,9 @@ protected:
 
     void checkLocalPath();
 
+    /** adapts the poll interval after a poll or a local change */
+    void updatePollInterval(bool changed);
+
     QString   _path;
     QString   _secondPath;
     QString   _alias;
@@ -211,9 +251,12 @@ protected:
     Progress::Kind _progressKind;
     QTimer        _pollTimer;
     QString       _lastEtag;
+    int           _unchangedPolls; // polls in a row that found the same etag
+    bool          _recursiveRemoteDiscovery; // for the next sync only
     QElapsedTimer _timeSinceLastSync;
 
     SyncJournalDb _journal;
+    SyncTraceRecorder *_traceRecorder;
 
     CSYNC *_csync_ctx;
 
@@ -18,6 +18,13 @@
 #include "mirall/syncresult.h"
 #include "mirall/inotify.h"
 #include "mirall/theme.h"
+#include "mirall/journalverifier.h"
+#include "mirall/serverbackoff.h"
+#include "mirall/journallocation.h"
+#include "mirall/movematcher.h"
+#include "mirall/remotediscoveryprefetcher.h"
+#include "mirall/progressdispatcher.h"
+#include "mirall/utility.h"
 #include "owncloudinfo.h"
 
 #ifdef Q_OS_MAC
@@ -29,10 +36,14 @@
 
 #include <QDesktopServices>
 #include <QMessageBox>
+#include <QNetworkProxy>
 #include <QtCore>
 
 namespace Mirall {
 
+// how long before the expected end of a sync the next folders are prefetched
+static const qint64 prefetchLeadSecs = 60;
+
 FolderMan* FolderMan::_instance = 0;
 
 FolderMan::FolderMan(QObject *parent) :
@@ -49,6 +60,20 @@ FolderMan::FolderMan(QObject *parent) :
     _folderChangeSignalMapper = new QSignalMapper(this);
     connect(_folderChangeSignalMapper, SIGNAL(mapped(const QString &)),
             this, SIGNAL(folderSyncStateChange(const QString &)));
+
+    _startupTimer = new QTimer(this);
+    _startupTimer->setSingleShot(true);
+    connect(_startupTimer, SIGNAL(timeout()), this, SLOT(slotStartupScheduleNext()));
+
+    _verifierPool = new QThreadPool(this);
+    _verifierPool->setMaxThreadCount(cfg.startupVerifierThreads());
+
+    _prefetcher = new RemoteDiscoveryPrefetcher(this);
+    _prefetchTimer = new QTimer(this);
+    _prefetchTimer->setSingleShot(true);
+    connect(_prefetchTimer, SIGNAL(timeout()), this, SLOT(slotPrefetchNext()));
+    connect(ProgressDispatcher::instance(), SIGNAL(progressInfo(QString,Progress::Info)),
+            this, SLOT(slotFolderProgress(QString,Progress::Info)));
 }
 
 FolderMan *FolderMan::instance()
@@ -61,6 +86,7 @@ FolderMan *FolderMan::instance()
 
 FolderMan::~FolderMan()
 {
+    _verifierPool->waitForDone();
     qDeleteAll(_folderMap);
 }
 
@@ -127,7 +153,8 @@ void FolderMan::wipeAllJournals()
 bool FolderMan::ensureJournalGone(const QString &localPath)
 {
 
-    // remove old .csync_journal file
+    // remove old .csync_journal file, and the one it links to
+    JournalLocation::remove(localPath);
     QString stateDbFile = localPath+QLatin1String("/.csync_journal.db");
     while (QFile::exists(stateDbFile) && !QFile::remove(stateDbFile)) {
         int ret = QMessageBox::warning(0, tr("Could not reset folder state"),
@@ -331,6 +358,126 @@ void FolderMan::slotScheduleAllFolders()
     }
 }
 
+void FolderMan::slotStartupScheduleFolders()
+{
+    MirallConfigFile cfg;
+    if( !cfg.startupVerifyJournal() ) {
+        slotScheduleAllFolders();
+        return;
+    }
+
+    foreach( Folder *f, _folderMap.values() ) {
+        if( !f->syncEnabled() || _startupEtagJobs.values().contains(f->alias()) ) {
+            continue;
+        }
+        RequestDirectoryEtagsJob *job = new RequestDirectoryEtagsJob(f->secondPath(), this);
+        _startupEtagJobs.insert(job, f->alias());
+        connect(job, SIGNAL(etagsRetreived(QString,QHash<QString,QString>)),
+                this, SLOT(slotStartupEtagsRetreived(QString,QHash<QString,QString>)));
+        connect(job, SIGNAL(networkError()), this, SLOT(slotStartupEtagsFailed()));
+    }
+}
+
+void FolderMan::cancelStartupSyncs()
+{
+    _startupTimer->stop();
+    _startupQueue.clear();
+    _startupEtags.clear();
+    foreach( QObject *job, _startupEtagJobs.keys() ) {
+        job->deleteLater();
+    }
+    _startupEtagJobs.clear();
+}
+
+void FolderMan::slotNetworkStateChanged( bool online )
+{
+    if( !online ) {
+        qDebug() << "Network is gone, pausing all folders.";
+        setSyncEnabled(false);
+        cancelStartupSyncs();
+
+        if( !_currentSyncFolder.isEmpty() ) {
+            Folder *f = folder(_currentSyncFolder);
+            if( f ) {
+                // not blocking, the sync thread goes away on its own.
+                f->slotTerminateSync(false);
+                // a request on a dead route would wait for its timeout,
+                // cut the connections so that the abort is seen now.
+                // Manual check: pull the cable during a large download,
+                // the folder shows "aborted" within a second.
+                const QUrl url(ownCloudInfo::instance()->webdavUrl());
+                int closed = Utility::shutdownConnections(url.port(url.scheme() == QLatin1String("https") ? 443 : 80));
+                MirallConfigFile cfg;
+                if( cfg.proxyType() == QNetworkProxy::HttpProxy ) {
+                    closed += Utility::shutdownConnections(cfg.proxyPort());
+                }
+                qDebug() << "Shut down" << closed << "connections of the sync";
+            }
+            if( !_scheduleQueue.contains(_currentSyncFolder) ) {
+                _scheduleQueue.prepend(_currentSyncFolder);
+            }
+        }
+    } else {
+        qDebug() << "Network is back, checking all folders.";
+        setSyncEnabled(true);
+        slotStartupScheduleFolders();
+    }
+}
+
+void FolderMan::slotStartupEtagsRetreived(const QString& etag, const QHash<QString, QString>& childEtags)
+{
+    const QString alias = _startupEtagJobs.take(sender());
+    Folder *f = folder(alias);
+    if( !f ) return;
+
+    _startupEtags.insert(alias, etag);
+    JournalVerifier *verifier = new JournalVerifier(alias, f->path(), f->journalDbFile(),
+                                                    f->ignoredPatterns(), childEtags);
+    connect(verifier, SIGNAL(verified(QString,bool,QString)),
+            this, SLOT(slotJournalVerified(QString,bool,QString)), Qt::QueuedConnection);
+    _verifierPool->start(verifier);
+}
+
+void FolderMan::slotStartupEtagsFailed()
+{
+    const QString alias = _startupEtagJobs.take(sender());
+    // let the regular sync find out what is wrong.
+    slotJournalVerified(alias, true, QLatin1String("can not fetch the remote etags"));
+}
+
+void FolderMan::slotJournalVerified(const QString& alias, bool needsSync, const QString& reason)
+{
+    if( JournalVerifier *verifier = qobject_cast<JournalVerifier*>(sender()) ) {
+        verifier->deleteLater();
+    }
+    const QString etag = _startupEtags.take(alias);
+    Folder *f = folder(alias);
+    // a check that was still running when the startup got cancelled
+    if( !f || !_syncEnabled ) return;
+
+    if( !needsSync ) {
+        f->setInSyncAtStartup(etag);
+        return;
+    }
+
+    qDebug() << "Folder" << alias << "needs a startup sync:" << reason;
+    if( !_startupQueue.contains(alias) ) {
+        _startupQueue.enqueue(alias);
+    }
+    if( !_startupTimer->isActive() ) {
+        // the first one goes right away, the others are spread out.
+        slotStartupScheduleNext();
+    }
+}
+
+void FolderMan::slotStartupScheduleNext()
+{
+    if( _startupQueue.isEmpty() ) return;
+
+    slotScheduleSync( _startupQueue.dequeue() );
+    _startupTimer->start(MirallConfigFile().startupStaggerInterval());
+}
+
 /*
   * if a folder wants to be synced, it calls this slot and is added
   * to the queue. The slot to actually start a sync is called afterwards.
@@ -385,12 +532,26 @@ void FolderMan::slotScheduleFolderSync()
 
     qDebug() << "XX slotScheduleFolderSync: folderQueue size: " << _scheduleQueue.count();
     if( ! _scheduleQueue.isEmpty() ) {
+        // the server asked to be left alone for a while, keep the queue.
+        const qint64 wait = ServerBackoff::instance()->remaining(
+                    ServerBackoff::serverKey(QUrl(ownCloudInfo::instance()->webdavUrl())));
+        if( wait > 0 ) {
+            qDebug() << "FolderMan: Server busy, scheduling again in" << wait << "ms";
+            QTimer::singleShot(int(wait) + 100, this, SLOT(slotScheduleFolderSync()));
+            return;
+        }
+
         const QString alias = _scheduleQueue.dequeue();
         if( _folderMap.contains( alias ) ) {
             ownCloudInfo::instance()->getQuotaRequest("/");
             Folder *f = _folderMap[alias];
             if( f->syncEnabled() ) {
                 _currentSyncFolder = alias;
+                if( _prefetcher->takeResult(alias, f->lastEtag()) == RemoteDiscoveryPrefetcher::ManyChanges ) {
+                    f->setRecursiveRemoteDiscovery();
+                }
+                // the next ones are prefetched once the size of this
+                // sync is known, see slotFolderProgress()
                 f->startSync( QStringList() );
             }
         }
@@ -410,10 +571,74 @@ void FolderMan::slotFolderSyncFinished( const SyncResult& )
 {
     qDebug() << "<===================================== sync finished for " << _currentSyncFolder;
 
+    const QString alias = _currentSyncFolder;
     _currentSyncFolder.clear();
+    _prefetchTimer->stop();
+
+    Folder *f = _folderMap.value(alias);
+    if( f ) {
+        MoveMatcher *matcher = MoveMatcher::instance();
+        matcher->syncFinished(f->path());
+        if( !matcher->holdsDeletes(f->path()) ) {
+            _heldDeleteFolders.remove(alias);
+        } else if( !_heldDeleteFolders.contains(alias) ) {
+            // what was moved out is matched by the folder it went to. Sync
+            // the others first, then this one again to release the deletes.
+            _heldDeleteFolders.insert(alias);
+            foreach( Folder *other, _folderMap.values() ) {
+                if( other != f && !_scheduleQueue.contains(other->alias()) ) {
+                    _scheduleQueue.enqueue(other->alias());
+                }
+            }
+            if( !_scheduleQueue.contains(alias) ) {
+                _scheduleQueue.enqueue(alias);
+            }
+            QTimer::singleShot(MoveMatcher::maxHoldMsec() + 1000, this, SLOT(slotReleaseHeldDeletes()));
+        }
+    }
     QTimer::singleShot(200, this, SLOT(slotScheduleFolderSync()));
 }
 
+void FolderMan::slotFolderProgress( const QString& folder, const Progress::Info& progress )
+{
+    if( progress.kind != Progress::StartSync || folder != _currentSyncFolder ) {
+        return;
+    }
+
+    // A prefetch is only used while the server did not change, so for a
+    // long sync it starts a minute before the expected end, not right away.
+    const qint64 downloadBytes = progress.overall_transmission_size - progress.upload_transmission_size;
+    const qint64 secs = ProgressDispatcher::instance()->estimatedDuration(folder,
+                            progress.upload_transmission_size, downloadBytes);
+    if( secs > prefetchLeadSecs ) {
+        qDebug() << "FolderMan: sync of" << folder << "takes about" << secs << "s, prefetching later";
+        _prefetchTimer->start(int(qMin(secs - prefetchLeadSecs, qint64(24 * 3600)) * 1000));
+    } else {
+        slotPrefetchNext();
+    }
+}
+
+void FolderMan::slotPrefetchNext()
+{
+    if( _currentSyncFolder.isEmpty() ) {
+        return;
+    }
+    // the next ones look at the server while this one syncs
+    for( int i = 0; i < qMin(2, _scheduleQueue.size()); ++i ) {
+        Folder *next = _folderMap.value(_scheduleQueue.at(i));
+        if( next && next->syncEnabled() ) {
+            _prefetcher->prefetch(next);
+        }
+    }
+}
+
+void FolderMan::slotReleaseHeldDeletes()
+{
+    foreach( const QString& alias, _heldDeleteFolders ) {
+        slotScheduleSync(alias);
+    }
+}
+
 void FolderMan::addFolderDefinition(const QString& alias, const QString& sourceFolder, const QString& targetPath )
 {
     QString escapedAlias = escapeAlias(alias);
@@ -472,6 +697,7 @@ void FolderMan::removeFolder( const QString& alias )
     Folder *f = 0;
 
     _scheduleQueue.removeAll(alias);
+    _prefetcher->takeResult(alias, QString());
 
     if( _folderMap.contains( alias )) {
         qDebug() << "Removing " << alias;
@@ -19,17 +19,22 @@
 #include <QObject>
 #include <QQueue>
 #include <QList>
+#include <QSet>
 
 #include "mirall/folder.h"
 #include "mirall/folderwatcher.h"
 #include "mirall/syncfileitem.h"
 
 class QSignalMapper;
+class QThreadPool;
+class QTimer;
 
 class SyncResult;
 
 namespace Mirall {
 
+class RemoteDiscoveryPrefetcher;
+
 class FolderMan : public QObject
 {
     Q_OBJECT
@@ -112,6 +117,23 @@ public slots:
 
     void slotScheduleAllFolders();
 
+    /**
+     * Schedules the folders after the connection was validated. If enabled
+     * in the config, the journals are checked against the local tree and
+     * the server first and only folders with changes get synced, one
+     * after another with a delay in between.
+     */
+    void slotStartupScheduleFolders();
+    /** Drops the pending startup checks and the staggered startup syncs. */
+    void cancelStartupSyncs();
+
+    /**
+     * Pauses syncing as soon as the network is gone, without waiting for
+     * timeouts of the running requests. The aborted sync is queued again
+     * and all folders get checked once the network is back.
+     */
+    void slotNetworkStateChanged( bool online );
+
     void setDirtyProxy(bool value = true);
 
 private slots:
@@ -121,6 +143,19 @@ private slots:
     // slot to take the next folder from queue and start syncing.
     void slotScheduleFolderSync();
 
+    // startup check of the folders, see slotStartupScheduleFolders()
+    void slotStartupEtagsRetreived(const QString& etag, const QHash<QString, QString>& childEtags);
+    void slotStartupEtagsFailed();
+    void slotJournalVerified(const QString& alias, bool needsSync, const QString& reason);
+    void slotStartupScheduleNext();
+
+    // the folders with held back deletes sync again, see MoveMatcher
+    void slotReleaseHeldDeletes();
+
+    // plans the prefetch of the next folders once the size of the current sync is known
+    void slotFolderProgress( const QString& folder, const Progress::Info& progress );
+    void slotPrefetchNext();
+
 private:
     // finds all folder configuration files
     // and create the folders
@@ -143,6 +178,15 @@ private:
     QQueue<QString> _scheduleQueue;
     bool            _dirtyProxy; // If the proxy need to be re-configured
 
+    QHash<QObject*, QString> _startupEtagJobs; // etag job -> alias
+    QHash<QString, QString>  _startupEtags;    // alias -> etag of the folder
+    QQueue<QString> _startupQueue;             // folders that need a startup sync
+    QTimer         *_startupTimer;
+    QThreadPool    *_verifierPool;
+    RemoteDiscoveryPrefetcher *_prefetcher;    // for the queued folders
+    QTimer         *_prefetchTimer;
+    QSet<QString>   _heldDeleteFolders;        // aliases, see MoveMatcher
+
     explicit FolderMan(QObject *parent = 0);
     static FolderMan *_instance;
 
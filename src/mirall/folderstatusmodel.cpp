@@ -58,6 +58,50 @@ FolderStatusDelegate::~FolderStatusDelegate()
   // TODO Auto-generated destructor stub
 }
 
+const QFont& FolderStatusDelegate::font( FontKind kind, const QFont& optionFont ) const
+{
+  if( optionFont != _optionFont ) {
+      _optionFont = optionFont;
+      _aliasFont = optionFont;
+      _aliasFont.setBold(true);
+      _aliasFont.setPointSize( optionFont.pointSize()+2 );
+      _progressFont = optionFont;
+      _progressFont.setPointSize( optionFont.pointSize()-1);
+      _elidedTexts.clear();
+  }
+  switch( kind ) {
+  case AliasFont:
+      return _aliasFont;
+  case ProgressFont:
+      return _progressFont;
+  default:
+      break;
+  }
+  return _optionFont;
+}
+
+QString FolderStatusDelegate::elidedText( FontKind kind, const QFontMetrics& fm, const QString& text,
+                                          Qt::TextElideMode mode, int width ) const
+{
+  ElideKey key;
+  key.text = text;
+  key.width = width;
+  key.mode = mode;
+  key.font = kind;
+
+  QHash<ElideKey, QString>::const_iterator it = _elidedTexts.constFind(key);
+  if( it != _elidedTexts.constEnd() ) {
+      return it.value();
+  }
+  // the progress texts change all the time, do not let them pile up.
+  if( _elidedTexts.size() > 200 ) {
+      _elidedTexts.clear();
+  }
+  const QString elided = fm.elidedText(text, mode, width);
+  _elidedTexts.insert(key, elided);
+  return elided;
+}
+
 //alocate each item size in listview.
 QSize FolderStatusDelegate::sizeHint(const QStyleOptionViewItem & option ,
                                    const QModelIndex & index) const
@@ -105,15 +149,10 @@ void FolderStatusDelegate::paint(QPainter *painter, const QStyleOptionViewItem &
 
   painter->save();
 
-  QFont aliasFont = option.font;
-  QFont subFont   = option.font;
-  QFont errorFont = subFont;
-  QFont progressFont = subFont;
-
-  progressFont.setPointSize( subFont.pointSize()-1);
-  //font.setPixelSize(font.weight()+);
-  aliasFont.setBold(true);
-  aliasFont.setPointSize( subFont.pointSize()+2 );
+  const QFont& aliasFont    = font( AliasFont, option.font );
+  const QFont& subFont      = font( SubFont, option.font );
+  const QFont& errorFont    = subFont;
+  const QFont& progressFont = font( ProgressFont, option.font );
 
   QFontMetrics subFm( subFont );
   QFontMetrics aliasFm( aliasFont );
@@ -193,7 +232,7 @@ void FolderStatusDelegate::paint(QPainter *painter, const QStyleOptionViewItem &
   } else {
       painter->setPen(option.palette.color(QPalette::Text));
   }
-  QString elidedAlias = aliasFm.elidedText(aliasText, Qt::ElideRight, aliasRect.width());
+  QString elidedAlias = elidedText(AliasFont, aliasFm, aliasText, Qt::ElideRight, aliasRect.width());
   painter->setFont(aliasFont);
   painter->drawText(aliasRect, elidedAlias);
 
@@ -201,15 +240,15 @@ void FolderStatusDelegate::paint(QPainter *painter, const QStyleOptionViewItem &
   QString elidedRemotePathText;
 
   if (remotePath.isEmpty() || remotePath == QLatin1String("/")) {
-      elidedRemotePathText = subFm.elidedText(tr("Syncing all files in your account with"),
-                                              Qt::ElideRight, remotePathRect.width());
+      elidedRemotePathText = elidedText(SubFont, subFm, tr("Syncing all files in your account with"),
+                                        Qt::ElideRight, remotePathRect.width());
   } else {
-      elidedRemotePathText = subFm.elidedText(tr("Remote path: %1").arg(remotePath),
-                                              Qt::ElideMiddle, remotePathRect.width());
+      elidedRemotePathText = elidedText(SubFont, subFm, tr("Remote path: %1").arg(remotePath),
+                                        Qt::ElideMiddle, remotePathRect.width());
   }
   painter->drawText(remotePathRect, elidedRemotePathText);
 
-  QString elidedPathText = subFm.elidedText(pathText, Qt::ElideMiddle, localPathRect.width());
+  QString elidedPathText = elidedText(SubFont, subFm, pathText, Qt::ElideMiddle, localPathRect.width());
   painter->drawText(localPathRect, elidedPathText);
 
   // paint an error overlay if there is an error string
@@ -237,7 +276,7 @@ void FolderStatusDelegate::paint(QPainter *painter, const QStyleOptionViewItem &
       int y = errorTextRect.top()+aliasMargin/2 + subFm.height()/2;
 
       foreach( QString eText, errorTexts ) {
-          painter->drawText(x, y, subFm.elidedText( eText, Qt::ElideLeft, errorTextRect.width()-2*aliasMargin));
+          painter->drawText(x, y, elidedText(SubFont, subFm, eText, Qt::ElideLeft, errorTextRect.width()-2*aliasMargin));
           y += subFm.height();
       }
 
@@ -293,9 +332,9 @@ void FolderStatusDelegate::paint(QPainter *painter, const QStyleOptionViewItem &
       fileRect.setLeft( iconRect.left());
       fileRect.setWidth(overallWidth);
       fileRect.setHeight(fileNameTextHeight);
-      QString elidedText = progressFm.elidedText(itemString, Qt::ElideLeft, fileRect.width());
+      QString elidedItemText = elidedText(ProgressFont, progressFm, itemString, Qt::ElideLeft, fileRect.width());
 
-      painter->drawText( fileRect, Qt::AlignLeft+Qt::AlignVCenter, elidedText);
+      painter->drawText( fileRect, Qt::AlignLeft+Qt::AlignVCenter, elidedItemText);
 
       painter->restore();
   }
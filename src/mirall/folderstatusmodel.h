@@ -17,6 +17,7 @@
 
 #include <QStyledItemDelegate>
 #include <QStandardItemModel>
+#include <QHash>
 
 namespace Mirall {
 
@@ -58,7 +59,33 @@ class FolderStatusDelegate : public QStyledItemDelegate
                       const QModelIndex& index );
 
 private:
+    enum FontKind { SubFont, AliasFont, ProgressFont };
+
+    struct ElideKey {
+        QString text;
+        int width;
+        int mode;
+        int font;
+        bool operator==( const ElideKey& other ) const {
+            return width == other.width && mode == other.mode && font == other.font && text == other.text;
+        }
+        friend uint qHash( const ElideKey& key ) {
+            return qHash(key.text) ^ (key.width << 8) ^ (key.mode << 4) ^ key.font;
+        }
+    };
+
+    const QFont& font( FontKind kind, const QFont& optionFont ) const;
+    QString elidedText( FontKind kind, const QFontMetrics& fm, const QString& text,
+                        Qt::TextElideMode mode, int width ) const;
+
     bool _addProgressSpace;
+
+    // paint() is called for every progress update, the fonts and the
+    // elided texts are kept until the font of the view changes.
+    mutable QFont _optionFont;
+    mutable QFont _aliasFont;
+    mutable QFont _progressFont;
+    mutable QHash<ElideKey, QString> _elidedTexts;
 };
 
 } // namespace Mirall
@@ -17,6 +17,7 @@
 #include "mirall/folder.h"
 #include "mirall/inotify.h"
 #include "mirall/fileutils.h"
+#include "mirall/latencyprobe.h"
 
 #include <stdint.h>
 
@@ -54,9 +55,8 @@ FolderWatcher::FolderWatcher(const QString &root, QObject *parent)
     _processTimer->setSingleShot(true);
     QObject::connect(_processTimer, SIGNAL(timeout()), this, SLOT(slotProcessTimerTimeout()));
 
-    // do a first synchronization to get changes while
-    // the application was not running
-    setProcessTimer();
+    // changes done while the application was not running are picked up
+    // by the startup check of the FolderMan, see slotStartupScheduleFolders()
 }
 
 FolderWatcher::~FolderWatcher()
@@ -145,6 +145,7 @@ void FolderWatcher::slotProcessTimerTimeout()
         _pendingPathes.clear();
         //qDebug() << lastEventTime << eventTime;
         qDebug() << "  * Notify" << notifyPaths.size() << "change items for" << root();
+        LatencyProbe::instance()->localChangesNotified(notifyPaths);
         emit folderChanged(notifyPaths);
     }
 }
@@ -168,6 +169,7 @@ void FolderWatcher::changeDetected(const QString& f)
         return;
     }
 
+    LatencyProbe::instance()->localChangeDetected(f);
     _pendingPathes[f] = 1; //_pendingPathes[path]+mask;
     setProcessTimer();
 }
@@ -182,6 +184,11 @@ void FolderWatcher::removePath(const QString &path )
     _d->removePath(path);
 }
 
+int FolderWatcher::watchCount() const
+{
+    return _d->watchCount();
+}
+
 
 } // namespace Mirall
 
@@ -97,6 +97,12 @@ public:
     void addPath(const QString&);
     void removePath(const QString&);
 
+    /**
+     * Number of watches registered with the OS, one per directory for
+     * the backends that are not recursive.
+     */
+    int watchCount() const;
+
 public slots:
     /**
      * Enabled or disables folderChanged() events.
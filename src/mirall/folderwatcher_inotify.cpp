@@ -18,6 +18,7 @@
 #include "mirall/inotify.h"
 #include "mirall/folderwatcher.h"
 #include "mirall/fileutils.h"
+#include "mirall/latencyprobe.h"
 
 #include "mirall/folderwatcher_inotify.h"
 
@@ -134,13 +135,6 @@ void FolderWatcherPrivate::slotINotifyEvent(int mask, int /*cookie*/, const QStr
 
      QStringList ignores = _parent->ignores();
 
-     if( path.endsWith(".csync_journal.db.ctmp") ||
-            path.endsWith(".csync_journal.db.ctmp-journal") ||
-            path.endsWith(".csync_journal.db")) {
-        qDebug() << " ** Inotify ignored for " <<path;
-        return;
-    }
-
     foreach (const QString& pattern, ignores) {
         QRegExp regexp(pattern);
         regexp.setPatternSyntax(QRegExp::Wildcard);
@@ -160,6 +154,7 @@ void FolderWatcherPrivate::slotINotifyEvent(int mask, int /*cookie*/, const QStr
         }
     }
 
+    LatencyProbe::instance()->localChangeDetected(path);
     if( !_parent->_pendingPathes.contains( path )) {
         _parent->_pendingPathes[path] = 0;
     }
@@ -167,6 +162,11 @@ void FolderWatcherPrivate::slotINotifyEvent(int mask, int /*cookie*/, const QStr
     _parent->setProcessTimer();
 }
 
+int FolderWatcherPrivate::watchCount() const
+{
+    return _inotify->directories().count();
+}
+
 void FolderWatcherPrivate::removePath(const QString &path )
 {
     if (_inotify->directories().contains(path) ) {
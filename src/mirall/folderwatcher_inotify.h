@@ -28,6 +28,7 @@ public:
     FolderWatcherPrivate(FolderWatcher *p);
     void addPath(const QString &path) { slotAddFolderRecursive(path);  }
     void removePath(const QString &);
+    int watchCount() const;
 signals:
     void error(const QString& error);
 private slots:
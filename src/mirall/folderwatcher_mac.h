@@ -33,6 +33,7 @@ public:
 
     void addPath(const QString &) {}
     void removePath(const QString &) {}
+    int watchCount() const { return 1; }
 
     void startWatching();
     void doNotifyParent();
@@ -51,6 +51,7 @@ public:
 
     void addPath(const QString &) {}
     void removePath(const QString &) {}
+    int watchCount() const { return 1; }
 
 private:
     FolderWatcher *_parent;
@@ -17,18 +17,18 @@
 #include "mirall/owncloudinfo.h"
 #include "mirall/mirallconfigfile.h"
 #include "mirall/theme.h"
+#include "mirall/remotefoldermodel.h"
 
 #include <QDebug>
 #include <QDesktopServices>
 #include <QDir>
 #include <QFileDialog>
 #include <QFileInfo>
-#include <QFileIconProvider>
 #include <QInputDialog>
 #include <QUrl>
 #include <QValidator>
 #include <QWizardPage>
-#include <QTreeWidget>
+#include <QTreeView>
 
 #include <stdlib.h>
 
@@ -172,19 +172,22 @@ FolderWizardTargetPage::FolderWizardTargetPage()
     _ui.setupUi(this);
     _ui.warnFrame->hide();
 
+    _model = new RemoteFolderModel(this);
+    _ui.folderTreeView->setModel(_model);
+
     connect(_ui.addFolderButton, SIGNAL(clicked()), SLOT(slotAddRemoteFolder()));
     connect(_ui.refreshButton, SIGNAL(clicked()), SLOT(slotRefreshFolders()));
-    connect(_ui.folderTreeWidget, SIGNAL(itemClicked(QTreeWidgetItem*,int)), SIGNAL(completeChanged()));
-    connect(_ui.folderTreeWidget, SIGNAL(itemActivated(QTreeWidgetItem*,int)), SIGNAL(completeChanged()));
+    connect(_ui.folderTreeView, SIGNAL(clicked(QModelIndex)), SIGNAL(completeChanged()));
+    connect(_ui.folderTreeView, SIGNAL(activated(QModelIndex)), SIGNAL(completeChanged()));
 }
 
 void FolderWizardTargetPage::slotAddRemoteFolder()
 {
-    QTreeWidgetItem *current = _ui.folderTreeWidget->currentItem();
+    QModelIndex current = _ui.folderTreeView->currentIndex();
 
     QString parent('/');
-    if (current) {
-        parent = current->data(0, Qt::UserRole).toString();
+    if (current.isValid()) {
+        parent = _model->path(current);
     }
 
     QInputDialog *dlg = new QInputDialog(this);
@@ -216,72 +219,10 @@ void FolderWizardTargetPage::slotCreateRemoteFolderFinished( QNetworkReply::Netw
   }
 }
 
-static QTreeWidgetItem* findFirstChild(QTreeWidgetItem *parent, const QString& text)
-{
-    for (int i = 0; i < parent->childCount(); ++i) {
-        QTreeWidgetItem *child = parent->child(i);
-        if (child->text(0) == text) {
-            return child;
-        }
-    }
-    return 0;
-}
-
-static void recursiveInsert(QTreeWidgetItem *parent, QStringList pathTrail, QString path)
-{
-    QFileIconProvider prov;
-    QIcon folderIcon = prov.icon(QFileIconProvider::Folder);
-    if (pathTrail.size() == 0) {
-        if (path.endsWith('/')) {
-            path.chop(1);
-        }
-        parent->setToolTip(0, path);
-        parent->setData(0, Qt::UserRole, path);
-    } else {
-        QTreeWidgetItem *item = findFirstChild(parent, pathTrail.first());
-        if (!item) {
-            item = new QTreeWidgetItem(parent);
-            item->setIcon(0, folderIcon);
-            item->setText(0, pathTrail.first());
-            item->setData(0, Qt::UserRole, pathTrail.first());
-            item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
-        }
-
-        pathTrail.removeFirst();
-        recursiveInsert(item, pathTrail, path);
-    }
-}
-
-void FolderWizardTargetPage::slotUpdateDirectories(QStringList list)
-{
-    QString webdavFolder = QUrl(ownCloudInfo::instance()->webdavUrl()).path();
-
-    QTreeWidgetItem *root = _ui.folderTreeWidget->topLevelItem(0);
-    if (!root) {
-        root = new QTreeWidgetItem(_ui.folderTreeWidget);
-        root->setText(0, Theme::instance()->appNameGUI());
-        root->setIcon(0, Theme::instance()->applicationIcon());
-        root->setToolTip(0, tr("Choose this to sync the entire account"));
-        root->setData(0, Qt::UserRole, "/");
-    }
-    foreach (QString path, list) {
-        path.remove(webdavFolder);
-        QStringList paths = path.split('/');
-        if (paths.last().isEmpty()) paths.removeLast();
-        recursiveInsert(root, paths, path);
-    }
-    root->setExpanded(true);
-}
-
 void FolderWizardTargetPage::slotRefreshFolders()
 {
-    ownCloudInfo::instance()->getDirectoryListing("/");
-    _ui.folderTreeWidget->clear();
-}
-
-void FolderWizardTargetPage::slotItemExpanded(QTreeWidgetItem *item)
-{
-    ownCloudInfo::instance()->getDirectoryListing(item->data(0, Qt::UserRole).toString());
+    _model->refresh();
+    _ui.folderTreeView->expand(_model->accountIndex());
 }
 
 FolderWizardTargetPage::~FolderWizardTargetPage()
@@ -290,10 +231,10 @@ FolderWizardTargetPage::~FolderWizardTargetPage()
 
 bool FolderWizardTargetPage::isComplete() const
 {
-    if (!_ui.folderTreeWidget->currentItem())
+    if (!_ui.folderTreeView->currentIndex().isValid())
         return false;
 
-    QString dir = _ui.folderTreeWidget->currentItem()->data(0, Qt::UserRole).toString();
+    QString dir = _model->path(_ui.folderTreeView->currentIndex());
     wizard()->setProperty("targetPath", dir);
 
     Folder::Map map = _folderMap;
@@ -337,10 +278,6 @@ void FolderWizardTargetPage::initializePage()
                  SLOT(slotDirCheckReply(QString,QNetworkReply*)));
         connect( ocInfo, SIGNAL(webdavColCreated(QNetworkReply::NetworkError)),
                  SLOT(slotCreateRemoteFolderFinished( QNetworkReply::NetworkError )));
-        connect( ocInfo, SIGNAL(directoryListingUpdated(QStringList)),
-                 SLOT(slotUpdateDirectories(QStringList)));
-        connect(_ui.folderTreeWidget, SIGNAL(itemExpanded(QTreeWidgetItem*)),
-                SLOT(slotItemExpanded(QTreeWidgetItem*)));
 
         slotRefreshFolders();
     }
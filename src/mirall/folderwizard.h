@@ -27,6 +27,7 @@
 namespace Mirall {
 
 class ownCloudInfo;
+class RemoteFolderModel;
 
 /**
  * page to ask for the local source folder
@@ -77,11 +78,10 @@ protected slots:
     void slotAddRemoteFolder();
     void slotCreateRemoteFolder(QString);
     void slotCreateRemoteFolderFinished( QNetworkReply::NetworkError error );
-    void slotUpdateDirectories(QStringList);
     void slotRefreshFolders();
-    void slotItemExpanded(QTreeWidgetItem*);
 private:
     Ui_FolderWizardTargetPage _ui;
+    RemoteFolderModel *_model;
     ownCloudInfo *_ownCloudDirCheck;
     bool _dirChecked;
     bool _warnWasVisible;
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/journallocation.h"
+#include "mirall/mirallconfigfile.h"
+#include "mirall/utility.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+namespace Mirall {
+
+static const char journalNameC[] = ".csync_journal.db";
+// SQLite's rollback journal, it is named after the path the database was opened with
+static const char rollbackSuffixC[] = "-journal";
+// csync's copy of the journal while it writes the new one
+static const char ctmpSuffixC[] = ".ctmp";
+
+QString JournalLocation::externalDirectory(const QString &localPath)
+{
+    MirallConfigFile cfg;
+    const QByteArray key = QDir::cleanPath(QDir(localPath).absolutePath()).toUtf8();
+    const QString hash = QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex());
+    return cfg.journalDirectory() + QLatin1Char('/') + hash;
+}
+
+bool JournalLocation::wantExternal(const QString &localPath)
+{
+    MirallConfigFile cfg;
+    const QString location = cfg.journalLocation();
+    if (location == QLatin1String("local")) {
+        return true;
+    } else if (location == QLatin1String("auto")) {
+        // only worth it when the journal directory itself is local
+        QDir().mkpath(cfg.journalDirectory());
+        return Utility::isNetworkFileSystem(localPath)
+                && !Utility::isNetworkFileSystem(cfg.journalDirectory());
+    }
+    return false;
+}
+
+// rename does not work across file systems, which is the point here.
+bool JournalLocation::moveFile(const QString &from, const QString &to)
+{
+    QFile::remove(to);
+    if (QFile::rename(from, to)) {
+        return true;
+    }
+    // a copy only gets the final name once it is complete
+    const QString partial = to + QLatin1String(".part");
+    QFile::remove(partial);
+    if (!QFile::copy(from, partial) || !QFile::rename(partial, to)) {
+        qDebug() << "JournalLocation: could not copy" << from << "to" << to;
+        QFile::remove(partial);
+        return false;
+    }
+    if (!QFile::remove(from)) {
+        qDebug() << "JournalLocation: could not remove" << from;
+        QFile::remove(to);
+        return false;
+    }
+    return true;
+}
+
+// SQLite rolls a hot journal back the next time the database is opened,
+// until then the database must not be taken away from it.
+bool JournalLocation::hasRollbackJournal(const QString &journal)
+{
+    return QFile::exists(journal + QLatin1String(rollbackSuffixC));
+}
+
+QString JournalLocation::prepare(const QString &localPath)
+{
+    const QString rootJournal = QDir(localPath).filePath(QLatin1String(journalNameC));
+    const QString dir = externalDirectory(localPath);
+    const QString external = QDir(dir).filePath(QLatin1String(journalNameC));
+
+    // an older version reached the external journal through a link in the root
+    const QFileInfo rootInfo(rootJournal);
+    if (rootInfo.isSymLink()) {
+        QFile::remove(rootJournal);
+    }
+
+    const bool toExternal = wantExternal(localPath);
+    if (toExternal && !QDir().mkpath(dir)) {
+        qDebug() << "JournalLocation: can not create" << dir << ", the journal stays in the sync root";
+        return localPath;
+    }
+    const QString from = toExternal ? rootJournal : external;
+    const QString to = toExternal ? external : rootJournal;
+
+    if (QFile::exists(from)) {
+        if (hasRollbackJournal(from)) {
+            qDebug() << "JournalLocation: the journal" << from
+                     << "has a rollback journal, not moving it before it was opened";
+            return QFileInfo(from).absolutePath();
+        }
+        if (QFile::exists(to)) {
+            // both exist after a crash in the middle of a move, the target
+            // is the complete one because the source is removed last.
+            qDebug() << "JournalLocation: removing the stale journal" << from;
+            removeJournal(from);
+        } else if (!moveFile(from, to)) {
+            qDebug() << "JournalLocation: keeping the journal in" << from;
+            return QFileInfo(from).absolutePath();
+        } else {
+            qDebug() << "JournalLocation: moved the journal of" << localPath << "to" << QFileInfo(to).absolutePath();
+        }
+    }
+    return toExternal ? dir : localPath;
+}
+
+bool JournalLocation::removeJournal(const QString &journal)
+{
+    // csync's temporary copy and the rollback journals of both
+    QFile::remove(journal + QLatin1String(rollbackSuffixC));
+    QFile::remove(journal + QLatin1String(ctmpSuffixC));
+    QFile::remove(journal + QLatin1String(ctmpSuffixC) + QLatin1String(rollbackSuffixC));
+    return !QFile::exists(journal) || QFile::remove(journal);
+}
+
+bool JournalLocation::remove(const QString &localPath)
+{
+    const QString rootJournal = QDir(localPath).filePath(QLatin1String(journalNameC));
+    const QString external = QDir(externalDirectory(localPath)).filePath(QLatin1String(journalNameC));
+    bool ok = removeJournal(external);
+    if (QFileInfo(rootJournal).isSymLink()) {
+        QFile::remove(rootJournal);
+    }
+    return removeJournal(rootJournal) && ok;
+}
+
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_JOURNALLOCATION_H
+#define MIRALL_JOURNALLOCATION_H
+
+#include <QString>
+
+namespace Mirall {
+
+/**
+ * @brief Decides where the sync journal of a folder is kept.
+ *
+ * By default the journal lives in the sync root. With the Journal/location
+ * setting it can be moved to a local per folder directory, which keeps
+ * SQLite off network file systems and its writes out of the watched tree.
+ *
+ * csync and the SyncJournalDb both open the journal at the path prepare()
+ * decided on, so SQLite's rollback journal and csync's .ctmp copy are
+ * created next to it. Switching the setting migrates an existing journal
+ * in either direction, but never while it has a rollback journal.
+ */
+class JournalLocation
+{
+public:
+    /**
+     * Moves the journal of the sync root to where the settings want it and
+     * returns the directory the journal has to be opened in. If it can not
+     * be moved, that is where it is now.
+     */
+    static QString prepare(const QString &localPath);
+
+    /** The directory an external journal of the sync root is kept in. */
+    static QString externalDirectory(const QString &localPath);
+
+    /** Removes the journal of the sync root and its temporary files, wherever they are. */
+    static bool remove(const QString &localPath);
+
+private:
+    static bool wantExternal(const QString &localPath);
+    static bool hasRollbackJournal(const QString &journal);
+    static bool moveFile(const QString &from, const QString &to);
+    static bool removeJournal(const QString &journal);
+};
+
+}
+
+#endif // MIRALL_JOURNALLOCATION_H
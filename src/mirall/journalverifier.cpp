@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/journalverifier.h"
+#include "mirall/syncfileitem.h"
+#include "mirall/resourcegovernor.h"
+
+#include <QDebug>
+#include <QDateTime>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#ifndef Q_OS_WIN
+#include <sys/stat.h>
+#endif
+
+namespace Mirall {
+
+JournalVerifier::JournalVerifier(const QString& alias, const QString& localPath,
+                                 const QString& journalFile, const QStringList& ignores,
+                                 const QHash<QString, QString>& remoteEtags)
+    : QObject(), QRunnable(),
+      _alias(alias),
+      _localPath(localPath),
+      _journalFile(journalFile),
+      _remoteEtags(remoteEtags)
+{
+    setAutoDelete(false);
+
+    if( !_localPath.endsWith(QLatin1Char('/')) ) {
+        _localPath.append(QLatin1Char('/'));
+    }
+
+    foreach( QString pattern, ignores ) {
+        // a leading ] only means "remove the file" to csync.
+        if( pattern.startsWith(QLatin1Char(']')) ) {
+            pattern.remove(0, 1);
+        }
+        if( pattern.isEmpty() ) continue;
+        _ignores.append(QRegExp(pattern, Qt::CaseSensitive, QRegExp::Wildcard));
+    }
+}
+
+void JournalVerifier::run()
+{
+    QString reason;
+    bool needsSync = true;
+
+    // Only stats, no disk slot: with the few slots of the governor the
+    // verifiers would run one after the other behind a sync. The thread
+    // pool of FolderMan already bounds how many run at the same time.
+    ResourceGovernor::instance()->applyToCurrentThread();
+    if( !loadJournal(&reason) ) {
+        // no usable journal, csync has to do the full thing.
+    } else if( compareRemote(&reason) && compareLocal(&reason) ) {
+        needsSync = false;
+    }
+    _entries.clear();
+
+    emit verified(_alias, needsSync, reason);
+}
+
+bool JournalVerifier::loadJournal(QString *reason)
+{
+    if( !QFile::exists(_journalFile) ) {
+        *reason = QLatin1String("no journal");
+        return false;
+    }
+
+    bool ok = true;
+    const QString connectionName = QString::fromLatin1("JournalVerifier_%1").arg(quintptr(this));
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase( QLatin1String("QSQLITE"), connectionName );
+        db.setDatabaseName(_journalFile);
+        db.setConnectOptions(QLatin1String("QSQLITE_OPEN_READONLY"));
+
+        if( !db.open() ) {
+            *reason = QLatin1String("can not open journal: ") + db.lastError().text();
+            ok = false;
+        } else {
+            QSqlQuery query(db);
+            // filesize might not exist in old journals, fall back to not comparing it.
+            if( !query.exec(QLatin1String("SELECT path, inode, modtime, type, md5, filesize FROM metadata")) &&
+                    !query.exec(QLatin1String("SELECT path, inode, modtime, type, md5, 0 FROM metadata")) ) {
+                *reason = QLatin1String("can not read journal: ") + query.lastError().text();
+                ok = false;
+            }
+            while( ok && query.next() ) {
+                Entry e;
+                e._inode   = query.value(1).toULongLong();
+                e._modtime = query.value(2).toLongLong();
+                e._isDir   = query.value(3).toInt() == SyncFileItem::Directory;
+                e._etag    = query.value(4).toString();
+                e._size    = query.value(5).toULongLong();
+                _entries.insert(query.value(0).toString(), e);
+            }
+            query.finish();
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    if( ok && _entries.isEmpty() ) {
+        *reason = QLatin1String("journal is empty");
+        ok = false;
+    }
+    return ok;
+}
+
+bool JournalVerifier::compareRemote(QString *reason)
+{
+    QHashIterator<QString, QString> it(_remoteEtags);
+    while( it.hasNext() ) {
+        it.next();
+        if( isIgnored(it.key(), it.key()) ) continue;
+
+        QHash<QString, Entry>::const_iterator entry = _entries.constFind(it.key());
+        if( entry == _entries.constEnd() ) {
+            *reason = QLatin1String("new on server: ") + it.key();
+            return false;
+        }
+        if( entry->_etag != it.value() ) {
+            *reason = QLatin1String("etag changed on server: ") + it.key();
+            return false;
+        }
+    }
+
+    // top level entries the journal knows, but the server does not have anymore.
+    QHashIterator<QString, Entry> jit(_entries);
+    while( jit.hasNext() ) {
+        jit.next();
+        if( !jit.key().contains(QLatin1Char('/')) && !_remoteEtags.contains(jit.key()) ) {
+            *reason = QLatin1String("removed on server: ") + jit.key();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JournalVerifier::compareLocal(QString *reason)
+{
+    QDirIterator dirIt(_localPath, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System,
+                       QDirIterator::Subdirectories);
+    QStringList skippedDirs;
+    while( dirIt.hasNext() ) {
+        dirIt.next();
+        const QFileInfo fi = dirIt.fileInfo();
+        const QString relPath = dirIt.filePath().mid(_localPath.length());
+
+        bool inSkippedDir = false;
+        foreach( const QString& dir, skippedDirs ) {
+            if( relPath.startsWith(dir) ) {
+                inSkippedDir = true;
+                break;
+            }
+        }
+        if( inSkippedDir ) {
+            continue;
+        }
+        if( fi.isSymLink() || isIgnored(relPath, fi.fileName()) ) {
+            if( fi.isDir() ) {
+                skippedDirs.append(relPath + QLatin1Char('/'));
+            }
+            continue;
+        }
+
+        QHash<QString, Entry>::iterator entry = _entries.find(relPath);
+        if( entry == _entries.end() ) {
+            *reason = QLatin1String("new local file: ") + relPath;
+            return false;
+        }
+        entry->_seen = true;
+
+        if( entry->_isDir != fi.isDir() ) {
+            *reason = QLatin1String("type changed: ") + relPath;
+            return false;
+        }
+        if( entry->_isDir ) {
+            // the journal keeps the remote mtime of directories, only
+            // the existence is of interest.
+            continue;
+        }
+        if( fi.lastModified().toTime_t() != entry->_modtime ) {
+            *reason = QLatin1String("mtime changed: ") + relPath;
+            return false;
+        }
+        if( entry->_size > 0 && quint64(fi.size()) != entry->_size ) {
+            *reason = QLatin1String("size changed: ") + relPath;
+            return false;
+        }
+#ifndef Q_OS_WIN
+        struct stat sb;
+        if( stat(QFile::encodeName(dirIt.filePath()).constData(), &sb) == 0
+                && quint64(sb.st_ino) != entry->_inode ) {
+            *reason = QLatin1String("inode changed: ") + relPath;
+            return false;
+        }
+#endif
+    }
+
+    QHashIterator<QString, Entry> it(_entries);
+    while( it.hasNext() ) {
+        it.next();
+        if( !it.value()._seen ) {
+            *reason = QLatin1String("removed locally: ") + it.key();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JournalVerifier::isIgnored(const QString& relativePath, const QString& fileName) const
+{
+    // the journal itself and the temporary files of unfinished downloads.
+    if( fileName.startsWith(QLatin1String(".csync_journal.db")) ||
+            (fileName.startsWith(QLatin1Char('.')) && fileName.contains(QLatin1String(".~"))) ) {
+        return true;
+    }
+
+    foreach( const QRegExp& regexp, _ignores ) {
+        if( regexp.exactMatch(relativePath) || regexp.exactMatch(fileName) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
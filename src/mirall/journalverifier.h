@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_JOURNALVERIFIER_H
+#define MIRALL_JOURNALVERIFIER_H
+
+#include <QObject>
+#include <QRunnable>
+#include <QHash>
+#include <QRegExp>
+#include <QStringList>
+
+namespace Mirall {
+
+/**
+ * @brief Cheap check whether a folder needs a full sync at startup.
+ *
+ * Compares the local tree (inode, size and mtime) and the etags of the
+ * remote top level entries against the sync journal, without involving
+ * csync. It is meant to run on a thread pool, one instance per folder,
+ * and reports through the verified() signal.
+ *
+ * The verifier opens its own read only database connection, it does not
+ * touch the SyncJournalDb of the folder. It does not take a disk slot of
+ * the ResourceGovernor, the pass is light and bounded by the pool size.
+ */
+class JournalVerifier : public QObject, public QRunnable
+{
+    Q_OBJECT
+public:
+    JournalVerifier(const QString& alias, const QString& localPath,
+                    const QString& journalFile, const QStringList& ignores,
+                    const QHash<QString, QString>& remoteEtags);
+
+    void run();
+
+signals:
+    /**
+     * @param alias the folder alias
+     * @param needsSync true if any difference to the journal was found
+     * @param reason human readable hint for the log
+     */
+    void verified(const QString& alias, bool needsSync, const QString& reason);
+
+private:
+    struct Entry {
+        Entry() : _inode(0), _modtime(0), _size(0), _isDir(false), _seen(false) {}
+        quint64 _inode;
+        qint64  _modtime;
+        quint64 _size;
+        QString _etag;
+        bool    _isDir;
+        bool    _seen;
+    };
+
+    bool loadJournal(QString *reason);
+    bool compareRemote(QString *reason);
+    bool compareLocal(QString *reason);
+    bool isIgnored(const QString& relativePath, const QString& fileName) const;
+
+    QString _alias;
+    QString _localPath;
+    QString _journalFile;
+    QList<QRegExp> _ignores;
+    QHash<QString, QString> _remoteEtags;
+    QHash<QString, Entry> _entries;
+};
+
+}
+
+#endif // MIRALL_JOURNALVERIFIER_H
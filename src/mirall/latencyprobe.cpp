@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/latencyprobe.h"
+#include "mirall/mirallconfigfile.h"
+
+#include <QDir>
+#include <QMutexLocker>
+
+#include <algorithm>
+
+namespace Mirall {
+
+// the percentiles are taken over the most recent samples of a stage
+static const int maxSamples = 10000;
+
+LatencyProbe::LatencyProbe()
+    : _enabled(MirallConfigFile().latencyProbe() ? 1 : 0)
+{
+    _clock.start();
+}
+
+LatencyProbe *LatencyProbe::instance()
+{
+    static LatencyProbe probe;
+    return &probe;
+}
+
+bool LatencyProbe::isEnabled()
+{
+    return _enabled.fetchAndAddRelaxed(0) != 0;
+}
+
+void LatencyProbe::setEnabled(bool enabled)
+{
+    _enabled.fetchAndStoreRelaxed(enabled ? 1 : 0);
+}
+
+void LatencyProbe::reset()
+{
+    QMutexLocker lock(&_mutex);
+    _localChanges.clear();
+    _remoteChanges.clear();
+    for (int o = 0; o < OriginCount; ++o) {
+        for (int s = 0; s < StageCount; ++s) {
+            _samples[o][s].clear();
+        }
+    }
+}
+
+QString LatencyProbe::stageName(Stage stage)
+{
+    switch (stage) {
+    case Notify:      return QLatin1String("notify");
+    case Queue:       return QLatin1String("queue");
+    case Discovery:   return QLatin1String("discovery");
+    case Propagation: return QLatin1String("propagation");
+    case Total:       return QLatin1String("total");
+    default:          return QString();
+    }
+}
+
+void LatencyProbe::localChangeDetected(const QString &path)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    QMutexLocker lock(&_mutex);
+    // the first change is the one somebody waits for
+    const QString key = QDir::cleanPath(path);
+    if (!_localChanges.contains(key)) {
+        _localChanges[key].detected = _clock.elapsed();
+    }
+}
+
+void LatencyProbe::localChangesNotified(const QStringList &paths)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    QMutexLocker lock(&_mutex);
+    const qint64 now = _clock.elapsed();
+    foreach (const QString &path, paths) {
+        QHash<QString, Change>::iterator it = _localChanges.find(QDir::cleanPath(path));
+        if (it != _localChanges.end() && it->notified < 0) {
+            it->notified = now;
+        }
+    }
+}
+
+void LatencyProbe::remoteChangeDetected(const QString &folderPath)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    QMutexLocker lock(&_mutex);
+    const QString key = QDir::cleanPath(folderPath);
+    if (!_remoteChanges.contains(key)) {
+        _remoteChanges[key].detected = _clock.elapsed();
+    }
+}
+
+void LatencyProbe::syncStarted(const QString &folderPath)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    QMutexLocker lock(&_mutex);
+    const qint64 now = _clock.elapsed();
+    const QString folder = QDir::cleanPath(folderPath);
+    const QString prefix = folder + QLatin1Char('/');
+    for (QHash<QString, Change>::iterator it = _localChanges.begin(); it != _localChanges.end(); ++it) {
+        if (it->started < 0 && it.key().startsWith(prefix)) {
+            it->started = now;
+        }
+    }
+    QHash<QString, Change>::iterator remote = _remoteChanges.find(folder);
+    if (remote != _remoteChanges.end() && remote->started < 0) {
+        remote->started = now;
+    }
+}
+
+void LatencyProbe::discoveryFinished(const QString &folderPath)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    QMutexLocker lock(&_mutex);
+    const qint64 now = _clock.elapsed();
+    const QString folder = QDir::cleanPath(folderPath);
+    const QString prefix = folder + QLatin1Char('/');
+    for (QHash<QString, Change>::iterator it = _localChanges.begin(); it != _localChanges.end(); ++it) {
+        if (it->started >= 0 && it->discovered < 0 && it.key().startsWith(prefix)) {
+            it->discovered = now;
+        }
+    }
+    QHash<QString, Change>::iterator remote = _remoteChanges.find(folder);
+    if (remote != _remoteChanges.end() && remote->started >= 0 && remote->discovered < 0) {
+        remote->discovered = now;
+    }
+}
+
+void LatencyProbe::itemCommitted(const QString &folderPath, const SyncFileItem &item)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    if (item._status != SyncFileItem::Success && item._status != SyncFileItem::Conflict) {
+        return;
+    }
+    QMutexLocker lock(&_mutex);
+    const qint64 now = _clock.elapsed();
+    const QString folder = QDir::cleanPath(folderPath);
+
+    if (item._dir == SyncFileItem::Down) {
+        QHash<QString, Change>::const_iterator remote = _remoteChanges.constFind(folder);
+        if (remote != _remoteChanges.constEnd() && remote->discovered >= 0) {
+            record(RemoteChange, *remote, now);
+        }
+        return;
+    }
+    if (item._dir != SyncFileItem::Up) {
+        return;
+    }
+
+    // files in a new directory may have been seen as the directory only
+    const QString file = QDir::cleanPath(folder + QLatin1Char('/') + item._file);
+    QString path = file;
+    while (path.size() > folder.size()) {
+        QHash<QString, Change>::iterator it = _localChanges.find(path);
+        if (it != _localChanges.end()) {
+            if (it->discovered >= 0) {
+                record(LocalChange, *it, now);
+                if (path == file) {
+                    _localChanges.erase(it);
+                }
+            }
+            return;
+        }
+        path = path.left(path.lastIndexOf(QLatin1Char('/')));
+    }
+}
+
+void LatencyProbe::syncFinished(const QString &folderPath)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    QMutexLocker lock(&_mutex);
+    const QString folder = QDir::cleanPath(folderPath);
+    const QString prefix = folder + QLatin1Char('/');
+    // what is left went through the sync without a job, or failed
+    QHash<QString, Change>::iterator it = _localChanges.begin();
+    while (it != _localChanges.end()) {
+        if (it->started >= 0 && it.key().startsWith(prefix)) {
+            it = _localChanges.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    QHash<QString, Change>::iterator remote = _remoteChanges.find(folder);
+    if (remote != _remoteChanges.end() && remote->started >= 0) {
+        _remoteChanges.erase(remote);
+    }
+}
+
+void LatencyProbe::record(Origin origin, const Change &change, qint64 now)
+{
+    if (change.notified >= 0) {
+        addSample(origin, Notify, change.notified - change.detected);
+    }
+    addSample(origin, Queue, change.started - (change.notified >= 0 ? change.notified : change.detected));
+    addSample(origin, Discovery, change.discovered - change.started);
+    addSample(origin, Propagation, now - change.discovered);
+    addSample(origin, Total, now - change.detected);
+}
+
+void LatencyProbe::addSample(Origin origin, Stage stage, qint64 msec)
+{
+    QVector<qint64> &samples = _samples[origin][stage];
+    if (samples.size() >= maxSamples) {
+        samples.remove(0);
+    }
+    samples.append(msec);
+}
+
+qint64 LatencyProbe::percentileLocked(Origin origin, Stage stage, double p) const
+{
+    QVector<qint64> sorted = _samples[origin][stage];
+    if (sorted.isEmpty()) {
+        return -1;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    const int index = qBound(0, int(p / 100.0 * sorted.size() + 0.5) - 1, sorted.size() - 1);
+    return sorted.at(index);
+}
+
+qint64 LatencyProbe::percentile(Origin origin, Stage stage, double p)
+{
+    QMutexLocker lock(&_mutex);
+    return percentileLocked(origin, stage, p);
+}
+
+int LatencyProbe::sampleCount(Origin origin, Stage stage)
+{
+    QMutexLocker lock(&_mutex);
+    return _samples[origin][stage].size();
+}
+
+QString LatencyProbe::report()
+{
+    QMutexLocker lock(&_mutex);
+    QStringList parts;
+    for (int o = 0; o < OriginCount; ++o) {
+        const Origin origin = Origin(o);
+        if (_samples[origin][Total].isEmpty()) {
+            continue;
+        }
+        QStringList stages;
+        for (int s = 0; s < StageCount; ++s) {
+            const Stage stage = Stage(s);
+            if (_samples[origin][stage].isEmpty()) {
+                continue;
+            }
+            stages.append(QString::fromLatin1("%1 %2/%3/%4").arg(stageName(stage))
+                          .arg(percentileLocked(origin, stage, 50))
+                          .arg(percentileLocked(origin, stage, 90))
+                          .arg(percentileLocked(origin, stage, 99)));
+        }
+        parts.append(QString::fromLatin1("%1 changes (%2): %3")
+                     .arg(origin == LocalChange ? QLatin1String("local") : QLatin1String("remote"))
+                     .arg(_samples[origin][Total].size())
+                     .arg(stages.join(QLatin1String(", "))));
+    }
+    if (parts.isEmpty()) {
+        return QString();
+    }
+    return QLatin1String("latency in ms, p50/p90/p99, ") + parts.join(QLatin1String("; "));
+}
+
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_LATENCYPROBE_H
+#define MIRALL_LATENCYPROBE_H
+
+#include "mirall/syncfileitem.h"
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace Mirall {
+
+/**
+ * @brief Measures how long a change takes to reach the other side.
+ *
+ * A local change is stamped when the FolderWatcher sees it and followed
+ * through the watcher's delay (Notify), the FolderMan queue (Queue),
+ * csync's update and reconcile (Discovery) and the job that commits it
+ * (Propagation). A remote change is stamped when the etag poll notices
+ * it, it has no Notify stage. The poll only tells that something in the
+ * folder changed, all downloads of the following sync count from there.
+ *
+ * Enabled with Instrumentation/latencyProbe in the config file. The
+ * percentiles of the stages are logged after each sync.
+ *
+ * The watcher and the etag poll run in the main thread, the sync in its
+ * own, hence the mutex.
+ */
+class LatencyProbe
+{
+public:
+    enum Origin { LocalChange, RemoteChange, OriginCount };
+    enum Stage { Notify, Queue, Discovery, Propagation, Total, StageCount };
+
+    static LatencyProbe *instance();
+
+    bool isEnabled();
+    void setEnabled(bool enabled);
+
+    /** Forgets the pending changes and the samples. */
+    void reset();
+
+    /** The watcher saw the file or directory change. */
+    void localChangeDetected(const QString &path);
+    /** The watcher's delay is over, the paths go to the FolderMan. */
+    void localChangesNotified(const QStringList &paths);
+    /** The etag poll found the folder changed on the server. */
+    void remoteChangeDetected(const QString &folderPath);
+
+    void syncStarted(const QString &folderPath);
+    /** update and reconcile are done, the jobs start */
+    void discoveryFinished(const QString &folderPath);
+    void itemCommitted(const QString &folderPath, const SyncFileItem &item);
+    void syncFinished(const QString &folderPath);
+
+    /** msec the stage took at the percentile (0 to 100), -1 without samples */
+    qint64 percentile(Origin origin, Stage stage, double p);
+    int sampleCount(Origin origin, Stage stage);
+
+    /** p50/p90/p99 of the stages, empty if there are no samples */
+    QString report();
+
+    static QString stageName(Stage stage);
+
+private:
+    LatencyProbe();
+
+    struct Change {
+        Change() : detected(-1), notified(-1), started(-1), discovered(-1) {}
+        qint64 detected;
+        qint64 notified;
+        qint64 started;
+        qint64 discovered;
+    };
+
+    void record(Origin origin, const Change &change, qint64 now);
+    void addSample(Origin origin, Stage stage, qint64 msec);
+    qint64 percentileLocked(Origin origin, Stage stage, double p) const;
+
+    QAtomicInt _enabled;
+    QMutex _mutex;
+    QElapsedTimer _clock;
+    QHash<QString, Change> _localChanges;   // by clean absolute path
+    QHash<QString, Change> _remoteChanges;  // by clean folder path
+    QVector<qint64> _samples[OriginCount][StageCount];
+};
+
+}
+
+#endif // MIRALL_LATENCYPROBE_H
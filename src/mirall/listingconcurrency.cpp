@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/listingconcurrency.h"
+#include "mirall/mirallconfigfile.h"
+
+#include <QDebug>
+
+namespace Mirall {
+
+// weight of a new sample in the smoothed latency
+static const double latencySmoothing = 0.2;
+// the listings per second have to improve by this factor to raise the level
+static const double rateGain = 1.05;
+// latency above best * factor counts as a spike
+static const double latencySpike = 3.0;
+// latency above best * factor stops the increase
+static const double latencyStable = 1.5;
+// a window has level * this many listings
+static const int windowPerLevel = 4;
+
+ListingConcurrency* ListingConcurrency::_instance = 0;
+
+ListingConcurrency* ListingConcurrency::instance()
+{
+    if( !_instance ) {
+        MirallConfigFile cfg;
+        _instance = new ListingConcurrency(cfg.listingConcurrency());
+        _instance->_persistent = true;
+    }
+    return _instance;
+}
+
+ListingConcurrency::ListingConcurrency(int level, int minimum, int maximum)
+    : _level(level),
+      _minimum(minimum),
+      _maximum(maximum),
+      _persistent(false),
+      _windowCount(0),
+      _lastRate(0),
+      _latency(0),
+      _bestLatency(0)
+{
+    _level = qBound(_minimum, level, _maximum);
+    resetWindow();
+}
+
+void ListingConcurrency::setLevel(int level)
+{
+    _level = qBound(_minimum, level, _maximum);
+    resetWindow();
+    levelChanged();
+}
+
+void ListingConcurrency::resetWindow()
+{
+    _windowCount = 0;
+    _windowTime.start();
+}
+
+void ListingConcurrency::levelChanged()
+{
+    if( _persistent ) {
+        MirallConfigFile cfg;
+        cfg.setListingConcurrency(_level);
+    }
+}
+
+void ListingConcurrency::decrease()
+{
+    const int level = qMax(_minimum, _level / 2);
+    resetWindow();
+    // the window before had more listings in flight, do not compare to it
+    _lastRate = 0;
+    if( level != _level ) {
+        qDebug() << "Listing concurrency decreased from" << _level << "to" << level;
+        _level = level;
+        levelChanged();
+    }
+}
+
+void ListingConcurrency::reportListing(qint64 msecs)
+{
+    if( msecs >= 0 ) {
+        _latency = _latency > 0 ? latencySmoothing * msecs + (1.0 - latencySmoothing) * _latency
+                                : double(msecs);
+        if( _bestLatency <= 0 || _latency < _bestLatency ) {
+            _bestLatency = _latency;
+        }
+        if( _bestLatency > 0 && _latency > latencySpike * _bestLatency ) {
+            qDebug() << "Listing latency spike:" << _latency << "ms, best" << _bestLatency << "ms";
+            // do not punish the next window with the same spike.
+            _latency = _bestLatency * latencyStable;
+            decrease();
+            return;
+        }
+    }
+
+    if( ++_windowCount < _level * windowPerLevel ) {
+        return;
+    }
+
+    const qint64 elapsed = qMax(qint64(1), _windowTime.elapsed());
+    const double rate = _windowCount * 1000.0 / elapsed;
+    const bool latencyOk = _bestLatency <= 0 || _latency <= latencyStable * _bestLatency;
+    if( latencyOk && rate > _lastRate * rateGain && _level < _maximum ) {
+        _level++;
+        qDebug() << "Listing concurrency increased to" << _level << "at" << rate << "listings/s";
+        levelChanged();
+    }
+    _lastRate = rate;
+    resetWindow();
+}
+
+void ListingConcurrency::reportFailure()
+{
+    decrease();
+}
+
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_LISTINGCONCURRENCY_H
+#define MIRALL_LISTINGCONCURRENCY_H
+
+#include <QElapsedTimer>
+
+namespace Mirall {
+
+/**
+ * @brief Finds how many directory listings the server takes at once.
+ *
+ * Additive increase, multiplicative decrease over the finished
+ * RequestDirectoryEtagsJob listings: after each window of listings the
+ * level goes up by one if more of them got done per second than in the
+ * window before and their latency stayed close to the best one seen.
+ * Timeouts, 5xx replies and latency spikes halve it.
+ *
+ * The remote folder picker and the RemoteDiscoveryPrefetcher start at most
+ * level() listings at the same time. The level of instance() is kept per
+ * connection in the config. The sync itself runs its requests one after
+ * the other on the neon session of csync and is not affected.
+ *
+ * Main thread only, like the QNAM jobs that feed it.
+ */
+class ListingConcurrency
+{
+public:
+    static ListingConcurrency* instance();
+
+    explicit ListingConcurrency(int level = 2, int minimum = 1, int maximum = 8);
+
+    int level() const { return _level; }
+    void setLevel(int level);
+
+    /** A listing finished successfully after @p msecs. */
+    void reportListing(qint64 msecs);
+
+    /** A listing failed because of a timeout or a 5xx reply. */
+    void reportFailure();
+
+private:
+    void decrease();
+    void resetWindow();
+    void levelChanged();
+
+    int  _level;
+    int  _minimum;
+    int  _maximum;
+    bool _persistent; // instance() saves its level
+
+    QElapsedTimer _windowTime;
+    int    _windowCount;
+    double _lastRate;     // listings per second of the previous window
+
+    double _latency;      // smoothed duration of a listing in msec
+    double _bestLatency;  // lowest smoothed latency seen
+
+    static ListingConcurrency* _instance;
+};
+
+}
+
+#endif // MIRALL_LISTINGCONCURRENCY_H
@@ -13,6 +13,7 @@
  */
 
 #include "mirall/logger.h"
+#include "mirall/allocstats.h"
 
 #include <QDir>
 #include <QStringList>
@@ -23,6 +24,7 @@ namespace Mirall {
 void mirallLogCatcher(QtMsgType type, const char *msg)
 {
   Q_UNUSED(type)
+  AllocScope allocScope(AllocStats::LoggingPhase);
   // qDebug() exports to local8Bit, which is not always UTF-8
   Logger::instance()->mirallLog( QString::fromLocal8Bit(msg) );
 }
@@ -69,6 +71,7 @@ void Logger::postGuiMessage(const QString &title, const QString &message)
 
 void Logger::log(Log log)
 {
+    AllocScope allocScope(AllocStats::LoggingPhase);
     QString msg;
     if( _showTime ) {
         msg = log.timeStamp.toString(QLatin1String("MM-dd hh:mm:ss:zzz")) + QLatin1Char(' ');
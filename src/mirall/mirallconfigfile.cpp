@@ -25,9 +25,19 @@
 
 #include <QWidget>
 #include <QCoreApplication>
+#include <QDateTime>
+#include <QUrl>
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+#include <QDesktopServices>
+#else
+#include <QStandardPaths>
+#endif
 
 #define DEFAULT_REMOTE_POLL_INTERVAL 30000 // default remote poll time in milliseconds
+#define DEFAULT_MAX_REMOTE_POLL_INTERVAL 300000 // dormant folders are not polled less often
 #define DEFAULT_MAX_LOG_LINES 20000
+#define DEFAULT_SERVER_INFO_CACHE_TTL 86400 // one day, in seconds
+#define DEFAULT_LISTING_CONCURRENCY 2
 
 namespace Mirall {
 
@@ -36,7 +46,13 @@ static const char authTypeC[] = "authType";
 
 static const char caCertsKeyC[] = "CaCertificates";
 static const char remotePollIntervalC[] = "remotePollInterval";
+static const char maxRemotePollIntervalC[] = "maxRemotePollInterval";
 static const char forceSyncIntervalC[] = "forceSyncInterval";
+static const char serverVersionC[] = "serverVersion";
+static const char serverVersionCheckedC[] = "serverVersionChecked";
+static const char serverInfoCacheTTLC[] = "serverInfoCacheTTL";
+static const char tarArchivesC[] = "tarArchives";
+static const char listingConcurrencyC[] = "listingConcurrency";
 static const char monoIconsC[] = "monoIcons";
 static const char optionalDesktopNoficationsC[] = "optionalDesktopNotifications";
 static const char skipUpdateCheckC[] = "skipUpdateCheck";
@@ -54,6 +70,27 @@ static const char useDownloadLimitC[] = "BWLimit/useDownloadLimit";
 static const char uploadLimitC[]      = "BWLimit/uploadLimit";
 static const char downloadLimitC[]    = "BWLimit/downloadLimit";
 
+static const char startupVerifyJournalC[]   = "StartupSync/verifyJournal";
+static const char startupStaggerIntervalC[] = "StartupSync/staggerInterval";
+static const char startupVerifierThreadsC[] = "StartupSync/verifierThreads";
+
+static const char journalLocationC[]  = "Journal/location";
+static const char journalDirectoryC[] = "Journal/directory";
+
+static const char seedInitialSyncC[]    = "InitialSync/seedFromLocal";
+static const char seedMtimeToleranceC[] = "InitialSync/seedMtimeTolerance";
+
+static const char governorIoIdleC[]            = "ResourceGovernor/ioIdle";
+static const char governorNiceLevelC[]         = "ResourceGovernor/niceLevel";
+static const char governorMaxDiskJobsC[]       = "ResourceGovernor/maxDiskJobs";
+static const char governorThrottleOnBatteryC[] = "ResourceGovernor/throttleOnBattery";
+static const char governorLoadThresholdC[]     = "ResourceGovernor/loadThreshold";
+
+static const char latencyProbeC[] = "Instrumentation/latencyProbe";
+static const char syncTraceDirectoryC[] = "Instrumentation/syncTraceDirectory";
+
+static const char throughputGroupC[] = "Throughput";
+
 static const char seenVersionC[] = "Updater/seenVersion";
 static const char maxLogLinesC[] = "Logging/maxLogLines";
 
@@ -408,6 +445,16 @@ void MirallConfigFile::setRemotePollInterval(int interval, const QString &connec
     settings.sync();
 }
 
+int MirallConfigFile::maxRemotePollInterval( const QString& connection ) const
+{
+    QString con( connection );
+    if( connection.isEmpty() ) con = defaultConnection();
+
+    const int interval = getValue( QLatin1String(maxRemotePollIntervalC), con,
+                                   DEFAULT_MAX_REMOTE_POLL_INTERVAL ).toInt();
+    return qMax(interval, remotePollInterval(connection));
+}
+
 quint64 MirallConfigFile::forceSyncInterval(const QString& connection) const
 {
     uint pollInterval = remotePollInterval(connection);
@@ -431,6 +478,81 @@ QString MirallConfigFile::ownCloudVersion() const
     return _oCVersion;
 }
 
+QString MirallConfigFile::cachedServerVersion( const QString& connection ) const
+{
+    QString con( connection );
+    if( connection.isEmpty() ) con = defaultConnection();
+
+    QSettings settings(configFile(), QSettings::IniFormat);
+    settings.setIniCodec("UTF-8");
+    int ttl = settings.value( QLatin1String(serverInfoCacheTTLC), DEFAULT_SERVER_INFO_CACHE_TTL ).toInt();
+    settings.beginGroup( con );
+
+    const QDateTime checked = settings.value( QLatin1String(serverVersionCheckedC) ).toDateTime();
+    if( !checked.isValid() || checked.secsTo(QDateTime::currentDateTime()) > ttl ) {
+        return QString::null;
+    }
+    return settings.value( QLatin1String(serverVersionC) ).toString();
+}
+
+void MirallConfigFile::setCachedServerVersion( const QString& version, const QString& connection )
+{
+    QString con( connection );
+    if( connection.isEmpty() ) con = defaultConnection();
+
+    QSettings settings(configFile(), QSettings::IniFormat);
+    settings.setIniCodec("UTF-8");
+    settings.beginGroup( con );
+    settings.setValue( QLatin1String(serverVersionC), version );
+    settings.setValue( QLatin1String(serverVersionCheckedC), QDateTime::currentDateTime() );
+    settings.sync();
+}
+
+void MirallConfigFile::clearCachedServerVersion( const QString& connection )
+{
+    QString con( connection );
+    if( connection.isEmpty() ) con = defaultConnection();
+
+    QSettings settings(configFile(), QSettings::IniFormat);
+    settings.setIniCodec("UTF-8");
+    settings.beginGroup( con );
+    settings.remove( QLatin1String(serverVersionC) );
+    settings.remove( QLatin1String(serverVersionCheckedC) );
+    settings.sync();
+}
+
+bool MirallConfigFile::serverSendsTarArchives( const QString& connection ) const
+{
+    QString con( connection );
+    if( connection.isEmpty() ) con = defaultConnection();
+
+    return getValue( QLatin1String(tarArchivesC), con, true ).toBool();
+}
+
+void MirallConfigFile::setServerSendsTarArchives( bool tar, const QString& connection )
+{
+    QString con( connection );
+    if( connection.isEmpty() ) con = defaultConnection();
+
+    setValue( con + QLatin1Char('/') + QLatin1String(tarArchivesC), tar );
+}
+
+int MirallConfigFile::listingConcurrency( const QString& connection ) const
+{
+    QString con( connection );
+    if( connection.isEmpty() ) con = defaultConnection();
+
+    return getValue( QLatin1String(listingConcurrencyC), con, DEFAULT_LISTING_CONCURRENCY ).toInt();
+}
+
+void MirallConfigFile::setListingConcurrency( int level, const QString& connection )
+{
+    QString con( connection );
+    if( connection.isEmpty() ) con = defaultConnection();
+
+    setValue( con + QLatin1Char('/') + QLatin1String(listingConcurrencyC), level );
+}
+
 void MirallConfigFile::setOwnCloudVersion( const QString& ver)
 {
     qDebug() << "** Setting ownCloud Server version to " << ver;
@@ -642,6 +764,118 @@ void MirallConfigFile::setDownloadLimit(int kbytes)
     setValue(downloadLimitC, kbytes);
 }
 
+bool MirallConfigFile::startupVerifyJournal() const
+{
+    return getValue(startupVerifyJournalC, QString::null, true).toBool();
+}
+
+void MirallConfigFile::setStartupVerifyJournal(bool enable)
+{
+    setValue(startupVerifyJournalC, enable);
+}
+
+int MirallConfigFile::startupStaggerInterval() const
+{
+    int interval = getValue(startupStaggerIntervalC, QString::null, 5000).toInt();
+    if( interval < 0 ) {
+        interval = 0;
+    }
+    return interval;
+}
+
+int MirallConfigFile::startupVerifierThreads() const
+{
+    int threads = getValue(startupVerifierThreadsC, QString::null, 2).toInt();
+    if( threads < 1 ) {
+        threads = 1;
+    }
+    return threads;
+}
+
+QString MirallConfigFile::journalLocation() const
+{
+    return getValue(journalLocationC, QString::null, QLatin1String("auto")).toString();
+}
+
+void MirallConfigFile::setJournalLocation(const QString& location)
+{
+    setValue(journalLocationC, location);
+}
+
+QString MirallConfigFile::journalDirectory() const
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+    const QString cache = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#else
+    const QString cache = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#endif
+    return getValue(journalDirectoryC, QString::null, cache + QLatin1String("/journals")).toString();
+}
+
+bool MirallConfigFile::seedInitialSync() const
+{
+    return getValue(seedInitialSyncC, QString::null, false).toBool();
+}
+
+void MirallConfigFile::setSeedInitialSync(bool enable)
+{
+    setValue(seedInitialSyncC, enable);
+}
+
+int MirallConfigFile::seedMtimeTolerance() const
+{
+    return qMax(0, getValue(seedMtimeToleranceC, QString::null, 2).toInt());
+}
+
+bool MirallConfigFile::governorIoIdle() const
+{
+    return getValue(governorIoIdleC, QString::null, true).toBool();
+}
+
+int MirallConfigFile::governorNiceLevel() const
+{
+    return qBound(0, getValue(governorNiceLevelC, QString::null, 10).toInt(), 19);
+}
+
+int MirallConfigFile::governorMaxDiskJobs() const
+{
+    return qMax(1, getValue(governorMaxDiskJobsC, QString::null, 2).toInt());
+}
+
+bool MirallConfigFile::governorThrottleOnBattery() const
+{
+    return getValue(governorThrottleOnBatteryC, QString::null, true).toBool();
+}
+
+double MirallConfigFile::governorLoadThreshold() const
+{
+    return getValue(governorLoadThresholdC, QString::null, 1.5).toDouble();
+}
+
+bool MirallConfigFile::latencyProbe() const
+{
+    return getValue(latencyProbeC, QString::null, false).toBool();
+}
+
+QString MirallConfigFile::syncTraceDirectory() const
+{
+    return getValue(syncTraceDirectoryC, QString::null, QString()).toString();
+}
+
+double MirallConfigFile::transferRate( const QString& alias, bool upload ) const
+{
+    const QString key = QString::fromLatin1(QUrl::toPercentEncoding(alias))
+            + (upload ? QLatin1String("_up") : QLatin1String("_down"));
+    return getValue(key, QLatin1String(throughputGroupC), 0.0).toDouble();
+}
+
+void MirallConfigFile::setTransferRate( const QString& alias, bool upload, double bytesPerSecond )
+{
+    const QString key = QString::fromLatin1(QUrl::toPercentEncoding(alias))
+            + (upload ? QLatin1String("_up") : QLatin1String("_down"));
+    setValue(QLatin1String(throughputGroupC) + QLatin1Char('/') + key, bytesPerSecond);
+}
+
 bool MirallConfigFile::monoIcons() const
 {
     QSettings settings(configFile(), QSettings::IniFormat);
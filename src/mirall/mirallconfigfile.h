@@ -61,6 +61,22 @@ public:
     QString ownCloudVersion() const;
     void setOwnCloudVersion( const QString& );
 
+    /* Server version as reported by the last successful status.php check,
+       empty if there was none or it is older than the cache TTL. */
+    QString cachedServerVersion( const QString& connection = QString() ) const;
+    void setCachedServerVersion( const QString&, const QString& connection = QString() );
+    void clearCachedServerVersion( const QString& connection = QString() );
+
+    /* False once the server answered a directory download with something
+       else than a tar stream, the client only extracts tar. */
+    bool serverSendsTarArchives( const QString& connection = QString() ) const;
+    void setServerSendsTarArchives( bool, const QString& connection = QString() );
+
+    /* Directory listings the server takes at once, as found by the
+       ListingConcurrency. */
+    int listingConcurrency( const QString& connection = QString() ) const;
+    void setListingConcurrency( int level, const QString& connection = QString() );
+
     // max count of lines in the log window
     int  maxLogLines() const;
     void setMaxLogLines(int);
@@ -73,6 +89,10 @@ public:
     /* Set poll interval. Value in microseconds has to be larger than 5000 */
     void setRemotePollInterval(int interval, const QString& connection = QString() );
 
+    /* Poll interval a folder without remote changes backs off to, in milliseconds.
+       Never below remotePollInterval(). */
+    int maxRemotePollInterval( const QString& connection = QString() ) const;
+
     /* Force sync interval, in milliseconds */
     quint64 forceSyncInterval(const QString &connection = QString()) const;
 
@@ -109,6 +129,48 @@ public:
     void setUploadLimit(int kbytes);
     void setDownloadLimit(int kbytes);
 
+    /** check the journals at startup instead of syncing all folders at once */
+    bool startupVerifyJournal() const;
+    void setStartupVerifyJournal(bool);
+    /** in milliseconds, delay between the startup syncs of folders that need one */
+    int startupStaggerInterval() const;
+    /** number of folders checked in parallel at startup */
+    int startupVerifierThreads() const;
+
+    /** where the sync journals are kept: "syncRoot", "local" (in journalDirectory())
+        or "auto", which is local only for sync roots on network file systems */
+    QString journalLocation() const;
+    void setJournalLocation(const QString&);
+    /** the per folder journal directories live in here when they are not in the sync root */
+    QString journalDirectory() const;
+
+    /** adopt local files that match the server on the first sync of a folder
+        instead of downloading them, for data restored from a backup */
+    bool seedInitialSync() const;
+    void setSeedInitialSync(bool);
+    /** in seconds, the mtime difference that still counts as the same file
+        when seeding, backups and FAT round the mtime */
+    int seedMtimeTolerance() const;
+
+    // resource governor, see ResourceGovernor
+    bool governorIoIdle() const;
+    /** 0 to 19 */
+    int governorNiceLevel() const;
+    /** local discovery, hashing, comparisons and download writes running at once */
+    int governorMaxDiskJobs() const;
+    bool governorThrottleOnBattery() const;
+    /** load average per core above which the limits get tightened, 0 disables */
+    double governorLoadThreshold() const;
+
+    /** measure how long changes take to reach the other side, see LatencyProbe */
+    bool latencyProbe() const;
+    /** where to record the workload of the folders, see SyncTraceRecorder, empty for none */
+    QString syncTraceDirectory() const;
+
+    /** smoothed transfer rate of a folder in bytes per second, see ProgressDispatcher */
+    double transferRate( const QString& alias, bool upload ) const;
+    void setTransferRate( const QString& alias, bool upload, double bytesPerSecond );
+
     static void setConfDir(const QString &value);
 
     bool optionalDesktopNotifications() const;
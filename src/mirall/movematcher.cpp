@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/movematcher.h"
+#include "mirall/syncjournaldb.h"
+#include "mirall/syncjournalfilerecord.h"
+#include "mirall/syncfileitem.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+
+namespace Mirall {
+
+// held deletes go out after this even if not all folders synced
+static const int maxHoldMsecC = 5 * 60 * 1000;
+// a folder that does not sync does not collect more pending creates
+static const int maxPendingCreatesC = 10000;
+
+// The records of the journal where the column has the value. The journal
+// belongs to another folder, it is read with a connection of our own.
+static QList<SyncJournalFileRecord> readRecords(const QString &journalFile,
+                                                const QString &column, const QVariant &value)
+{
+    QList<SyncJournalFileRecord> records;
+    if( !QFileInfo(journalFile).exists() ) {
+        return records;
+    }
+    const QString connectionName = QString::fromLatin1("MoveMatcher_%1_%2")
+            .arg(quintptr(QThread::currentThread())).arg(qHash(journalFile));
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase( QLatin1String("QSQLITE"), connectionName );
+        db.setDatabaseName(journalFile);
+        db.setConnectOptions(QLatin1String("QSQLITE_OPEN_READONLY"));
+
+        if( !db.open() ) {
+            qDebug() << "MoveMatcher: can not open" << journalFile << db.lastError().text();
+        } else {
+            QSqlQuery query(db);
+            query.prepare(QLatin1String("SELECT path, inode, modtime, type, md5, fileid, filesize "
+                                        "FROM metadata WHERE ") + column + QLatin1String("=?"));
+            query.bindValue(0, value);
+            if( !query.exec() ) {
+                qDebug() << "MoveMatcher: can not read" << journalFile << query.lastError().text();
+            }
+            while( query.next() ) {
+                SyncJournalFileRecord rec;
+                rec._path     = query.value(0).toString();
+                rec._inode    = query.value(1).toULongLong();
+                rec._modtime  = QDateTime::fromTime_t(query.value(2).toLongLong());
+                rec._type     = query.value(3).toInt();
+                rec._etag     = query.value(4).toString();
+                rec._fileId   = query.value(5).toString();
+                rec._fileSize = query.value(6).toULongLong();
+                records.append(rec);
+            }
+            query.finish();
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    return records;
+}
+
+MoveMatcher::MoveMatcher()
+{
+}
+
+MoveMatcher *MoveMatcher::instance()
+{
+    static MoveMatcher matcher;
+    return &matcher;
+}
+
+int MoveMatcher::maxHoldMsec()
+{
+    return maxHoldMsecC;
+}
+
+void MoveMatcher::registerFolder(const QString &localPath, const QString &remotePath,
+                                 const QString &journalFile, QObject *owner)
+{
+    QMutexLocker lock(&_mutex);
+    Entry &entry = _folders[localPath];
+    entry.remotePath = remotePath;
+    if (!entry.remotePath.endsWith(QLatin1Char('/'))) {
+        entry.remotePath += QLatin1Char('/');
+    }
+    entry.journalFile = journalFile;
+    entry.owner = owner;
+}
+
+void MoveMatcher::unregisterFolder(const QString &localPath)
+{
+    QMutexLocker lock(&_mutex);
+    _folders.remove(localPath);
+}
+
+int MoveMatcher::folderCount()
+{
+    QMutexLocker lock(&_mutex);
+    return _folders.count();
+}
+
+MoveMatcher::Match MoveMatcher::findVanished(const QString &localPath, quint64 inode, bool isDirectory,
+                                             quint64 size, time_t modtime)
+{
+    // read the journals outside of the lock
+    QList<Match> candidates;
+    {
+        QMutexLocker lock(&_mutex);
+        QHash<QString, Entry>::const_iterator it;
+        for (it = _folders.constBegin(); it != _folders.constEnd(); ++it) {
+            if (it.key() == localPath || it->journalFile.isEmpty()) {
+                continue;
+            }
+            Match candidate;
+            candidate.localPath = it.key();
+            candidate.remotePath = it->remotePath;
+            candidate.journalFile = it->journalFile;
+            candidates.append(candidate);
+        }
+    }
+
+    foreach (Match match, candidates) {
+        QString root = match.localPath;
+        if (!root.endsWith(QLatin1Char('/'))) {
+            root += QLatin1Char('/');
+        }
+        // stored like SyncJournalDb::setFileRecord() does
+        const QList<SyncJournalFileRecord> records =
+                readRecords(match.journalFile, QLatin1String("inode"), qint64(inode));
+        foreach (const SyncJournalFileRecord &rec, records) {
+            if ((rec._type == SyncFileItem::Directory) != isDirectory) {
+                continue;
+            }
+            if (!isDirectory && (rec._fileSize != size || rec._modtime.toTime_t() != uint(modtime))) {
+                continue;
+            }
+            if (QFileInfo(root + rec._path).exists()) {
+                // a hard link or the inode was reused, it did not move
+                continue;
+            }
+            match.file = rec._path;
+            return match;
+        }
+    }
+    return Match();
+}
+
+SyncJournalFileRecord MoveMatcher::sourceRecord(const Match &match, const QString &file)
+{
+    if (!match.isValid()) {
+        return SyncJournalFileRecord();
+    }
+    const QList<SyncJournalFileRecord> records =
+            readRecords(match.journalFile, QLatin1String("phash"),
+                        QString::number(SyncJournalDb::getPHash(file)));
+    foreach (const SyncJournalFileRecord &rec, records) {
+        if (rec._path == file) {
+            return rec;
+        }
+    }
+    return SyncJournalFileRecord();
+}
+
+void MoveMatcher::moved(const Match &match)
+{
+    if (!match.isValid()) {
+        return;
+    }
+    QMutexLocker lock(&_mutex);
+    QObject *owner = _folders.value(match.localPath).owner;
+    if (owner) {
+        // the journal of the folder belongs to the thread of its owner
+        QMetaObject::invokeMethod(owner, "slotForgetMovedItem", Qt::QueuedConnection,
+                                  Q_ARG(QString, match.file));
+    }
+}
+
+void MoveMatcher::noteChanges(const QString &localPath, const QStringList &paths)
+{
+    if (folderCount() < 2) {
+        return;
+    }
+    // stat outside of the lock, the sync thread might be waiting for it
+    QList<QPair<quint64, qint64> > created; // inode and size, -1 for directories
+    foreach (const QString &path, paths) {
+        const QFileInfo fi(path);
+        if (!fi.exists()) {
+            continue;
+        }
+        SyncFileItem item;
+        item._file = path;
+        item._dir = SyncFileItem::Up;
+        created.append(qMakePair(SyncJournalFileRecord(item, path)._inode,
+                                 fi.isDir() ? qint64(-1) : fi.size()));
+    }
+
+    QMutexLocker lock(&_mutex);
+    if (!_folders.contains(localPath)) {
+        return;
+    }
+    Entry &entry = _folders[localPath];
+    for (int i = 0; i < created.size() && entry.createdInodes.size() < maxPendingCreatesC; ++i) {
+        entry.createdInodes.insert(created.at(i).first);
+        if (created.at(i).second >= 0) {
+            entry.createdSizes.insert(quint64(created.at(i).second));
+        }
+    }
+}
+
+bool MoveMatcher::isPendingCreate(const QString &localPath, quint64 inode, bool isDirectory, quint64 size)
+{
+    QMutexLocker lock(&_mutex);
+    QHash<QString, Entry>::const_iterator it;
+    for (it = _folders.constBegin(); it != _folders.constEnd(); ++it) {
+        if (it.key() == localPath) {
+            continue;
+        }
+        if (it->createdInodes.contains(inode) || (!isDirectory && it->createdSizes.contains(size))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MoveMatcher::holdDeletes(const QString &localPath)
+{
+    QMutexLocker lock(&_mutex);
+    if (_folders.count() < 2 || !_folders.contains(localPath)) {
+        return false;
+    }
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    Entry &entry = _folders[localPath];
+    if (entry.heldSince == 0) {
+        qDebug() << "MoveMatcher: holding the remote deletes of" << localPath << "back";
+        entry.heldSince = now;
+        return true;
+    }
+
+    bool othersSynced = true;
+    QHash<QString, Entry>::const_iterator it;
+    for (it = _folders.constBegin(); it != _folders.constEnd(); ++it) {
+        if (it.key() != localPath && it->lastSync <= entry.heldSince) {
+            othersSynced = false;
+        }
+    }
+    if (othersSynced || now - entry.heldSince > maxHoldMsecC) {
+        entry.heldSince = 0;
+        return false;
+    }
+    return true;
+}
+
+bool MoveMatcher::holdsDeletes(const QString &localPath)
+{
+    QMutexLocker lock(&_mutex);
+    return _folders.value(localPath).heldSince != 0;
+}
+
+void MoveMatcher::syncFinished(const QString &localPath)
+{
+    QMutexLocker lock(&_mutex);
+    if (_folders.contains(localPath)) {
+        Entry &entry = _folders[localPath];
+        entry.lastSync = QDateTime::currentMSecsSinceEpoch();
+        // the sync took care of them
+        entry.createdInodes.clear();
+        entry.createdSizes.clear();
+    }
+}
+
+}
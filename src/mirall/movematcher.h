@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_MOVEMATCHER_H
+#define MIRALL_MOVEMATCHER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include <time.h>
+
+namespace Mirall {
+
+class SyncJournalFileRecord;
+
+/**
+ * @brief Recognizes items moved from one sync folder into another.
+ *
+ * csync only sees renames within one folder. An item moved to another
+ * folder of the account shows up as a local delete in the source folder
+ * and as a new item in the destination, which would upload all of it
+ * again. The matcher knows the journals of all folders of the account:
+ * a new item whose inode, size and mtime match a record of another
+ * folder whose file is gone locally is moved on the server instead.
+ *
+ * For that the source must not delete the item on the server first. The
+ * watchers of the folders report what appeared in them, a remote delete
+ * whose item has the inode or the size of one of those is held back until
+ * every other folder had a sync, or at most a few minutes.
+ *
+ * Used from the sync thread and FolderMan, hence the mutex. The journals of
+ * the other folders are read with a read-only connection of the matcher,
+ * their SyncJournalDb belongs to the thread of that folder. The owner of a
+ * folder forgets a moved item in its slotForgetMovedItem(QString).
+ */
+class MoveMatcher
+{
+public:
+    static MoveMatcher *instance();
+
+    struct Match {
+        QString localPath;   // sync root the item vanished from
+        QString remotePath;  // remote root of that folder, ends with '/'
+        QString file;        // the item, relative to both roots
+        QString journalFile; // journal of that folder
+        bool isValid() const { return !journalFile.isEmpty(); }
+    };
+
+    /**
+     * A folder starts to sync, with its remote root and journal file. The
+     * owner lives as long as the registration and forgets moved items.
+     */
+    void registerFolder(const QString &localPath, const QString &remotePath,
+                        const QString &journalFile, QObject *owner);
+    void unregisterFolder(const QString &localPath);
+    int folderCount();
+
+    /**
+     * The item of another folder than localPath that has the inode and is
+     * gone from the disk. Files also have to match in size and mtime.
+     */
+    Match findVanished(const QString &localPath, quint64 inode, bool isDirectory,
+                       quint64 size, time_t modtime);
+
+    /** The record of file in the journal of the folder the match is from. */
+    SyncJournalFileRecord sourceRecord(const Match &match, const QString &file);
+
+    /**
+     * The vanished item was moved on the server, the owner of its folder
+     * forgets it with a queued call.
+     */
+    void moved(const Match &match);
+
+    /** The watcher of the folder saw the paths change, remembers what is there now. */
+    void noteChanges(const QString &localPath, const QStringList &paths);
+
+    /**
+     * True if a folder other than localPath got an item with the inode, or
+     * a file of that size, since its last sync: the item might have been
+     * moved there.
+     */
+    bool isPendingCreate(const QString &localPath, quint64 inode, bool isDirectory, quint64 size);
+
+    /**
+     * The folder has remote deletes that might be moves to propagate.
+     * Returns true while they have to wait for a sync of the other folders.
+     */
+    bool holdDeletes(const QString &localPath);
+
+    /** Deletes of the folder are held back, it has to sync again later. */
+    bool holdsDeletes(const QString &localPath);
+
+    void syncFinished(const QString &localPath);
+
+    /** msec after which held deletes go out even without the other syncs. */
+    static int maxHoldMsec();
+
+private:
+    MoveMatcher();
+
+    struct Entry {
+        Entry() : owner(0), lastSync(0), heldSince(0) {}
+        QString        remotePath;
+        QString        journalFile;
+        QObject       *owner;
+        qint64         lastSync;   // msec since epoch a sync finished
+        qint64         heldSince;  // 0 if no deletes are held
+        // what the watcher saw appear since the last sync
+        QSet<quint64>  createdInodes;
+        QSet<quint64>  createdSizes;  // of files only
+    };
+
+    QMutex _mutex;
+    QHash<QString, Entry> _folders;
+};
+
+}
+
+#endif // MIRALL_MOVEMATCHER_H
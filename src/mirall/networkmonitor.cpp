@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/networkmonitor.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QNetworkInterface>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#endif
+
+// time to let a burst of link and address messages pass
+#define SETTLE_INTERVAL_MSEC 500
+// RTF_UP in the flags column of /proc/net/route and ipv6_route
+#define ROUTE_FLAG_UP 0x0001
+
+namespace Mirall {
+
+NetworkMonitor::NetworkMonitor(QObject *parent)
+    : QObject(parent),
+      _fd(-1),
+      _notifier(0),
+      _settleTimer(new QTimer(this)),
+      _online(hasUsableInterface())
+{
+    _settleTimer->setSingleShot(true);
+    _settleTimer->setInterval(SETTLE_INTERVAL_MSEC);
+    connect(_settleTimer, SIGNAL(timeout()), SLOT(slotCheckState()));
+
+#ifdef Q_OS_LINUX
+    _fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (_fd == -1) {
+        qDebug() << Q_FUNC_INFO << "netlink socket() failed: " << strerror(errno);
+        return;
+    }
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR
+            | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+    if (bind(_fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        qDebug() << Q_FUNC_INFO << "netlink bind() failed: " << strerror(errno);
+        close(_fd);
+        _fd = -1;
+        return;
+    }
+
+    _notifier = new QSocketNotifier(_fd, QSocketNotifier::Read, this);
+    connect(_notifier, SIGNAL(activated(int)), SLOT(slotActivated(int)));
+#endif
+    qDebug() << "* Network monitor started, network is" << (_online ? "online" : "offline");
+}
+
+NetworkMonitor::~NetworkMonitor()
+{
+#ifdef Q_OS_LINUX
+    delete _notifier;
+    if (_fd != -1) {
+        close(_fd);
+    }
+#endif
+}
+
+bool NetworkMonitor::isOnline() const
+{
+    return _online;
+}
+
+void NetworkMonitor::slotActivated(int /*fd*/)
+{
+#ifdef Q_OS_LINUX
+    char buffer[4096];
+    bool linkLost = false;
+    ssize_t len;
+
+    // drain the socket, the messages only tell that something changed.
+    while ((len = recv(_fd, buffer, sizeof(buffer), 0)) > 0) {
+        for (struct nlmsghdr *nh = (struct nlmsghdr *) buffer; NLMSG_OK(nh, (size_t) len);
+             nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_type == RTM_DELLINK || nh->nlmsg_type == RTM_DELADDR
+                    || nh->nlmsg_type == RTM_DELROUTE) {
+                linkLost = true;
+            } else if (nh->nlmsg_type == RTM_NEWLINK) {
+                const struct ifinfomsg *ifi = (const struct ifinfomsg *) NLMSG_DATA(nh);
+                if (!(ifi->ifi_flags & IFF_RUNNING)) {
+                    linkLost = true;
+                }
+            }
+        }
+    }
+
+    if (linkLost) {
+        // going offline is not delayed, pending transfers would only run
+        // into their timeouts.
+        slotCheckState();
+    } else {
+        _settleTimer->start();
+    }
+#endif
+}
+
+void NetworkMonitor::slotCheckState()
+{
+    bool online = hasUsableInterface();
+    if (online != _online) {
+        _online = online;
+        qDebug() << "* Network changed, now" << (_online ? "online" : "offline");
+        emit networkStateChanged(_online);
+    }
+}
+
+bool NetworkMonitor::hasUsableInterface()
+{
+#ifdef Q_OS_LINUX
+    if (QFile::exists(QLatin1String("/proc/net/route"))) {
+        return hasDefaultRoute();
+    }
+#endif
+    foreach (const QNetworkInterface& iface, QNetworkInterface::allInterfaces()) {
+        const QNetworkInterface::InterfaceFlags flags = iface.flags();
+        if (flags & QNetworkInterface::IsLoopBack) {
+            continue;
+        }
+        if ((flags & QNetworkInterface::IsUp) && (flags & QNetworkInterface::IsRunning)
+                && !iface.addressEntries().isEmpty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef Q_OS_LINUX
+bool NetworkMonitor::hasDefaultRoute()
+{
+    // Iface Destination Gateway Flags RefCnt Use Metric Mask ..., in hex
+    QFile route(QLatin1String("/proc/net/route"));
+    if (route.open(QIODevice::ReadOnly)) {
+        route.readLine(); // the header
+        while (!route.atEnd()) {
+            const QList<QByteArray> fields = route.readLine().simplified().split(' ');
+            if (fields.size() < 8 || fields.at(0) == "lo") {
+                continue;
+            }
+            const bool up = fields.at(3).toUInt(0, 16) & ROUTE_FLAG_UP;
+            if (up && fields.at(1).toUInt(0, 16) == 0 && fields.at(7).toUInt(0, 16) == 0) {
+                return true;
+            }
+        }
+    }
+
+    // Destination PrefixLen Source SrcPrefixLen NextHop Metric RefCnt Use Flags Iface
+    QFile route6(QLatin1String("/proc/net/ipv6_route"));
+    if (route6.open(QIODevice::ReadOnly)) {
+        while (!route6.atEnd()) {
+            const QList<QByteArray> fields = route6.readLine().simplified().split(' ');
+            if (fields.size() < 10 || fields.at(9) == "lo") {
+                continue;
+            }
+            const bool up = fields.at(8).toUInt(0, 16) & ROUTE_FLAG_UP;
+            // the unreachable default route of the kernel is bound to lo
+            if (up && fields.at(1).toUInt(0, 16) == 0 && fields.at(0).count('0') == fields.at(0).size()) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+#endif
+
+} // ns mirall
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_NETWORKMONITOR_H
+#define MIRALL_NETWORKMONITOR_H
+
+#include <QObject>
+
+class QSocketNotifier;
+class QTimer;
+
+namespace Mirall {
+
+/**
+ * @brief Watches the network links and addresses of the machine.
+ *
+ * On Linux a netlink route socket is used, so link loss is noticed right
+ * away instead of through timeouts of pending requests. On the other
+ * platforms the monitor never reports a change.
+ *
+ * On Linux the machine counts as online if it has a default route, IPv4
+ * or IPv6. Bridges, container interfaces and tunnels with only their own
+ * subnet route do not count. Elsewhere any interface besides the loopback
+ * that is up, running and has an address counts.
+ */
+class NetworkMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NetworkMonitor(QObject *parent = 0);
+    ~NetworkMonitor();
+
+    bool isOnline() const;
+
+signals:
+    void networkStateChanged(bool online);
+
+protected slots:
+    void slotActivated(int);
+    void slotCheckState();
+
+private:
+    static bool hasUsableInterface();
+#ifdef Q_OS_LINUX
+    static bool hasDefaultRoute();
+#endif
+
+    int _fd;
+    QSocketNotifier *_notifier;
+    // bursts of netlink messages are handled once
+    QTimer *_settleTimer;
+    bool _online;
+};
+
+}
+
+#endif // MIRALL_NETWORKMONITOR_H
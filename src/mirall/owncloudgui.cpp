@@ -30,6 +30,11 @@
 
 namespace Mirall {
 
+// bounds how often the tray icon and tooltip are recomputed while syncing
+static const int trayUpdateMsec = 1000;
+// bounds how often the recent changes menu is rebuilt
+static const int recentMenuUpdateMsec = 2000;
+
 ownCloudGui::ownCloudGui(Application *parent) :
     QObject(parent),
     _tray(0),
@@ -39,8 +44,19 @@ ownCloudGui::ownCloudGui(Application *parent) :
     _recentActionsMenu(0),
     _folderOpenActionMapper(new QSignalMapper(this)),
     _recentItemsMapper(new QSignalMapper(this)),
+    _trayUpdateTimer(new QTimer(this)),
+    _recentMenuTimer(new QTimer(this)),
+    _trayStatus(SyncResult::NotYetStarted),
+    _contextMenuConfigured(false),
     _app(parent)
 {
+    _trayUpdateTimer->setSingleShot(true);
+    _trayUpdateTimer->setInterval(trayUpdateMsec);
+    connect(_trayUpdateTimer, SIGNAL(timeout()), SLOT(slotComputeOverallSyncStatus()));
+    _recentMenuTimer->setSingleShot(true);
+    _recentMenuTimer->setInterval(recentMenuUpdateMsec);
+    connect(_recentMenuTimer, SIGNAL(timeout()), SLOT(slotRebuildRecentMenus()));
+
     _tray = new Systray();
     _tray->setParent(this);
     _tray->setIcon( Theme::instance()->syncStateIcon( SyncResult::NotYetStarted, true ) );
@@ -113,7 +129,10 @@ void ownCloudGui::slotSyncStateChange( const QString& alias )
     FolderMan *folderMan = FolderMan::instance();
     const SyncResult& result = folderMan->syncResult( alias );
 
-    slotComputeOverallSyncStatus();
+    // the state changes of all folders are folded into one tray update.
+    if( !_trayUpdateTimer->isActive() ) {
+        _trayUpdateTimer->start();
+    }
 
     qDebug() << "Sync state changed for folder " << alias << ": "  << result.statusString();
 
@@ -144,7 +163,7 @@ void ownCloudGui::startupConnected( bool connected, const QStringList& fails )
     if( connected ) {
         qDebug() << "######## connected to ownCloud Server!";
         folderMan->setSyncEnabled(true);
-        _tray->setIcon( Theme::instance()->syncStateIcon( SyncResult::NotYetStarted, true ) );
+        setTrayState( SyncResult::NotYetStarted, _tray->toolTip() );
         _tray->show();
     } else {
         int cnt = folderMan->map().size();
@@ -156,8 +175,22 @@ void ownCloudGui::startupConnected( bool connected, const QStringList& fails )
 
 }
 
+void ownCloudGui::setTrayState( SyncResult::Status status, const QString& toolTip )
+{
+    // loading the icon and setting it is expensive on some platforms.
+    if( status != _trayStatus ) {
+        _tray->setIcon( Theme::instance()->syncStateIcon( status, true ) );
+        _trayStatus = status;
+    }
+    if( toolTip != _tray->toolTip() ) {
+        _tray->setToolTip( toolTip );
+    }
+}
+
 void ownCloudGui::slotComputeOverallSyncStatus()
 {
+    _trayUpdateTimer->stop();
+
     // display the info of the least successful sync (eg. not just display the result of the latest sync
     QString trayMessage;
     FolderMan *folderMan = FolderMan::instance();
@@ -170,21 +203,16 @@ void ownCloudGui::slotComputeOverallSyncStatus()
 
     if( !_startupFails.isEmpty() ) {
         trayMessage = _startupFails.join(QLatin1String("\n"));
-        QIcon statusIcon;
         if (_app->_startupNetworkError) {
-            statusIcon = Theme::instance()->syncStateIcon( SyncResult::NotYetStarted, true );
+            setTrayState( SyncResult::NotYetStarted, trayMessage );
         } else {
-            statusIcon = Theme::instance()->syncStateIcon( SyncResult::Error, true );
+            setTrayState( SyncResult::Error, trayMessage );
         }
-
-        _tray->setIcon( statusIcon );
-        _tray->setToolTip(trayMessage);
     } else {
         // create the tray blob message, check if we have an defined state
         if( overallResult.status() != SyncResult::Undefined ) {
             QStringList allStatusStrings;
             foreach(Folder* folder, map.values()) {
-                qDebug() << "Folder in overallStatus Message: " << folder << " with name " << folder->alias();
                 QString folderMessage = folderMan->statusToString(folder->syncResult().status(), folder->syncEnabled());
                 allStatusStrings += tr("Folder %1: %2").arg(folder->alias(), folderMessage);
             }
@@ -194,9 +222,7 @@ void ownCloudGui::slotComputeOverallSyncStatus()
             else
                 trayMessage = tr("No sync folders configured.");
 
-            QIcon statusIcon = Theme::instance()->syncStateIcon( overallResult.status(), true);
-            _tray->setIcon( statusIcon );
-            _tray->setToolTip(trayMessage);
+            setTrayState( overallResult.status(), trayMessage );
         }
     }
 }
@@ -206,6 +232,15 @@ void ownCloudGui::setupContextMenu()
     bool isConfigured = ownCloudInfo::instance()->isConfigured();
     FolderMan *folderMan = FolderMan::instance();
 
+    // the menu only depends on the set of folders, do not rebuild it
+    // if that did not change.
+    const QStringList folders = folderMan->map().keys();
+    if( _contextMenu && folders == _contextMenuFolders && isConfigured == _contextMenuConfigured ) {
+        return;
+    }
+    _contextMenuFolders = folders;
+    _contextMenuConfigured = isConfigured;
+
     _actionOpenoC->setEnabled(isConfigured);
 
     if( _contextMenu ) {
@@ -359,6 +394,7 @@ void ownCloudGui::slotProgressSyncProblem(const QString& folder, const Progress:
 
 void ownCloudGui::slotRebuildRecentMenus()
 {
+    _recentMenuTimer->stop();
     _recentActionsMenu->clear();
     const QList<Progress::Info>& progressInfoList = ProgressDispatcher::instance()->recentChangedItems(5);
 
@@ -397,21 +433,27 @@ void ownCloudGui::slotUpdateProgress(const QString &folder, const Progress::Info
 {
     Q_UNUSED(folder);
 
-    // shows an entry in the context menu.
+    // shows an entry in the context menu, a changed text updates the menu.
     QString curAmount = Utility::octetsToString(progress.overall_current_bytes);
     QString totalAmount = Utility::octetsToString(progress.overall_transmission_size);
-    _actionStatus->setText(tr("Syncing %1 of %2 (%3 of %4) ").arg(progress.current_file_no)
-                           .arg(progress.overall_file_count).arg(curAmount, totalAmount));
+    const QString statusText = tr("Syncing %1 of %2 (%3 of %4) ").arg(progress.current_file_no)
+            .arg(progress.overall_file_count).arg(curAmount, totalAmount);
+    if( statusText != _actionStatus->text() ) {
+        _actionStatus->setText(statusText);
+    }
 
     // wipe the problem list at start of sync.
     if( progress.kind == Progress::StartSync ) {
         _actionRecent->setIcon( QIcon() ); // Fixme: Set a "in-progress"-item eventually.
     }
 
-    // If there was a change in the file list, redo the progress menu.
+    // If there was a change in the file list, redo the progress menu,
+    // but not for every single file.
     if( progress.kind == Progress::EndDownload || progress.kind == Progress::EndUpload ||
             progress.kind == Progress::EndDelete ) {
-        slotRebuildRecentMenus();
+        if( !_recentMenuTimer->isActive() ) {
+            _recentMenuTimer->start();
+        }
     }
 
     if (progress.kind == Progress::EndSync) {
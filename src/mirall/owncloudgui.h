@@ -17,12 +17,15 @@
 #include "mirall/systray.h"
 #include "mirall/connectionvalidator.h"
 #include "mirall/progressdispatcher.h"
+#include "mirall/syncresult.h"
 
 #include <QObject>
 #include <QPointer>
 #include <QAction>
 #include <QMenu>
 #include <QSignalMapper>
+#include <QStringList>
+#include <QTimer>
 
 namespace Mirall {
 
@@ -70,6 +73,7 @@ private slots:
 
 private:
     void setupActions();
+    void setTrayState( SyncResult::Status status, const QString& toolTip );
 
     QPointer<Systray> _tray;
     QPointer<SettingsDialog> _settingsDialog;
@@ -89,6 +93,12 @@ private:
     QSignalMapper *_folderOpenActionMapper;
     QSignalMapper *_recentItemsMapper;
 
+    QTimer *_trayUpdateTimer;
+    QTimer *_recentMenuTimer;
+    SyncResult::Status _trayStatus;  // what the tray icon currently shows
+    QStringList _contextMenuFolders; // folders the context menu was built for
+    bool _contextMenuConfigured;
+
     Application *_app;
 
     QStringList _startupFails;
@@ -16,6 +16,8 @@
 #include "mirall/mirallconfigfile.h"
 #include "mirall/theme.h"
 #include "mirall/logger.h"
+#include "mirall/serverbackoff.h"
+#include "mirall/listingconcurrency.h"
 #include "creds/abstractcredentials.h"
 
 #include <QtCore>
@@ -164,8 +166,27 @@ QNetworkReply* ownCloudInfo::mkdirRequest( const QString& dir )
     return reply;
 }
 
+// Feeds the server backoff with the outcome of a finished reply.
+static void noteServerLoad(QNetworkReply *reply)
+{
+    const QString server = ServerBackoff::serverKey(reply->url());
+    const int httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if( ServerBackoff::isBusyStatus(httpStatus) ) {
+        ServerBackoff::instance()->reportBusy(server,
+                ServerBackoff::parseRetryAfter(reply->rawHeader("Retry-After")));
+    } else if( httpStatus >= 200 && httpStatus < 300 ) {
+        ServerBackoff::instance()->reportSuccess(server);
+    }
+}
+
 QNetworkReply* ownCloudInfo::getQuotaRequest( const QString& dir )
 {
+    // the quota is polled, skip it while the server asked for a break.
+    if( ServerBackoff::instance()->remaining(ServerBackoff::serverKey(QUrl(webdavUrl(_connection)))) > 0 ) {
+        qDebug() << "ownCloudInfo: Server busy, not asking for the quota";
+        return 0;
+    }
+
     QNetworkRequest req;
     req.setUrl( QUrl( webdavUrl(_connection) + QUrl::toPercentEncoding(dir, "/") ) );
     req.setRawHeader("Depth", "0");
@@ -360,6 +381,7 @@ void ownCloudInfo::slotReplyFinished()
         qDebug() << "ownCloudInfo: Reply empty!";
         return;
     }
+    noteServerLoad(reply);
 
     // Detect redirect url
     QUrl possibleRedirUrl = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
@@ -604,6 +626,7 @@ RequestEtagJob::RequestEtagJob(const QString& dir, QObject* parent)
 
 void RequestEtagJob::slotFinished()
 {
+    noteServerLoad(_reply);
     if (_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute) == 207) {
         // Parse DAV response
         QXmlStreamReader reader(_reply);
@@ -633,4 +656,211 @@ void RequestEtagJob::slotError()
     emit networkError();
 }
 
+RequestDirectoryEtagsJob::RequestDirectoryEtagsJob(const QString& dir, QObject* parent)
+    : QObject(parent),
+      _isRoot(dir.isEmpty() || dir == QLatin1String("/"))
+{
+    QNetworkRequest req;
+    // the webdav url ends with a slash already
+    QString relativeDir = dir;
+    while( relativeDir.startsWith(QLatin1Char('/')) ) {
+        relativeDir.remove(0, 1);
+    }
+    QUrl url( ownCloudInfo::instance()->webdavUrl(ownCloudInfo::instance()->_connection) + relativeDir );
+    _basePath = url.path();
+    if( !_basePath.endsWith(QLatin1Char('/')) ) {
+        _basePath.append(QLatin1Char('/'));
+    }
+    req.setUrl( url );
+    req.setRawHeader("Depth", "1");
+    QByteArray xml("<?xml version=\"1.0\" ?>\n"
+                   "<d:propfind xmlns:d=\"DAV:\">\n"
+                   "  <d:prop>\n"
+                   "    <d:getetag/>"
+                   "    <d:resourcetype/>"
+                   "  </d:prop>\n"
+                   "</d:propfind>\n");
+    QBuffer *buf = new QBuffer;
+    buf->setData(xml);
+    buf->open(QIODevice::ReadOnly);
+    _duration.start();
+    _reply = ownCloudInfo::instance()->davRequest("PROPFIND", req, buf);
+    buf->setParent(_reply);
+
+    if( _reply->error() != QNetworkReply::NoError ) {
+        qDebug() << "getting etags: request network error: " << _reply->errorString();
+    }
+
+    connect( _reply, SIGNAL( finished()), SLOT(slotFinished()) );
+    connect( _reply, SIGNAL(error(QNetworkReply::NetworkError)),
+             this, SLOT(slotError()));
+    connect( _reply, SIGNAL(error(QNetworkReply::NetworkError)),
+             ownCloudInfo::instance(), SLOT(slotError(QNetworkReply::NetworkError)));
+}
+
+void RequestDirectoryEtagsJob::slotFinished()
+{
+    noteServerLoad(_reply);
+    const int httpStatus = _reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (httpStatus >= 500 || _reply->error() == QNetworkReply::TimeoutError) {
+        ListingConcurrency::instance()->reportFailure();
+    } else if (httpStatus == 207) {
+        ListingConcurrency::instance()->reportListing(_duration.elapsed());
+    }
+    if (httpStatus == 207) {
+        // Parse DAV response
+        QXmlStreamReader reader(_reply);
+        reader.addExtraNamespaceDeclaration(QXmlStreamNamespaceDeclaration("d", "DAV:"));
+        QHash<QString, QString> etags;
+        QHash<QString, QString> directoryEtags;
+        QString etag;
+        QString currentItem;
+        QString currentEtag;
+        bool isCollection = false;
+        bool selfSeen = false;
+        while (!reader.atEnd()) {
+            QXmlStreamReader::TokenType type = reader.readNext();
+            if (reader.namespaceUri() != QLatin1String("DAV:")) {
+                continue;
+            }
+            const QString name = reader.name().toString();
+            if (type == QXmlStreamReader::StartElement) {
+                if (name == QLatin1String("response")) {
+                    currentItem.clear();
+                    currentEtag.clear();
+                    isCollection = false;
+                } else if (name == QLatin1String("href")) {
+                    currentItem = QUrl::fromEncoded(reader.readElementText().toLatin1()).path();
+                    if (currentItem.startsWith(_basePath)) {
+                        currentItem.remove(0, _basePath.length());
+                    }
+                    if (currentItem.endsWith(QLatin1Char('/'))) {
+                        currentItem.chop(1);
+                    }
+                } else if (name == QLatin1String("getetag")) {
+                    currentEtag = reader.readElementText();
+                } else if (name == QLatin1String("collection")) {
+                    isCollection = true;
+                }
+            } else if (type == QXmlStreamReader::EndElement && name == QLatin1String("response")) {
+                // see RequestEtagJob for why the root collects all of them.
+                if (_isRoot) {
+                    etag += currentEtag;
+                } else if (currentItem.isEmpty() && !selfSeen) {
+                    etag = currentEtag;
+                    selfSeen = true;
+                }
+                if (!currentItem.isEmpty()) {
+                    // csync stores the etags without the quotes.
+                    QString childEtag = currentEtag;
+                    childEtag.remove(QLatin1Char('"'));
+                    etags.insert(currentItem, childEtag);
+                    if (isCollection) {
+                        directoryEtags.insert(currentItem, childEtag);
+                    }
+                }
+            }
+        }
+        emit directoriesRetreived(etag, directoryEtags);
+        emit etagsRetreived(etag, etags);
+    } else {
+        emit networkError();
+    }
+    _reply->deleteLater();
+    deleteLater();
+}
+
+void RequestDirectoryEtagsJob::slotError()
+{
+    qDebug() << "RequestDirectoryEtagsJob Error: " << _reply->errorString();
+    // slotFinished follows and reports the failure.
+}
+
+BlockingDirectoryEtags::BlockingDirectoryEtags(const QString &base, const QStringList &dirs)
+    : _base(base),
+      _pending(dirs),
+      _failed(false),
+      _finished(false),
+      _abandoned(false)
+{
+}
+
+bool BlockingDirectoryEtags::fetch(const QString &base, const QStringList &dirs, QAtomicInt *abort,
+                                   QHash<QString, QString> *etags)
+{
+    BlockingDirectoryEtags *fetcher = new BlockingDirectoryEtags(base, dirs);
+    fetcher->moveToThread(ownCloudInfo::instance()->thread());
+    QMetaObject::invokeMethod(fetcher, "startJobs", Qt::QueuedConnection);
+
+    QMutexLocker locker(&fetcher->_mutex);
+    while( !fetcher->_finished ) {
+        // a short wait, the main thread may be waiting for this one to abort.
+        fetcher->_done.wait(&fetcher->_mutex, 100);
+        if( !fetcher->_finished && abort->fetchAndAddRelaxed(0) ) {
+            fetcher->_abandoned = true;
+            return false;
+        }
+    }
+    const bool ok = !fetcher->_failed;
+    *etags = fetcher->_etags;
+    locker.unlock();
+    fetcher->deleteLater();
+    return ok;
+}
+
+void BlockingDirectoryEtags::startJobs()
+{
+    QMutexLocker locker(&_mutex);
+    while( !_failed && !_pending.isEmpty() && _jobs.count() < ListingConcurrency::instance()->level() ) {
+        const QString dir = _pending.takeFirst();
+        QString path = _base;
+        if( !dir.isEmpty() ) {
+            if( !path.endsWith(QLatin1Char('/')) ) {
+                path += QLatin1Char('/');
+            }
+            path += dir;
+        }
+        RequestDirectoryEtagsJob *job = new RequestDirectoryEtagsJob(path, this);
+        connect(job, SIGNAL(etagsRetreived(QString,QHash<QString,QString>)),
+                this, SLOT(slotEtagsRetreived(QString,QHash<QString,QString>)));
+        connect(job, SIGNAL(networkError()), this, SLOT(slotNetworkError()));
+        _jobs.insert(job, dir);
+    }
+    jobDone();
+}
+
+void BlockingDirectoryEtags::slotEtagsRetreived(const QString &, const QHash<QString, QString> &childEtags)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        const QString dir = _jobs.take(sender());
+        const QString prefix = dir.isEmpty() ? QString() : dir + QLatin1Char('/');
+        QHash<QString, QString>::const_iterator it;
+        for( it = childEtags.constBegin(); it != childEtags.constEnd(); ++it ) {
+            _etags.insert(prefix + it.key(), it.value());
+        }
+    }
+    startJobs();
+}
+
+void BlockingDirectoryEtags::slotNetworkError()
+{
+    QMutexLocker locker(&_mutex);
+    _jobs.remove(sender());
+    _failed = true;
+    jobDone();
+}
+
+void BlockingDirectoryEtags::jobDone()
+{
+    if( !_jobs.isEmpty() || (!_failed && !_pending.isEmpty()) || _finished ) {
+        return;
+    }
+    _finished = true;
+    _done.wakeAll();
+    if( _abandoned ) {
+        deleteLater();
+    }
+}
+
 } // ns Mirall
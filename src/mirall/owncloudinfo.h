@@ -17,6 +17,7 @@
 
 #include <QObject>
 #include <QtNetwork>
+#include <QWaitCondition>
 
 namespace Mirall
 {
@@ -159,6 +160,7 @@ private:
     QString                        _lastEtag;
 
     friend class RequestEtagJob;
+    friend class RequestDirectoryEtagsJob;
 };
 
 
@@ -181,6 +183,78 @@ signals:
     void networkError();
 };
 
+/**
+ * Fetches the etags of all direct children of a remote directory
+ * (Depth:1 PROPFIND). The keys of the result are the names relative
+ * to the requested directory, the directory itself is not contained.
+ *
+ * The etag parameter of etagsRetreived() is the same value RequestEtagJob
+ * would have reported for the directory.
+ */
+class RequestDirectoryEtagsJob : public QObject {
+    Q_OBJECT
+
+    QNetworkReply *_reply;
+    QString        _basePath;
+    bool           _isRoot;
+    QElapsedTimer  _duration; // for the ListingConcurrency
+
+public:
+    explicit RequestDirectoryEtagsJob(const QString &dir , QObject* parent = 0);
+
+private slots:
+    void slotFinished();
+    void slotError();
+
+signals:
+    void etagsRetreived(const QString &etag, const QHash<QString, QString> &childEtags);
+    // like etagsRetreived, but only the children that are directories
+    void directoriesRetreived(const QString &etag, const QHash<QString, QString> &directoryEtags);
+    void networkError();
+};
+
+/**
+ * Fetches the child etags of several remote directories for a thread
+ * without an event loop, like the propagator in the sync thread. The
+ * RequestDirectoryEtagsJobs need the QNAM of ownCloudInfo and run in its
+ * thread, at most ListingConcurrency::level() at a time, while fetch()
+ * waits for them.
+ */
+class BlockingDirectoryEtags : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @param base the remote path the directories are relative to
+     * @param dirs the directories, "" for the base itself
+     * @param abort set from another thread to stop waiting
+     * @param etags gets the etags keyed by dir/child, without quotes
+     * @return false if a listing failed or the wait was aborted
+     */
+    static bool fetch(const QString &base, const QStringList &dirs, QAtomicInt *abort,
+                      QHash<QString, QString> *etags);
+
+private slots:
+    void startJobs();
+    void slotEtagsRetreived(const QString &etag, const QHash<QString, QString> &childEtags);
+    void slotNetworkError();
+
+private:
+    explicit BlockingDirectoryEtags(const QString &base, const QStringList &dirs);
+    void jobDone(); // needs _mutex
+
+    QString                 _base;
+    QStringList             _pending;
+    QHash<QObject*, QString> _jobs;    // job -> dir
+    QHash<QString, QString> _etags;
+    bool                    _failed;
+    bool                    _finished;
+    bool                    _abandoned; // fetch() returned, delete when done
+
+    QMutex         _mutex;
+    QWaitCondition _done;
+};
+
 } // ns Mirall
 
 #endif // OWNCLOUDINFO_H
@@ -16,6 +16,13 @@
 #include "owncloudpropagator.h"
 #include "syncjournaldb.h"
 #include "syncjournalfilerecord.h"
+#include "allocstats.h"
+#include "serverbackoff.h"
+#include "tarstreamreader.h"
+#include "pagecachedropper.h"
+#include "fileiobatch.h"
+#include "resourcegovernor.h"
+#include "owncloudinfo.h"
 #include <httpbf.h>
 #include <qfile.h>
 #include <qdir.h>
@@ -29,6 +36,10 @@
 #include <QDebug>
 #include <QDateTime>
 #include <qstack.h>
+#include <qtimer.h>
+#include <qset.h>
+#include <qurl.h>
+#include <qcryptographichash.h>
 
 #include <neon/ne_basic.h>
 #include <neon/ne_socket.h>
@@ -79,43 +90,84 @@ static bool fileEquals(const QString &fn1, const QString &fn2) {
         return false;
     }
 
-    const int BufferSize = 16 * 1024;
-    char buffer1[BufferSize];
-    char buffer2[BufferSize];
-    do {
-        int r = f1.read(buffer1, BufferSize);
-        if (f2.read(buffer2, BufferSize) != r) {
-            // this should normaly not happen: the file are supposed to have the same size.
+    QScopedPointer<PageCacheDropper> dropper1, dropper2;
+    if (PageCacheDropper::isLarge(f1.size())) {
+        dropper1.reset(new PageCacheDropper(&f1, PageCacheDropper::Reading));
+        dropper2.reset(new PageCacheDropper(&f2, PageCacheDropper::Reading));
+    }
+
+    // a few blocks of both files are read with one submit
+    const int BlockSize = 64 * 1024;
+    const int Blocks = 4;
+    QByteArray buffer1(BlockSize * Blocks, 0);
+    QByteArray buffer2(BlockSize * Blocks, 0);
+    FileIoBatch batch(2 * Blocks);
+    const qint64 size = f1.size();
+    for (qint64 pos = 0; pos < size; pos += buffer1.size()) {
+        batch.clear();
+        for (int i = 0; i < Blocks && pos + qint64(i) * BlockSize < size; ++i) {
+            const qint64 offset = pos + qint64(i) * BlockSize;
+            batch.read(f1.handle(), buffer1.data() + i * BlockSize, BlockSize, offset);
+            batch.read(f2.handle(), buffer2.data() + i * BlockSize, BlockSize, offset);
+        }
+        if (batch.submit() != 0) {
+            qDebug() << "fileEquals: Failed to read " << fn1 << "or" << fn2;
             return false;
         }
-        if (r <= 0) {
-            return true;
+        const int len = int(qMin(qint64(buffer1.size()), size - pos));
+        qint64 read = 0;
+        for (int i = 0; i < batch.count(); i += 2) {
+            if (batch.result(i) != batch.result(i + 1)) {
+                // this should normaly not happen: the file are supposed to have the same size.
+                return false;
+            }
+            read += batch.result(i);
         }
-        if (memcmp(buffer1, buffer2, r) != 0) {
+        if (read != len) {
+            // changed while we compared
             return false;
         }
-    } while (true);
-    return false;
+        if (memcmp(buffer1.constData(), buffer2.constData(), len) != 0) {
+            return false;
+        }
+        if (dropper1) {
+            dropper1->advance(pos + len);
+            dropper2->advance(pos + len);
+        }
+    }
+    return true;
 }
 
-// Code copied from Qt5's QDir::removeRecursively
+// Removes the files of the whole tree in batches first, then the directories bottom up
 static bool removeRecursively(const QString &path)
 {
     bool success = true;
-    QDirIterator di(path, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    FileIoBatch batch;
+    QStringList dirs;
+    dirs.append(path);
+    QDirIterator di(path, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot,
+                    QDirIterator::Subdirectories);
     while (di.hasNext()) {
         di.next();
         const QFileInfo& fi = di.fileInfo();
-        bool ok;
-        if (fi.isDir() && !fi.isSymLink())
-            ok = removeRecursively(di.filePath()); // recursive
-        else
-            ok = QFile::remove(di.filePath());
-        if (!ok)
-            success = false;
-    }
-    if (success)
-        success = QDir().rmdir(path);
+        if (fi.isDir() && !fi.isSymLink()) {
+            dirs.append(di.filePath()); // after its parent
+        } else {
+            batch.unlink(di.filePath());
+        }
+        if (batch.count() >= 4096) {
+            if (batch.submit() != 0)
+                success = false;
+            batch.clear();
+        }
+    }
+    if (batch.submit() != 0)
+        success = false;
+    if (!success)
+        return false;
+    for (int i = dirs.size() - 1; i >= 0 && success; --i) {
+        success = QDir().rmdir(dirs.at(i));
+    }
     return success;
 }
 
@@ -155,14 +207,14 @@ DECLARE_JOB(PropagateRemoteRemove)
 
 void PropagateRemoteRemove::start()
 {
-    QScopedPointer<char, QScopedPointerPodDeleter> uri(
-        ne_path_escape((_propagator->_remoteDir + _item._file).toUtf8()));
-    qDebug() << "** DELETE " << uri.data();
-    int rc = ne_delete(_propagator->_session, uri.data());
+    const char *uri = _propagator->_arena.escapedPath(_propagator->_remoteDir, _item._file);
+    qDebug() << "** DELETE " << uri;
+    int rc = ne_delete(_propagator->_session, uri);
     /* Ignore the error 404,  it means it is already deleted */
     if (updateErrorFromSession(rc, 0, 404)) {
         return;
     }
+    requestDone();
     _propagator->_journal->deleteFileRecord(_item._originalFile, _item._isDirectory);
     done(SyncFileItem::Success);
 }
@@ -171,23 +223,23 @@ DECLARE_JOB(PropagateRemoteMkdir)
 
 void PropagateRemoteMkdir::start()
 {
-    QScopedPointer<char, QScopedPointerPodDeleter> uri(
-        ne_path_escape((_propagator->_remoteDir + _item._file).toUtf8()));
+    const char *uri = _propagator->_arena.escapedPath(_propagator->_remoteDir, _item._file);
 
-    int rc = ne_mkcol(_propagator->_session, uri.data());
+    int rc = ne_mkcol(_propagator->_session, uri);
 
     /* Special for mkcol: it returns 405 if the directory already exists.
      * Ignore that error */
     if( updateErrorFromSession( rc , 0, 405 ) ) {
         return;
     }
+    requestDone();
     done(SyncFileItem::Success);
 }
 
 class PropagateUploadFile: public PropagateItemJob {
 public:
     explicit PropagateUploadFile(OwncloudPropagator* propagator,const SyncFileItem& item)
-        : PropagateItemJob(propagator, item) {}
+        : PropagateItemJob(propagator, item), _cacheDropper(0) {}
     void start();
 private:
     // Log callback for httpbf
@@ -208,6 +260,9 @@ private:
         PropagateUploadFile *that = static_cast<PropagateUploadFile *>(userdata);
         Q_ASSERT(that);
         that->_chunked_done += trans->block_arr[chunk]->size;
+        if (that->_cacheDropper) {
+            that->_cacheDropper->advance(trans->block_arr[chunk]->start + trans->block_arr[chunk]->size);
+        }
         if (trans->block_cnt > 1) {
             SyncJournalDb::UploadInfo pi;
             pi._valid = true;
@@ -234,19 +289,25 @@ private:
 
     qint64 _chunked_done; // amount of bytes already sent with the previous chunks
     qint64 _chunked_total_size; // total size of the whole file
+    PageCacheDropper *_cacheDropper; // for large files, owned by start()
 };
 
 void PropagateUploadFile::start()
 {
     emit progress(Progress::StartUpload, _item._file, 0, _item._size);
+    _propagator->_readAhead.uploadStarted(_propagator->_localDir + _item._file);
 
     QFile file(_propagator->_localDir + _item._file);
     if (!file.open(QIODevice::ReadOnly)) {
         done(SyncFileItem::NormalError, file.errorString());
         return;
     }
-    QScopedPointer<char, QScopedPointerPodDeleter> uri(
-        ne_path_escape((_propagator->_remoteDir + _item._file).toUtf8()));
+    QScopedPointer<PageCacheDropper> cacheDropper;
+    if (PageCacheDropper::isLarge(_item._size)) {
+        cacheDropper.reset(new PageCacheDropper(&file, PageCacheDropper::Reading));
+    }
+    _cacheDropper = cacheDropper.data();
+    const char *uri = _propagator->_arena.escapedPath(_propagator->_remoteDir, _item._file);
 
     int attempts = 0;
 
@@ -255,10 +316,10 @@ void PropagateUploadFile::start()
      * before submitting a chunk and after having submitted the last one.
      * If the file has changed, retry.
      */
-    qDebug() << "** PUT request to" << uri.data();
+    qDebug() << "** PUT request to" << uri;
     do {
         Hbf_State state = HBF_SUCCESS;
-        QScopedPointer<hbf_transfer_t, ScopedPointerHelpers> trans(hbf_init_transfer(uri.data()));
+        QScopedPointer<hbf_transfer_t, ScopedPointerHelpers> trans(hbf_init_transfer(uri));
         trans->user_data = this;
         hbf_set_log_callback(trans.data(), _log_callback);
         hbf_set_abort_callback(trans.data(), _user_want_abort);
@@ -281,12 +342,12 @@ void PropagateUploadFile::start()
         _chunked_total_size = _item._size;
 
         if( state == HBF_SUCCESS ) {
-            QByteArray previousEtag;
+            const char *previousEtag = "";
             if (!_item._etag.isEmpty() && _item._etag != "empty_etag") {
                 // We add quotes because the owncloud server always add quotes around the etag, and
                 //  csync_owncloud.c's owncloud_file_id always strip the quotes.
-                previousEtag = '"' + _item._etag + '"';
-                trans->previous_etag = previousEtag.data();
+                previousEtag = _propagator->_arena.quoted(_item._etag);
+                trans->previous_etag = previousEtag;
             }
             _chunked_total_size = trans->stat_size;
             qDebug() << "About to upload " << _item._file << "  (" << previousEtag << _item._size << " bytes )";
@@ -298,8 +359,7 @@ void PropagateUploadFile::start()
         QString fid = QString::fromUtf8( hbf_transfer_file_id( trans.data() ));
         if( _item._fileId.isEmpty() ) {
             if( fid.isEmpty() ) {
-                const char *plain_uri = uri.data();
-                getFileId(plain_uri);
+                getFileId(uri);
             } else {
                 _item._fileId = fid;
             }
@@ -333,13 +393,14 @@ void PropagateUploadFile::start()
         if( trans->modtime_accepted ) {
             _item._etag =  QByteArray(hbf_transfer_etag( trans.data() ));
         } else {
-            updateMTimeAndETag(uri.data(), _item._modtime);
+            updateMTimeAndETag(uri, _item._modtime);
         }
 
         _propagator->_journal->setFileRecord(SyncJournalFileRecord(_item, _propagator->_localDir + _item._file));
         // Remove from the progress database:
         _propagator->_journal->setUploadInfo(_item._file, SyncJournalDb::UploadInfo());
         emit progress(Progress::EndUpload, _item._file, 0, _item._size);
+        requestDone();
         done(SyncFileItem::Success);
         return;
 
@@ -367,14 +428,14 @@ static QString parseFileId(ne_request *req) {
 
 void PropagateItemJob::updateMTimeAndETag(const char* uri, time_t mtime)
 {
-    QByteArray modtime = QByteArray::number(qlonglong(mtime));
+    const char *modtime = _propagator->_arena.number(mtime);
     ne_propname pname;
     pname.nspace = "DAV:";
     pname.name = "lastmodified";
     ne_proppatch_operation ops[2];
     ops[0].name = &pname;
     ops[0].type = ne_propset;
-    ops[0].value = modtime.constData();
+    ops[0].value = modtime;
     ops[1].name = NULL;
 
     int rc = ne_proppatch( _propagator->_session, uri, ops );
@@ -452,11 +513,15 @@ void PropagateItemJob::limitBandwidth(qint64 progress, qint64 bandwidth_limit)
 class PropagateDownloadFile: public PropagateItemJob {
 public:
     explicit PropagateDownloadFile(OwncloudPropagator* propagator,const SyncFileItem& item)
-        : PropagateItemJob(propagator, item), _file(0) {}
+        : PropagateItemJob(propagator, item), _file(0), _cacheDropper(0) {}
     void start();
 
+    SyncFileItem::Status status() const { return _item._status; }
+    QString errorString() const { return _item._errorString; }
+
 private:
     QIODevice *_file;
+    PageCacheDropper *_cacheDropper; // for large files, owned by start()
     QScopedPointer<ne_decompress, ScopedPointerHelpers> _decompress;
 
     static int content_reader(void *userdata, const char *buf, size_t len)
@@ -470,10 +535,16 @@ private:
         }
 
         if(buf) {
+            // only the write holds the disk slot, not the wait for the network
+            ResourceGovernor::instance()->acquireDiskSlot();
             written = that->_file->write(buf, len);
+            ResourceGovernor::instance()->releaseDiskSlot();
             if( len != written ) {
                 qDebug() << "WRN: content_reader wrote wrong num of bytes:" << len << "," << written;
             }
+            if (that->_cacheDropper) {
+                that->_cacheDropper->advance(that->_file->pos());
+            }
             return NE_OK;
         }
         return NE_ERROR;
@@ -557,6 +628,12 @@ void PropagateDownloadFile::start()
 
     csync_win32_set_file_hidden(tmpFileName.toUtf8().constData(), true);
 
+    QScopedPointer<PageCacheDropper> cacheDropper;
+    if (PageCacheDropper::isLarge(_item._size)) {
+        cacheDropper.reset(new PageCacheDropper(&tmpFile, PageCacheDropper::Writing));
+    }
+    _cacheDropper = cacheDropper.data();
+
     {
         SyncJournalDb::DownloadInfo pi;
         pi._etag = _item._etag;
@@ -568,11 +645,10 @@ void PropagateDownloadFile::start()
     /* actually do the request */
     int retry = 0;
 
-    QScopedPointer<char, QScopedPointerPodDeleter> uri(
-        ne_path_escape((_propagator->_remoteDir + _item._file).toUtf8()));
+    const char *uri = _propagator->_arena.escapedPath(_propagator->_remoteDir, _item._file);
 
     do {
-        QScopedPointer<ne_request, ScopedPointerHelpers> req(ne_request_create(_propagator->_session, "GET", uri.data()));
+        QScopedPointer<ne_request, ScopedPointerHelpers> req(ne_request_create(_propagator->_session, "GET", uri));
 
         /* Allow compressed content by setting the header */
         ne_add_request_header( req.data(), "Accept-Encoding", "gzip" );
@@ -617,13 +693,18 @@ void PropagateDownloadFile::start()
         break;
     } while (1);
 
+    cacheDropper.reset();
+    _cacheDropper = 0;
     tmpFile.close();
     tmpFile.flush();
     QString fn = _propagator->_localDir + _item._file;
 
 
-    bool isConflict = _item._instruction == CSYNC_INSTRUCTION_CONFLICT
-            && !fileEquals(fn, tmpFile.fileName()); // compare the files to see if there was an actual conflict.
+    bool isConflict = false;
+    if (_item._instruction == CSYNC_INSTRUCTION_CONFLICT) {
+        DiskJobLocker diskJob;
+        isConflict = !fileEquals(fn, tmpFile.fileName()); // compare the files to see if there was an actual conflict.
+    }
     //In case of conflict, make a backup of the old file
     if (isConflict) {
         QFile f(fn);
@@ -681,9 +762,486 @@ void PropagateDownloadFile::start()
     _propagator->_journal->setFileRecord(SyncJournalFileRecord(_item, fn));
     _propagator->_journal->setDownloadInfo(_item._file, SyncJournalDb::DownloadInfo());
     emit progress(Progress::EndDownload, _item._file, 0, _item._size);
+    requestDone();
     done(isConflict ? SyncFileItem::Conflict : SyncFileItem::Success);
 }
 
+// New remote directories with many small files are downloaded as one archive
+static const int bulkMinFiles = 100;              // below that the archive is not worth it
+static const quint64 bulkSmallFileSize = 64 * 1024;
+static const int bulkSmallFilesPercent = 80;      // this many of the files have to be small
+
+/*
+ * Downloads a new remote directory with all its contents as one tar stream
+ * instead of one GET per file. The files are extracted into temporary files
+ * while the stream comes in, checked against the size and mtime of the
+ * discovery and only moved in place once the whole archive was read. The
+ * archive has no etags, so those of the entries are listed before it is
+ * requested and an entry whose etag changed since the discovery is dropped.
+ * Whatever did not come with the archive, or did not match, is downloaded
+ * file by file afterwards.
+ */
+class PropagateBulkDownload : public PropagateItemJob, private TarStreamReader::Handler {
+public:
+    PropagateBulkDownload(OwncloudPropagator* propagator, const SyncFileItem& item,
+                          const QVector<SyncFileItem> &contents)
+        : PropagateItemJob(propagator, item), _contents(contents),
+          _extracted(contents.size()), _currentIndex(-1), _received(0), _total(0), _reader(0) {}
+    void start();
+
+    /* true if the contents of a new directory are better fetched as an archive */
+    static bool worthIt(const QVector<SyncFileItem> &contents);
+
+private:
+    QVector<SyncFileItem> _contents; // the sub directories and files, sorted
+    QVector<QString> _extracted;     // per entry of _contents, the temporary file it went to
+    QHash<QString, QString> _remoteEtags; // file -> etag on the server before the download
+    QHash<QString, int> _byArchiveName;
+    QFile _currentFile;
+    int _currentIndex;
+    quint64 _received;
+    quint64 _total;
+
+    bool fetchRemoteEtags();
+    bool downloadArchive();
+    void discardExtracted();
+
+    bool beginEntry(const TarStreamReader::Entry &entry);
+    bool entryData(const char *data, size_t len);
+    bool endEntry();
+
+    /* only a tar stream is read, some servers send a zip instead. That
+     * one is not read at all, content_reader aborts the request. */
+    static int accept_tar(void *userdata, ne_request *req, const ne_status *st)
+    {
+        PropagateBulkDownload *that = static_cast<PropagateBulkDownload *>(userdata);
+        if (st->klass != 2) {
+            return 0;
+        }
+        const char *type = ne_get_response_header(req, "Content-Type");
+        if (!type || qstrncmp(type, "application/x-tar", 17) != 0) {
+            qDebug() << "Bulk download: the server sent" << type << "instead of a tar stream";
+            that->_propagator->_tarArchives = false;
+        }
+        return 1;
+    }
+
+    static int content_reader(void *userdata, const char *buf, size_t len)
+    {
+        PropagateBulkDownload *that = static_cast<PropagateBulkDownload *>(userdata);
+        if (that->_propagator->_abortRequested->fetchAndAddRelaxed(0)) {
+            ne_set_error(that->_propagator->_session, "Aborted by user");
+            return NE_ERROR;
+        }
+        if (!that->_propagator->_tarArchives) {
+            ne_set_error(that->_propagator->_session, "Not a tar stream");
+            return NE_ERROR;
+        }
+        if (!buf || !that->_reader->feed(buf, len)) {
+            return NE_ERROR;
+        }
+        return NE_OK;
+    }
+
+    TarStreamReader *_reader;
+};
+
+bool PropagateBulkDownload::worthIt(const QVector<SyncFileItem> &contents)
+{
+    int files = 0;
+    int small = 0;
+    foreach (const SyncFileItem &item, contents) {
+        if (item._instruction != CSYNC_INSTRUCTION_NEW || item._dir != SyncFileItem::Down) {
+            return false;
+        }
+        if (!item._isDirectory) {
+            ++files;
+            if (item._size <= bulkSmallFileSize) {
+                ++small;
+            }
+        }
+    }
+    return files >= bulkMinFiles && small * 100 >= files * bulkSmallFilesPercent;
+}
+
+bool PropagateBulkDownload::beginEntry(const TarStreamReader::Entry &entry)
+{
+    _currentIndex = -1;
+    const int index = _byArchiveName.value(entry.name, -1);
+    if (index < 0 || entry.isDirectory) {
+        // the directories are created beforehand, unknown entries were
+        // added after the discovery and are left to the next sync.
+        return true;
+    }
+
+    const SyncFileItem &item = _contents.at(index);
+    if (item._isDirectory || quint64(entry.size) != item._size || entry.mtime != item._modtime) {
+        qDebug() << "Bulk download:" << item._file << "changed since the discovery, fetching it alone";
+        return true;
+    }
+
+    QString tmpFileName = item._file;
+    tmpFileName.insert(tmpFileName.lastIndexOf('/') + 1, '.');
+    tmpFileName += ".~" + QString::number(uint(qrand()), 16);
+    _currentFile.setFileName(_propagator->_localDir + tmpFileName);
+    if (!_currentFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Bulk download: can not write" << _currentFile.fileName() << _currentFile.errorString();
+        return false;
+    }
+    csync_win32_set_file_hidden(_currentFile.fileName().toUtf8().constData(), true);
+
+    if (!_extracted.at(index).isEmpty()) {
+        QFile::remove(_propagator->_localDir + _extracted.at(index));
+        _extracted[index].clear();
+    }
+    _currentIndex = index;
+    _extracted[index] = tmpFileName;
+    return true;
+}
+
+bool PropagateBulkDownload::entryData(const char *data, size_t len)
+{
+    _received += len;
+    emit progress(Progress::Context, _item._file, _received, _total);
+    limitBandwidth(_received, _propagator->_downloadLimit);
+
+    if (_currentIndex < 0) {
+        return true;
+    }
+    ResourceGovernor::instance()->acquireDiskSlot();
+    const bool ok = _currentFile.write(data, len) == qint64(len);
+    ResourceGovernor::instance()->releaseDiskSlot();
+    return ok;
+}
+
+bool PropagateBulkDownload::endEntry()
+{
+    if (_currentIndex >= 0) {
+        _currentFile.close();
+        _currentIndex = -1;
+        return _currentFile.error() == QFile::NoError;
+    }
+    return true;
+}
+
+void PropagateBulkDownload::discardExtracted()
+{
+    if (_currentFile.isOpen()) {
+        _currentFile.close();
+    }
+    FileIoBatch batch;
+    for (int i = 0; i < _extracted.size(); ++i) {
+        if (!_extracted.at(i).isEmpty()) {
+            batch.unlink(_propagator->_localDir + _extracted.at(i));
+            _extracted[i].clear();
+        }
+    }
+    batch.submit();
+}
+
+bool PropagateBulkDownload::fetchRemoteEtags()
+{
+    static const QString davPath = QLatin1String("remote.php/webdav");
+    const int davPos = _propagator->_remoteDir.indexOf(davPath);
+    if (davPos < 0) {
+        return false;
+    }
+    QStringList dirs;
+    dirs.append(_item._file);
+    foreach (const SyncFileItem &item, _contents) {
+        if (item._isDirectory) {
+            dirs.append(item._file);
+        }
+    }
+    if (!BlockingDirectoryEtags::fetch(_propagator->_remoteDir.mid(davPos + davPath.length()), dirs,
+                                       _propagator->_abortRequested, &_remoteEtags)) {
+        qDebug() << "Bulk download: can not get the etags of" << _item._file;
+        return false;
+    }
+    return true;
+}
+
+bool PropagateBulkDownload::downloadArchive()
+{
+    // The files app of the server streams a directory as an archive:
+    // <base>/index.php/apps/files/ajax/download.php?dir=<parent>&files=<name>
+    static const QString davPath = QLatin1String("remote.php/webdav");
+    const int davPos = _propagator->_remoteDir.indexOf(davPath);
+    if (davPos < 0) {
+        return false;
+    }
+    const int slash = _item._file.lastIndexOf('/');
+    const QString parent = slash > 0 ? _item._file.left(slash) : QString();
+    const QString name = _item._file.mid(slash + 1);
+    const QString remoteParent = _propagator->_remoteDir.mid(davPos + davPath.length()) + parent;
+
+    QByteArray uri = QUrl::toPercentEncoding(_propagator->_remoteDir.left(davPos), "/");
+    uri += "index.php/apps/files/ajax/download.php?dir=" + QUrl::toPercentEncoding(remoteParent)
+            + "&files=" + QUrl::toPercentEncoding(name);
+
+    // the archive has the paths relative to the parent
+    for (int i = 0; i < _contents.size(); ++i) {
+        const QString &file = _contents.at(i)._file;
+        _byArchiveName.insert(slash > 0 ? file.mid(slash + 1) : file, i);
+        _total += _contents.at(i)._size;
+    }
+
+    TarStreamReader reader(this);
+    _reader = &reader;
+
+    QScopedPointer<ne_request, ScopedPointerHelpers> req(ne_request_create(_propagator->_session, "GET", uri.constData()));
+    ne_add_request_header(req.data(), "Accept", "application/x-tar");
+    ne_add_response_body_reader(req.data(), accept_tar, content_reader, this);
+    _lastProgress = 0;
+    _lastTime.start();
+
+    qDebug() << "Bulk download of" << _item._file << "with" << _contents.size() << "entries";
+    const int neon_stat = ne_request_dispatch(req.data());
+    const int httpStatus = ne_get_status(req.data())->code;
+    _reader = 0;
+
+    if (neon_stat != NE_OK || httpStatus != 200) {
+        _propagator->serverBusy(httpStatus, req.data());
+        qDebug() << "Bulk download failed:" << neon_stat << httpStatus
+                 << ne_get_error(_propagator->_session) << reader.errorString();
+        return false;
+    }
+    if (!reader.atEnd()) {
+        qDebug() << "Bulk download: the archive is truncated";
+        return false;
+    }
+    requestDone();
+    return true;
+}
+
+void PropagateBulkDownload::start()
+{
+    // like PropagateLocalMkdir, but for the whole tree at once
+    QDir localDir(_propagator->_localDir);
+    if (!localDir.mkpath(_item._file)) {
+        done(SyncFileItem::NormalError, tr("Could not create directory %1").arg(_item._file));
+        return;
+    }
+    foreach (const SyncFileItem &item, _contents) {
+        if (item._isDirectory && !localDir.mkpath(item._file)) {
+            done(SyncFileItem::NormalError, tr("Could not create directory %1").arg(item._file));
+            return;
+        }
+    }
+
+    // the etags are taken before the archive, an entry that changed since
+    // the discovery is dropped below and fetched alone.
+    if (!_propagator->_tarArchives || !fetchRemoteEtags() || !downloadArchive()) {
+        discardExtracted();
+    }
+
+    // The archive is complete, move the files in place all together.
+    QList<SyncJournalFileRecord> records;
+    for (int i = 0; i < _contents.size(); ++i) {
+        if (_extracted.at(i).isEmpty()) {
+            continue;
+        }
+        SyncFileItem &item = _contents[i];
+        const QString tmpFileName = _propagator->_localDir + _extracted.at(i);
+        const QString fn = _propagator->_localDir + item._file;
+        if (_remoteEtags.value(item._file).toUtf8() != item._etag) {
+            qDebug() << "Bulk download:" << item._file << "has a new etag, fetching it alone";
+            QFile::remove(tmpFileName);
+            _extracted[i].clear();
+            continue;
+        }
+        csync_win32_set_file_hidden(tmpFileName.toUtf8().constData(), false);
+        if (QFileInfo(fn).exists() || !QFile::rename(tmpFileName, fn)) {
+            // something appeared there meanwhile, the single download handles it.
+            QFile::remove(tmpFileName);
+            _extracted[i].clear();
+            continue;
+        }
+        struct timeval times[2];
+        times[0].tv_sec = times[1].tv_sec = item._modtime;
+        times[0].tv_usec = times[1].tv_usec = 0;
+        c_utimes(fn.toUtf8().data(), times);
+        records.append(SyncJournalFileRecord(item, fn));
+    }
+    if (!records.isEmpty()) {
+        _propagator->_journal->setFileRecords(records);
+    }
+    for (int i = 0; i < _contents.size(); ++i) {
+        if (!_extracted.at(i).isEmpty()) {
+            SyncFileItem &item = _contents[i];
+            item._status = SyncFileItem::Success;
+            emit progress(Progress::StartDownload, item._file, 0, item._size);
+            emit progress(Progress::EndDownload, item._file, 0, item._size);
+            emit completed(item);
+        }
+    }
+    qDebug() << "Bulk download:" << records.count() << "files from the archive";
+
+    // the rest file by file, like PropagateDirectory would have done
+    QStringList failed;
+    for (int i = 0; i < _contents.size(); ++i) {
+        const SyncFileItem &item = _contents.at(i);
+        if (item._isDirectory || !_extracted.at(i).isEmpty()) {
+            continue;
+        }
+        if (_propagator->_abortRequested->fetchAndAddRelaxed(0)) {
+            done(SyncFileItem::NormalError, tr("Aborted by user"));
+            return;
+        }
+        _propagator->_arena.reset();
+        PropagateDownloadFile job(_propagator, item);
+        connect(&job, SIGNAL(completed(SyncFileItem)), this, SIGNAL(completed(SyncFileItem)));
+        connect(&job, SIGNAL(progress(Progress::Kind,QString,quint64,quint64)),
+                this, SIGNAL(progress(Progress::Kind,QString,quint64,quint64)));
+        job.start();
+        if (job.status() == SyncFileItem::FatalError) {
+            done(SyncFileItem::FatalError, job.errorString());
+            return;
+        } else if (job.status() == SyncFileItem::NormalError) {
+            failed.append(item._file);
+        }
+    }
+
+    // a directory is only in the journal when all of its contents are.
+    records.clear();
+    for (int i = 0; i < _contents.size(); ++i) {
+        SyncFileItem &item = _contents[i];
+        if (!item._isDirectory) {
+            continue;
+        }
+        bool complete = true;
+        foreach (const QString &file, failed) {
+            if (file.startsWith(item._file + QLatin1Char('/'))) {
+                complete = false;
+                break;
+            }
+        }
+        if (complete) {
+            records.append(SyncJournalFileRecord(item, _propagator->_localDir + item._file));
+        }
+        item._status = complete ? SyncFileItem::Success : SyncFileItem::NormalError;
+        emit completed(item);
+    }
+    if (failed.isEmpty()) {
+        records.append(SyncJournalFileRecord(_item, _propagator->_localDir + _item._file));
+    }
+    _propagator->_journal->setFileRecords(records);
+
+    done(failed.isEmpty() ? SyncFileItem::Success : SyncFileItem::NormalError);
+}
+
+/*
+ * On the first sync of a folder seeded from a backup, a file that exists on
+ * both sides is adopted into the journal when it is the same as on the
+ * server: same size and an mtime within the tolerance, or the same content
+ * checksum if the server has one. Anything else is a normal conflict.
+ * Once a server answered without a checksum it is not asked again.
+ */
+class PropagateSeedFile : public PropagateItemJob {
+public:
+    PropagateSeedFile(OwncloudPropagator* propagator, const SyncFileItem& item)
+        : PropagateItemJob(propagator, item) {}
+    void start();
+private:
+    bool checksumMatches(const QString &fn);
+};
+
+bool PropagateSeedFile::checksumMatches(const QString &fn)
+{
+    const char *uri = _propagator->_arena.escapedPath(_propagator->_remoteDir, _item._file);
+    QScopedPointer<ne_request, ScopedPointerHelpers> req(ne_request_create(_propagator->_session, "HEAD", uri));
+    const int neon_stat = ne_request_dispatch(req.data());
+    if (neon_stat != NE_OK || ne_get_status(req.data())->klass != 2) {
+        _propagator->serverBusy(ne_get_status(req.data())->code, req.data());
+        return false;
+    }
+    requestDone();
+
+    // "SHA1:<hex> MD5:<hex> ...", servers without checksums do not send it
+    const QByteArray header(ne_get_response_header(req.data(), "OC-Checksum"));
+    if (header.isEmpty()) {
+        qDebug() << "Seeding: the server has no checksums, comparing size and mtime only";
+        _propagator->_serverChecksums = false;
+        return false;
+    }
+    foreach (const QByteArray &checksum, header.split(' ')) {
+        const int colon = checksum.indexOf(':');
+        const QByteArray type = checksum.left(colon).toUpper();
+        QCryptographicHash::Algorithm algorithm;
+        if (type == "SHA1") {
+            algorithm = QCryptographicHash::Sha1;
+        } else if (type == "MD5") {
+            algorithm = QCryptographicHash::Md5;
+        } else {
+            continue;
+        }
+
+        QFile file(fn);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        DiskJobLocker diskJob;
+        // hashes while the next blocks are read
+        const int BlockSize = 64 * 1024;
+        const int Blocks = 4;
+        QByteArray buffer(BlockSize * Blocks, 0);
+        QCryptographicHash hash(algorithm);
+        FileIoBatch batch(Blocks);
+        const qint64 size = file.size();
+        for (qint64 pos = 0; pos < size; pos += buffer.size()) {
+            if (_propagator->_abortRequested->fetchAndAddRelaxed(0)) {
+                return false;
+            }
+            batch.clear();
+            for (int i = 0; i < Blocks && pos + qint64(i) * BlockSize < size; ++i) {
+                batch.read(file.handle(), buffer.data() + i * BlockSize, BlockSize, pos + qint64(i) * BlockSize);
+            }
+            if (batch.submit() != 0) {
+                return false;
+            }
+            for (int i = 0; i < batch.count(); ++i) {
+                hash.addData(buffer.constData() + i * BlockSize, int(batch.result(i)));
+            }
+        }
+        return hash.result().toHex() == checksum.mid(colon + 1).trimmed().toLower();
+    }
+    return false;
+}
+
+void PropagateSeedFile::start()
+{
+    const QString fn = _propagator->_localDir + _item._file;
+    const QFileInfo fi(fn);
+
+    bool same = false;
+    if (fi.isFile() && quint64(fi.size()) == _item._size) {
+        const qint64 diff = qint64(fi.lastModified().toTime_t()) - qint64(_item._modtime);
+        same = qAbs(diff) <= _propagator->_seedMtimeTolerance
+                || (_propagator->_serverChecksums && checksumMatches(fn));
+    }
+
+    if (!same) {
+        PropagateDownloadFile job(_propagator, _item);
+        connect(&job, SIGNAL(completed(SyncFileItem)), this, SIGNAL(completed(SyncFileItem)));
+        connect(&job, SIGNAL(progress(Progress::Kind,QString,quint64,quint64)),
+                this, SIGNAL(progress(Progress::Kind,QString,quint64,quint64)));
+        job.start();
+        emit finished(job.status());
+        return;
+    }
+
+    qDebug() << "Seeding: adopting the local" << _item._file;
+    // the journal has the server mtime, the local file has to agree.
+    struct timeval times[2];
+    times[0].tv_sec = times[1].tv_sec = _item._modtime;
+    times[0].tv_usec = times[1].tv_usec = 0;
+    c_utimes(fn.toUtf8().data(), times);
+
+    _propagator->_journal->setFileRecord(SyncJournalFileRecord(_item, fn));
+    emit progress(Progress::Adopted, _item._file, 0, _item._size);
+    done(SyncFileItem::Success);
+}
+
 DECLARE_JOB(PropagateLocalRename)
 
 void PropagateLocalRename::start()
@@ -713,9 +1271,8 @@ void PropagateRemoteRename::start()
             // But we still need to fetch the new ETAG
             // FIXME   maybe do a recusrsive propfind after having moved the parent.
             // Note: we also update the mtime because the server do not keep the mtime when moving files
-            QScopedPointer<char, QScopedPointerPodDeleter> uri2(
-                ne_path_escape((_propagator->_remoteDir + _item._renameTarget).toUtf8()));
-            updateMTimeAndETag(uri2.data(), _item._modtime);
+            const char *uri2 = _propagator->_arena.escapedPath(_propagator->_remoteDir, _item._renameTarget);
+            updateMTimeAndETag(uri2, _item._modtime);
         }
     } else if (_item._file == QLatin1String("Shared") ) {
         // Check if it is the toplevel Shared folder and do not propagate it.
@@ -727,15 +1284,16 @@ void PropagateRemoteRename::start()
         return;
     } else {
 
-        QScopedPointer<char, QScopedPointerPodDeleter> uri1(ne_path_escape((_propagator->_remoteDir + _item._file).toUtf8()));
-        QScopedPointer<char, QScopedPointerPodDeleter> uri2(ne_path_escape((_propagator->_remoteDir + _item._renameTarget).toUtf8()));
+        const char *uri1 = _propagator->_arena.escapedPath(_propagator->_remoteDir, _item._file);
+        const char *uri2 = _propagator->_arena.escapedPath(_propagator->_remoteDir, _item._renameTarget);
 
-        int rc = ne_move(_propagator->_session, 1, uri1.data(), uri2.data());
+        int rc = ne_move(_propagator->_session, 1, uri1, uri2);
         if (updateErrorFromSession(rc)) {
             return;
         }
 
-        updateMTimeAndETag(uri2.data(), _item._modtime);
+        updateMTimeAndETag(uri2, _item._modtime);
+        requestDone();
     }
 
     _propagator->_journal->deleteFileRecord(_item._originalFile);
@@ -745,6 +1303,91 @@ void PropagateRemoteRename::start()
     done(SyncFileItem::Success);
 }
 
+/* An item moved here from another sync folder, see MoveMatcher.
+ * The item is moved on the server instead of being uploaded again, what
+ * is inside a moved directory only gets its journal record. */
+DECLARE_JOB(PropagateCrossFolderMove)
+
+void PropagateCrossFolderMove::start()
+{
+    int slash = -1;
+    while ((slash = _item._file.indexOf(QLatin1Char('/'), slash + 1)) > 0) {
+        if (_propagator->_crossFolderMoved.contains(_item._file.left(slash))) {
+            // came along with the parent, has the etag of the source record.
+            if (!_item._isDirectory) {
+                _propagator->_journal->setFileRecord(
+                        SyncJournalFileRecord(_item, _propagator->_localDir + _item._file));
+            }
+            done(SyncFileItem::Success);
+            return;
+        }
+    }
+
+    const char *uri1 = _propagator->_arena.escapedPath(QString(), _item._moveSource);
+    const char *uri2 = _propagator->_arena.escapedPath(_propagator->_remoteDir, _item._file);
+    qDebug() << "** MOVE from another folder" << uri1 << "=>" << uri2;
+    int rc = ne_move(_propagator->_session, 0, uri1, uri2);
+    if (rc != NE_OK && !_propagator->_abortRequested->fetchAndAddRelaxed(0)) {
+        // gone from the source already or taken at the destination
+        qDebug() << "Cross folder move failed, transferring" << _item._file << "instead:"
+                 << ne_get_error(_propagator->_session);
+        _item._moveSource.clear();
+        // the item has what the source journal knew, a child of a moved
+        // directory might have changed since. Transfer what is on the disk.
+        _item._etag.clear();
+        _item._fileId.clear();
+        const QFileInfo fi(_propagator->_localDir + _item._file);
+        _item._modtime = fi.lastModified().toTime_t();
+        _item._size = _item._isDirectory ? 0 : fi.size();
+        QScopedPointer<PropagateItemJob> job;
+        if (_item._isDirectory) {
+            job.reset(new PropagateRemoteMkdir(_propagator, _item));
+        } else {
+            job.reset(new PropagateUploadFile(_propagator, _item));
+        }
+        connect(job.data(), SIGNAL(completed(SyncFileItem)), this, SIGNAL(completed(SyncFileItem)));
+        connect(job.data(), SIGNAL(progress(Progress::Kind,QString,quint64,quint64)),
+                this, SIGNAL(progress(Progress::Kind,QString,quint64,quint64)));
+        connect(job.data(), SIGNAL(finished(SyncFileItem::Status)),
+                this, SIGNAL(finished(SyncFileItem::Status)));
+        job->start();
+        return;
+    }
+    if (updateErrorFromSession(rc)) {
+        return;
+    }
+    requestDone();
+
+    if (_item._isDirectory) {
+        // PropagateDirectory writes the record once the contents are done
+        _propagator->_crossFolderMoved.insert(_item._file);
+    } else {
+        // the server does not keep the mtime when moving files
+        updateMTimeAndETag(uri2, _item._modtime);
+        _propagator->_journal->setFileRecord(
+                SyncJournalFileRecord(_item, _propagator->_localDir + _item._file));
+    }
+    emit progress(Progress::EndUpload, _item._file, 0, _item._size);
+    done(SyncFileItem::Success);
+}
+
+void PropagateItemJob::requestDone()
+{
+    ServerBackoff::instance()->reportSuccess(_propagator->_serverKey);
+}
+
+void OwncloudPropagator::serverBusy(int httpStatus, ne_request *req)
+{
+    int retryAfter = -1;
+    if (req) {
+        retryAfter = ServerBackoff::parseRetryAfter(ne_get_response_header(req, "Retry-After"));
+    }
+    // 507 is about the storage, only back off if the server asks for it.
+    if (ServerBackoff::isBusyStatus(httpStatus) || (httpStatus == 507 && retryAfter >= 0)) {
+        ServerBackoff::instance()->reportBusy(_serverKey, retryAfter);
+    }
+}
+
 bool PropagateItemJob::updateErrorFromSession(int neon_code, ne_request* req, int ignoreHttpCode)
 {
     if( neon_code != NE_OK ) {
@@ -775,17 +1418,17 @@ bool PropagateItemJob::updateErrorFromSession(int neon_code, ne_request* req, in
                 return false;
             }
         }
+        _propagator->serverBusy(httpStatusCode, req);
         // FIXME: classify the error
         done (SyncFileItem::NormalError, errorString);
         return true;
     case NE_ERROR:  /* Generic error; use ne_get_error(session) for message */
         errorString = QString::fromUtf8(ne_get_error(_propagator->_session));
-        if (ignoreHttpCode) {
-            // Check if we don't need to ignore that error.
-            httpStatusCode = errorString.mid(0, errorString.indexOf(QChar(' '))).toInt();
-            if (httpStatusCode == ignoreHttpCode)
-                return false;
-        }
+        httpStatusCode = errorString.mid(0, errorString.indexOf(QChar(' '))).toInt();
+        // Check if we don't need to ignore that error.
+        if (ignoreHttpCode && httpStatusCode == ignoreHttpCode)
+            return false;
+        _propagator->serverBusy(httpStatusCode, req);
         done(SyncFileItem::NormalError, errorString);
         return true;
     case NE_LOOKUP:  /* Server or proxy hostname lookup failed */
@@ -805,7 +1448,24 @@ bool PropagateItemJob::updateErrorFromSession(int neon_code, ne_request* req, in
     return false;
 }
 
+void PropagateDirectory::startCurrentJob()
+{
+    // nothing goes out to a server that asked us to back off, check
+    // again every second so that an abort is not delayed.
+    const qint64 wait = ServerBackoff::instance()->remaining(_propagator->_serverKey);
+    if (wait > 0 && !_propagator->_abortRequested->fetchAndAddRelaxed(0)) {
+        qDebug() << "Server busy, next job in" << wait << "ms";
+        QTimer::singleShot(qMin(wait, qint64(1000)), this, SLOT(startCurrentJob()));
+        return;
+    }
+
+    startJob(_subJobs.at(_current));
+}
+
 PropagateItemJob* OwncloudPropagator::createJob(const SyncFileItem& item) {
+    if (!item._moveSource.isEmpty()) {
+        return new PropagateCrossFolderMove(this, item);
+    }
     switch(item._instruction) {
         case CSYNC_INSTRUCTION_REMOVE:
             if (item._dir == SyncFileItem::Down) return new PropagateLocalRemove(this, item);
@@ -821,6 +1481,9 @@ PropagateItemJob* OwncloudPropagator::createJob(const SyncFileItem& item) {
                 // Should we set the mtime?
                 return 0;
             }
+            if (item._instruction == CSYNC_INSTRUCTION_CONFLICT && _seedMtimeTolerance >= 0) {
+                return new PropagateSeedFile(this, item);
+            }
             if (item._dir != SyncFileItem::Up) return new PropagateDownloadFile(this, item);
             else return new PropagateUploadFile(this, item);
         case CSYNC_INSTRUCTION_RENAME:
@@ -837,14 +1500,66 @@ PropagateItemJob* OwncloudPropagator::createJob(const SyncFileItem& item) {
     return 0;
 }
 
+static bool isNewRemoteDirectory(const SyncFileItem &item)
+{
+    return item._isDirectory && item._instruction == CSYNC_INSTRUCTION_NEW
+            && item._dir == SyncFileItem::Down;
+}
+
+// the outermost of the directories that contains file, empty if none does
+static QString outermostDirectory(const QString &file, const QSet<QString> &directories)
+{
+    int slash = -1;
+    while ((slash = file.indexOf(QLatin1Char('/'), slash + 1)) > 0) {
+        const QString dir = file.left(slash);
+        if (directories.contains(dir)) {
+            return dir;
+        }
+    }
+    return QString();
+}
+
 void OwncloudPropagator::start(const SyncFileItemVector& _syncedItems)
 {
     /* This builds all the job needed for the propagation.
      * Each directories is a PropagateDirectory job, which contains the files in it.
      * In order to do that we sort the items by destination. and loop over it. When we enter a
      * directory, we can create the directory job and push it on the stack. */
+    const AllocStats::Phase allocPhase = AllocStats::setPhase(AllocStats::JobBuildPhase);
     SyncFileItemVector items = _syncedItems;
     std::sort(items.begin(), items.end());
+
+    /* New remote directories full of small files are downloaded as one
+     * archive. Collect the contents of the outermost new directories and
+     * keep those where it pays off. */
+    QHash<QString, QVector<SyncFileItem> > bulkContents;
+    QSet<QString> bulkDirectories;
+    if (_tarArchives) {
+        QSet<QString> newDirectories;
+        foreach(const SyncFileItem &item, items) {
+            if (isNewRemoteDirectory(item)) {
+                newDirectories.insert(item._file);
+            }
+        }
+        if (!newDirectories.isEmpty()) {
+            foreach(const SyncFileItem &item, items) {
+                const QString dir = outermostDirectory(item._file, newDirectories);
+                if (!dir.isEmpty()) {
+                    bulkContents[dir].append(item);
+                }
+            }
+        }
+        QHash<QString, QVector<SyncFileItem> >::iterator it = bulkContents.begin();
+        while (it != bulkContents.end()) {
+            if (PropagateBulkDownload::worthIt(it.value())) {
+                bulkDirectories.insert(it.key());
+                ++it;
+            } else {
+                it = bulkContents.erase(it);
+            }
+        }
+    }
+
     _rootJob.reset(new PropagateDirectory(this));
     QStack<QPair<QString /* directory name */, PropagateDirectory* /* job */> > directories;
     directories.push(qMakePair(QString(), _rootJob.data()));
@@ -857,11 +1572,20 @@ void OwncloudPropagator::start(const SyncFileItemVector& _syncedItems)
             continue;
         }
 
+        if (!bulkDirectories.isEmpty()) {
+            if (!outermostDirectory(item._file, bulkDirectories).isEmpty()) {
+                // part of an archive download
+                continue;
+            }
+        }
+
         while (!item._file.startsWith(directories.top().first)) {
             directories.pop();
         }
 
-        if (item._isDirectory) {
+        if (bulkDirectories.contains(item._file)) {
+            directories.top().second->append(new PropagateBulkDownload(this, item, bulkContents.value(item._file)));
+        } else if (item._isDirectory) {
             PropagateDirectory *dir = new PropagateDirectory(this, item);
             dir->_firstJob.reset(createJob(item));
             if (item._instruction == CSYNC_INSTRUCTION_REMOVE) {
@@ -874,12 +1598,17 @@ void OwncloudPropagator::start(const SyncFileItemVector& _syncedItems)
             directories.push(qMakePair(item._file + "/" , dir));
         } else if (PropagateItemJob* current = createJob(item)) {
             directories.top().second->append(current);
+            if (item._dir == SyncFileItem::Up && item._moveSource.isEmpty()
+                    && (item._instruction == CSYNC_INSTRUCTION_NEW || item._instruction == CSYNC_INSTRUCTION_SYNC)) {
+                _readAhead.addFile(_localDir + item._file, item._size);
+            }
         }
     }
 
     foreach(PropagatorJob* it, directoriesToRemove) {
         _rootJob->append(it);
     }
+    AllocStats::setPhase(allocPhase);
 
     connect(_rootJob.data(), SIGNAL(completed(SyncFileItem)), this, SIGNAL(completed(SyncFileItem)));
     connect(_rootJob.data(), SIGNAL(progress(Progress::Kind,QString,quint64,quint64)), this, SIGNAL(progress(Progress::Kind,QString,quint64,quint64)));
@@ -896,10 +1625,13 @@ void PropagateDirectory::proceedNext(SyncFileItem::Status status)
         _hasError = true;
     }
 
+    // the previous job is done, this is the only place where no job holds
+    // on to memory of the arena.
+    _propagator->_arena.reset();
+
     _current ++;
     if (_current < _subJobs.size()) {
-        PropagatorJob *next = _subJobs.at(_current);
-        startJob(next);
+        startCurrentJob();
     } else {
         if (!_item.isEmpty() && !_hasError) {
             SyncJournalFileRecord record(_item,  _propagator->_localDir + _item._file);
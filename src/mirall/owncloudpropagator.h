@@ -18,10 +18,13 @@
 #include <neon/ne_request.h>
 #include <QHash>
 #include <QObject>
+#include <QSet>
 #include <qelapsedtimer.h>
 
 #include "syncfileitem.h"
 #include "progressdispatcher.h"
+#include "propagatorarena.h"
+#include "uploadreadahead.h"
 
 struct hbf_transfer_s;
 struct ne_session_s;
@@ -96,6 +99,7 @@ private slots:
     }
 
     void proceedNext(SyncFileItem::Status status);
+    void startCurrentJob();
 };
 
 
@@ -116,6 +120,9 @@ protected:
     void updateMTimeAndETag(const char *uri, time_t);
     void getFileId( const char *uri );
 
+    /* tell the ServerBackoff about a request that went through */
+    void requestDone();
+
     /* fetch the error code and string from the session
        in case of error, calls done with the error and returns true.
 
@@ -159,6 +166,13 @@ public:
     QString _localDir; // absolute path to the local directory. ends with '/'
     QString _remoteDir; // path to the root of the remote. ends with '/'
     SyncJournalDb *_journal;
+    PropagatorArena _arena; // short lived buffers of the running job, reset between the jobs
+
+    QString _serverKey; // for the ServerBackoff
+    UploadReadAhead _readAhead; // the files of the upload jobs, in the order they run
+
+    /* reports a busy reply of the server to the ServerBackoff */
+    void serverBusy(int httpStatus, ne_request *req);
 
 public:
     OwncloudPropagator(ne_session_s *session, const QString &localDir, const QString &remoteDir,
@@ -167,6 +181,9 @@ public:
             , _localDir(localDir)
             , _remoteDir(remoteDir)
             , _journal(progressDb)
+            , _seedMtimeTolerance(-1)
+            , _tarArchives(false)
+            , _serverChecksums(true)
             , _abortRequested(abortRequested)
     {
         if (!localDir.endsWith(QChar('/'))) _localDir+='/';
@@ -178,6 +195,20 @@ public:
     int _downloadLimit;
     int _uploadLimit;
 
+    /* in seconds, the mtime difference within which an existing local file
+     * is adopted on the initial sync. -1 when not seeding. */
+    int _seedMtimeTolerance;
+
+    /* new directories full of small files are downloaded as one tar stream.
+     * Cleared as soon as the server sends something else. */
+    bool _tarArchives;
+
+    /* the server sends OC-Checksum headers, cleared on the first reply without */
+    bool _serverChecksums;
+
+    /* directories moved as a whole from another sync folder */
+    QSet<QString> _crossFolderMoved;
+
     QAtomicInt *_abortRequested; // boolean set by the main thread to abort.
 
 signals:
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/pagecachedropper.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace Mirall {
+
+// files from this size on bypass the page cache
+static const qint64 largeFileSize = 32 * 1024 * 1024;
+// pages are dropped in windows of this size
+static const qint64 dropWindow = 8 * 1024 * 1024;
+
+PageCacheDropper::PageCacheDropper(QFile *file, Mode mode)
+    : _file(file),
+      _mode(mode),
+      _dropped(0),
+      _flushing(0)
+{
+#if defined(Q_OS_MAC)
+    if (_file->handle() >= 0) {
+        fcntl(_file->handle(), F_NOCACHE, 1);
+    }
+#elif defined(Q_OS_UNIX)
+    if (_mode == Reading && _file->handle() >= 0) {
+        posix_fadvise(_file->handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+}
+
+PageCacheDropper::~PageCacheDropper()
+{
+    finish();
+}
+
+bool PageCacheDropper::isLarge(qint64 size)
+{
+    return size >= largeFileSize;
+}
+
+void PageCacheDropper::drop(qint64 from, qint64 to)
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+    const int fd = _file->handle();
+    if (fd < 0 || to <= from) {
+        return;
+    }
+    if (_mode == Writing) {
+#ifdef Q_OS_LINUX
+        // waits only for the window whose writeback was started before
+        sync_file_range(fd, from, to - from,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#else
+        fdatasync(fd);
+#endif
+    }
+    posix_fadvise(fd, from, to - from, POSIX_FADV_DONTNEED);
+#else
+    Q_UNUSED(from);
+    Q_UNUSED(to);
+#endif
+}
+
+void PageCacheDropper::advance(qint64 position)
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+    if (_file->handle() < 0) {
+        return;
+    }
+    if (_mode == Reading) {
+        if (position - _dropped >= dropWindow) {
+            drop(_dropped, position);
+            _dropped = position;
+        }
+        return;
+    }
+
+    if (position - _flushing < dropWindow) {
+        return;
+    }
+    // QFile has its own buffer
+    _file->flush();
+#ifdef Q_OS_LINUX
+    // start the writeback of the new window and drop the one before,
+    // its writeback had a window's time to complete.
+    sync_file_range(_file->handle(), _flushing, position - _flushing, SYNC_FILE_RANGE_WRITE);
+    drop(_dropped, _flushing);
+    _dropped = _flushing;
+#else
+    drop(_dropped, position);
+    _dropped = position;
+#endif
+    _flushing = position;
+#else
+    Q_UNUSED(position);
+#endif
+}
+
+void PageCacheDropper::finish()
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+    if (_file->handle() < 0) {
+        return;
+    }
+    if (_mode == Writing) {
+        _file->flush();
+    }
+    // up to the end of the file
+    const qint64 end = _file->size();
+    drop(_dropped, end);
+    _dropped = _flushing = end;
+#endif
+}
+
+qint64 PageCacheDropper::residentBytes(const QString &fileName)
+{
+#ifdef Q_OS_UNIX
+    const int fd = open(QFile::encodeName(fileName).constData(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) < 0) {
+        close(fd);
+        return -1;
+    }
+    if (sb.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    void *map = mmap(0, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    const size_t pages = (sb.st_size + pageSize - 1) / pageSize;
+    QByteArray vec(int(pages), 0);
+    qint64 resident = -1;
+#ifdef Q_OS_LINUX
+    if (mincore(map, sb.st_size, reinterpret_cast<unsigned char *>(vec.data())) == 0) {
+#else
+    if (mincore(map, sb.st_size, vec.data()) == 0) {
+#endif
+        resident = 0;
+        for (size_t i = 0; i < pages; ++i) {
+            if (vec.at(int(i)) & 1) {
+                resident += pageSize;
+            }
+        }
+        resident = qMin(resident, qint64(sb.st_size));
+    }
+    munmap(map, sb.st_size);
+    return resident;
+#else
+    Q_UNUSED(fileName);
+    return -1;
+#endif
+}
+
+}
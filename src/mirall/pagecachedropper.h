@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_PAGECACHEDROPPER_H
+#define MIRALL_PAGECACHEDROPPER_H
+
+#include <QtGlobal>
+
+class QFile;
+class QString;
+
+namespace Mirall {
+
+/**
+ * @brief Keeps large transfers from pushing everything else out of the page cache.
+ *
+ * Streaming a big file through buffered I/O leaves all of it in the page
+ * cache, at the expense of the applications the user works with. The
+ * dropper follows the position of the stream and tells the kernel to drop
+ * the pages behind it (posix_fadvise DONTNEED). Written pages are flushed
+ * first, a dirty page can not be dropped. On Mac the file is opened for
+ * uncached access instead, elsewhere it does nothing.
+ *
+ * Only worth it for files above isLarge(), small files are better cached.
+ */
+class PageCacheDropper
+{
+public:
+    enum Mode { Reading, Writing };
+
+    PageCacheDropper(QFile *file, Mode mode);
+    ~PageCacheDropper();
+
+    /** The stream has read or written the file up to position. */
+    void advance(qint64 position);
+
+    /** Drops what is left, also done by the destructor. */
+    void finish();
+
+    static bool isLarge(qint64 size);
+
+    /** bytes of the file that are in the page cache, -1 if it can not be told */
+    static qint64 residentBytes(const QString &fileName);
+
+private:
+    void drop(qint64 from, qint64 to);
+
+    QFile  *_file;
+    Mode    _mode;
+    qint64  _dropped;   // everything before is dropped
+    qint64  _flushing;  // writeback of everything before was started
+};
+
+}
+
+#endif // MIRALL_PAGECACHEDROPPER_H
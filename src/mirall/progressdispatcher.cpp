@@ -12,6 +12,8 @@
  */
 
 #include "progressdispatcher.h"
+#include "mirall/mirallconfigfile.h"
+#include "mirall/allocstats.h"
 
 #include <QObject>
 #include <QMetaType>
@@ -20,7 +22,34 @@
 
 namespace Mirall {
 
+// weight of a new sample in the smoothed rate
+static const double rateSmoothing = 0.3;
+// minimal time between two rate samples
+static const qint64 rateSampleMsec = 1000;
+
 ProgressDispatcher* ProgressDispatcher::_instance = 0;
+
+void Progress::TransferRate::addSample( qint64 bytes, qint64 msecs )
+{
+    if( msecs <= 0 || bytes < 0 ) {
+        return;
+    }
+    const double sample = double(bytes) * 1000.0 / msecs;
+    _rate = (_rate > 0) ? rateSmoothing * sample + (1.0 - rateSmoothing) * _rate : sample;
+}
+
+qint64 Progress::estimatedTimeLeft( double uploadRate, double downloadRate,
+                                    qint64 uploadBytes, qint64 downloadBytes )
+{
+    if( (uploadBytes > 0 && uploadRate <= 0) || (downloadBytes > 0 && downloadRate <= 0) ) {
+        return -1;
+    }
+    double secs = 0;
+    if( uploadBytes > 0 ) secs += uploadBytes / uploadRate;
+    if( downloadBytes > 0 ) secs += downloadBytes / downloadRate;
+    return qint64(secs);
+}
+
 QString Progress::asResultString( Kind kind )
 {
     QString re;
@@ -58,6 +87,9 @@ QString Progress::asResultString( Kind kind )
     case EndDelete:
         re = QCoreApplication::translate( "progress", "deleted");
         break;
+    case Adopted:
+        re = QCoreApplication::translate( "progress", "Adopted");
+        break;
     default:
         Q_ASSERT(false);
     }
@@ -106,6 +138,9 @@ QString Progress::asActionString( Kind kind )
     case EndDelete:
         re = QCoreApplication::translate( "progress", "deleted");
         break;
+    case Adopted:
+        re = QCoreApplication::translate( "progress", "adopted");
+        break;
     default:
         Q_ASSERT(false);
     }
@@ -149,6 +184,7 @@ QList<Progress::SyncProblem> ProgressDispatcher::recentProblems(int count)
 
 void ProgressDispatcher::setProgressInfo(const QString& folder, const Progress::Info& progress)
 {
+    AllocScope allocScope(AllocStats::ProgressPhase);
     if( folder.isEmpty() ) {
         return;
     }
@@ -173,6 +209,7 @@ void ProgressDispatcher::setProgressInfo(const QString& folder, const Progress::
             _recentProblems.clear();
             _timer.start();
         }
+        updateThroughput(folder, &newProgress);
         if( newProgress.kind == Progress::EndSync ) {
             newProgress.overall_current_bytes = newProgress.overall_transmission_size;
             newProgress.current_file_no = newProgress.overall_file_count;
@@ -209,4 +246,105 @@ Progress::Kind ProgressDispatcher::currentFolderContext( const QString& folder )
     return Progress::Invalid;
 }
 
+qint64 ProgressDispatcher::historicalRate( const QString& folder, Progress::Kind direction )
+{
+    const Throughput& tp = throughput(folder);
+    return qint64(direction == Progress::Upload ? tp.uploadRate.rate() : tp.downloadRate.rate());
+}
+
+qint64 ProgressDispatcher::estimatedDuration( const QString& folder, qint64 uploadBytes, qint64 downloadBytes )
+{
+    const Throughput& tp = throughput(folder);
+    return Progress::estimatedTimeLeft(tp.uploadRate.rate(), tp.downloadRate.rate(),
+                                       uploadBytes, downloadBytes);
+}
+
+ProgressDispatcher::Throughput& ProgressDispatcher::throughput( const QString& folder )
+{
+    Throughput& tp = _throughput[folder];
+    if( !tp.loaded ) {
+        MirallConfigFile cfg;
+        tp.uploadRate   = Progress::TransferRate(cfg.transferRate(folder, true));
+        tp.downloadRate = Progress::TransferRate(cfg.transferRate(folder, false));
+        tp.loaded = true;
+    }
+    return tp;
+}
+
+void ProgressDispatcher::updateThroughput( const QString& folder, Progress::Info *info )
+{
+    Throughput& tp = throughput(folder);
+
+    switch( info->kind ) {
+    case Progress::StartSync:
+        tp.lastBytes = 0;
+        tp.lastSample.start();
+        tp.direction = Progress::Invalid;
+        break;
+    case Progress::StartUpload:
+    case Progress::StartDownload:
+        // the time between two transfers is not part of the rate.
+        tp.direction = (info->kind == Progress::StartUpload) ? Progress::Upload : Progress::Download;
+        tp.lastBytes = info->overall_current_bytes;
+        tp.lastSample.restart();
+        break;
+    case Progress::Context:
+    case Progress::EndUpload:
+    case Progress::EndDownload: {
+        if( tp.direction == Progress::Invalid || !tp.lastSample.isValid() ) {
+            break;
+        }
+        const qint64 msecs = tp.lastSample.elapsed();
+        const qint64 bytes = info->overall_current_bytes - tp.lastBytes;
+        // very short intervals only add noise, wait for more data.
+        if( msecs < rateSampleMsec && info->kind == Progress::Context ) {
+            break;
+        }
+        if( tp.direction == Progress::Upload ) {
+            tp.uploadRate.addSample(bytes, msecs);
+        } else {
+            tp.downloadRate.addSample(bytes, msecs);
+        }
+        tp.lastBytes = info->overall_current_bytes;
+        tp.lastSample.restart();
+        if( info->kind != Progress::Context ) {
+            tp.direction = Progress::Invalid;
+        }
+        break;
+    }
+    case Progress::EndSync: {
+        MirallConfigFile cfg;
+        if( tp.uploadRate.rate() > 0 ) cfg.setTransferRate(folder, true, tp.uploadRate.rate());
+        if( tp.downloadRate.rate() > 0 ) cfg.setTransferRate(folder, false, tp.downloadRate.rate());
+        break;
+    }
+    default:
+        break;
+    }
+
+    // the rate of what is transferred right now, otherwise the better known one
+    double rate = 0;
+    if( tp.direction == Progress::Upload ) {
+        rate = tp.uploadRate.rate();
+    } else if( tp.direction == Progress::Download ) {
+        rate = tp.downloadRate.rate();
+    } else {
+        rate = qMax(tp.uploadRate.rate(), tp.downloadRate.rate());
+    }
+    info->current_rate = qint64(rate);
+
+    // uploads and downloads usually run at very different speeds, so both
+    // parts of what is left are estimated with the rate of their direction.
+    const qint64 uploadLeft = info->upload_transmission_size - info->upload_current_bytes;
+    const qint64 downloadLeft = (info->overall_transmission_size - info->upload_transmission_size)
+            - (info->overall_current_bytes - info->upload_current_bytes);
+    info->estimated_time_left = Progress::estimatedTimeLeft(tp.uploadRate.rate(), tp.downloadRate.rate(),
+                                                            uploadLeft, downloadLeft);
+    if( info->estimated_time_left < 0 && rate > 0 ) {
+        // one direction was never measured, the other one is better than nothing.
+        info->estimated_time_left = qint64((uploadLeft + downloadLeft) / rate);
+    }
+}
+
+
 }
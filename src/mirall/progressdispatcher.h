@@ -42,6 +42,7 @@ namespace Progress
         EndSync,
         StartDelete,
         EndDelete,
+        Adopted,     // a local file taken over as it is, see PropagateSeedFile
         Error
     };
 
@@ -57,13 +58,45 @@ namespace Progress
         qint64  overall_transmission_size;
         qint64  overall_current_bytes;
 
+        // the upload part of the two overall sizes above
+        qint64  upload_transmission_size;
+        qint64  upload_current_bytes;
+
         QDateTime timestamp;
 
+        // filled in by the ProgressDispatcher
+        qint64  current_rate;        // smoothed, in bytes per second, 0 if unknown
+        qint64  estimated_time_left; // in seconds, -1 if unknown
+
         Info() : kind(Invalid), file_size(0), current_file_bytes(0),
                  overall_file_count(0), current_file_no(0),
-                 overall_transmission_size(0), overall_current_bytes(0)  { }
+                 overall_transmission_size(0), overall_current_bytes(0),
+                 upload_transmission_size(0), upload_current_bytes(0),
+                 current_rate(0), estimated_time_left(-1)  { }
     };
 
+    /**
+     * @brief Smoothed transfer rate in bytes per second.
+     *
+     * An exponential moving average over the samples, the first sample is
+     * taken as it is.
+     */
+    class TransferRate {
+    public:
+        explicit TransferRate( double rate = 0 ) : _rate(rate) {}
+        void addSample( qint64 bytes, qint64 msecs );
+        double rate() const { return _rate; }
+    private:
+        double _rate;
+    };
+
+    /**
+     * Time in seconds to transfer the given amounts at the given rates.
+     * Returns -1 if a rate is needed but not known.
+     */
+    qint64 estimatedTimeLeft( double uploadRate, double downloadRate,
+                              qint64 uploadBytes, qint64 downloadBytes );
+
     struct SyncProblem {
         QString folder;
         QString current_file;
@@ -98,6 +131,19 @@ public:
     QList<Progress::SyncProblem> recentProblems(int count);
 
     Progress::Kind currentFolderContext( const QString& folder );
+
+    /**
+     * Smoothed transfer rate of the folder, kept over earlier syncs, in
+     * bytes per second. Kind is Progress::Upload or Progress::Download.
+     * Returns 0 if nothing was measured yet.
+     */
+    qint64 historicalRate( const QString& folder, Progress::Kind direction );
+
+    /**
+     * Estimated time in seconds to transfer the given amounts with the
+     * historical rates. Returns -1 if no rate is known for a needed direction.
+     */
+    qint64 estimatedDuration( const QString& folder, qint64 uploadBytes, qint64 downloadBytes );
 signals:
     /**
       @brief Signals the progress of data transmission.
@@ -115,11 +161,25 @@ protected:
 
 private:
     ProgressDispatcher(QObject* parent = 0);
+
+    struct Throughput {
+        Throughput() : lastBytes(0), direction(Progress::Invalid), loaded(false) {}
+        qint64         lastBytes;
+        QElapsedTimer  lastSample;
+        Progress::Kind direction; // Upload or Download while a file is transferred
+        Progress::TransferRate uploadRate;
+        Progress::TransferRate downloadRate;
+        bool           loaded;
+    };
+    Throughput& throughput( const QString& folder );
+    void updateThroughput( const QString& folder, Progress::Info *info );
+
     const int _QueueSize;
     QList<Progress::Info> _recentChanges;
     QList<Progress::SyncProblem> _recentProblems;
 
     QHash<QString, Progress::Kind> _currentAction;
+    QHash<QString, Throughput> _throughput;
 
     QElapsedTimer _timer;
     static ProgressDispatcher* _instance;
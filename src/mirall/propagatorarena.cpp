@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/propagatorarena.h"
+
+#include <QScopedPointer>
+
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#include <neon/ne_uri.h>
+
+namespace Mirall {
+
+static const size_t arenaAlignment = 16;
+
+static inline size_t alignedSize(size_t size)
+{
+    return (size + arenaAlignment - 1) & ~(arenaAlignment - 1);
+}
+
+PropagatorArena::PropagatorArena(size_t blockSize)
+    : _first(0),
+      _current(0),
+      _blockSize(blockSize)
+{
+}
+
+PropagatorArena::~PropagatorArena()
+{
+    Block *block = _first;
+    while( block ) {
+        Block *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+char *PropagatorArena::data(Block *block) const
+{
+    return reinterpret_cast<char*>(block) + alignedSize(sizeof(Block));
+}
+
+PropagatorArena::Block *PropagatorArena::newBlock(size_t minSize)
+{
+    const size_t size = qMax(_blockSize, minSize);
+    Block *block = static_cast<Block*>(malloc(alignedSize(sizeof(Block)) + size));
+    if( !block ) {
+        throw std::bad_alloc();
+    }
+    block->next = 0;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void *PropagatorArena::allocate(size_t size)
+{
+    size = alignedSize(qMax(size, size_t(1)));
+
+    if( !_current ) {
+        _first = _current = newBlock(size);
+    }
+    // the blocks behind the current one are left over from before a reset.
+    while( _current->used + size > _current->size ) {
+        if( _current->next && _current->next->size >= size ) {
+            _current = _current->next;
+            _current->used = 0;
+        } else {
+            Block *block = newBlock(size);
+            block->next = _current->next;
+            _current->next = block;
+            _current = block;
+        }
+    }
+
+    void *ptr = data(_current) + _current->used;
+    _current->used += size;
+    return ptr;
+}
+
+const char *PropagatorArena::escapedPath(const QString &dir, const QString &file)
+{
+    QScopedPointer<char, QScopedPointerPodDeleter> escaped(ne_path_escape((dir + file).toUtf8()));
+    const size_t len = strlen(escaped.data());
+    char *out = static_cast<char*>(allocate(len + 1));
+    memcpy(out, escaped.data(), len + 1);
+    return out;
+}
+
+const char *PropagatorArena::number(qint64 number)
+{
+    char *out = static_cast<char*>(allocate(24));
+    qsnprintf(out, 24, "%lld", static_cast<long long>(number));
+    return out;
+}
+
+const char *PropagatorArena::quoted(const QByteArray &value)
+{
+    char *out = static_cast<char*>(allocate(value.size() + 3));
+    out[0] = '"';
+    memcpy(out + 1, value.constData(), value.size());
+    out[value.size() + 1] = '"';
+    out[value.size() + 2] = '\0';
+    return out;
+}
+
+void PropagatorArena::reset()
+{
+    _current = _first;
+    if( _current ) {
+        _current->used = 0;
+    }
+}
+
+size_t PropagatorArena::bytesUsed() const
+{
+    size_t used = 0;
+    for( Block *block = _first; block; block = block->next ) {
+        used += block->used;
+        if( block == _current ) break;
+    }
+    return used;
+}
+
+}
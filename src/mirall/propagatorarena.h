@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_PROPAGATORARENA_H
+#define MIRALL_PROPAGATORARENA_H
+
+#include <QString>
+#include <QByteArray>
+
+#include <stddef.h>
+
+namespace Mirall {
+
+/**
+ * @brief Bump allocator for the short lived buffers of the propagation jobs.
+ *
+ * The jobs of the propagator run one after the other, and most of what
+ * they allocate (escaped request uris, header values) is not needed
+ * anymore once the job is done. The propagator resets the arena between
+ * two jobs, which keeps the blocks, so after the first few jobs handing
+ * out a buffer is a pointer bump.
+ *
+ * Everything returned by the arena is only valid until the next reset().
+ */
+class PropagatorArena
+{
+public:
+    explicit PropagatorArena(size_t blockSize = 4096);
+    ~PropagatorArena();
+
+    /** Uninitialized memory, aligned for any scalar type. */
+    void *allocate(size_t size);
+
+    /**
+     * The UTF-8 encoded, percent escaped concatenation of @p dir and
+     * @p file, to be used as request uri. Lives until the next reset(),
+     * so the jobs need no cleanup for it.
+     */
+    const char *escapedPath(const QString &dir, const QString &file);
+
+    /** Decimal representation of @p number. */
+    const char *number(qint64 number);
+
+    /** @p value enclosed in double quotes, e.g. for If-Match headers. */
+    const char *quoted(const QByteArray &value);
+
+    /** Makes all the memory available again, keeping the blocks. */
+    void reset();
+
+    /** Bytes handed out since the last reset. */
+    size_t bytesUsed() const;
+
+private:
+    struct Block {
+        Block *next;
+        size_t size;
+        size_t used;
+    };
+
+    char *data(Block *block) const;
+    Block *newBlock(size_t minSize);
+
+    Block *_first;
+    Block *_current;
+    size_t _blockSize;
+
+    Q_DISABLE_COPY(PropagatorArena)
+};
+
+}
+
+#endif // MIRALL_PROPAGATORARENA_H
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/remotediscoveryprefetcher.h"
+#include "mirall/folder.h"
+#include "mirall/owncloudinfo.h"
+#include "mirall/listingconcurrency.h"
+#include "mirall/syncfileitem.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+
+namespace Mirall {
+
+// from this many changed directories on, one recursive PROPFIND is cheaper
+static const int manyChangedDirectories = 20;
+// no folder gets more requests than this
+static const int maxRequestsPerFolder = 200;
+
+RemoteDiscoveryPrefetcher::RemoteDiscoveryPrefetcher(QObject *parent)
+    : QObject(parent),
+      _running(0),
+      _nextId(1)
+{
+}
+
+bool RemoteDiscoveryPrefetcher::loadJournal(const QString &journalFile, QHash<QString, QString> *etags)
+{
+    if( !QFile::exists(journalFile) ) {
+        return false;
+    }
+
+    bool ok = true;
+    const QString connectionName = QString::fromLatin1("RemoteDiscoveryPrefetcher_%1").arg(quintptr(etags));
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase( QLatin1String("QSQLITE"), connectionName );
+        db.setDatabaseName(journalFile);
+        db.setConnectOptions(QLatin1String("QSQLITE_OPEN_READONLY"));
+
+        if( !db.open() ) {
+            qDebug() << "RemoteDiscoveryPrefetcher: can not open" << journalFile << db.lastError().text();
+            ok = false;
+        } else {
+            QSqlQuery query(db);
+            query.prepare(QLatin1String("SELECT path, md5 FROM metadata WHERE type=?"));
+            query.bindValue(0, int(SyncFileItem::Directory));
+            if( !query.exec() ) {
+                qDebug() << "RemoteDiscoveryPrefetcher: can not read" << journalFile << query.lastError().text();
+                ok = false;
+            }
+            while( ok && query.next() ) {
+                etags->insert(query.value(0).toString(), query.value(1).toString());
+            }
+            query.finish();
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    return ok;
+}
+
+void RemoteDiscoveryPrefetcher::prefetch(Folder *folder)
+{
+    if( !folder || _discoveries.contains(folder->alias()) ) {
+        return;
+    }
+
+    Discovery discovery;
+    // without a journal csync fetches the tree recursively anyway
+    if( !loadJournal(folder->journalDbFile(), &discovery.journalEtags) ) {
+        return;
+    }
+    qDebug() << "RemoteDiscoveryPrefetcher: discovering" << folder->alias() << "ahead of its sync";
+    discovery.id = _nextId++;
+    discovery.secondPath = folder->secondPath();
+    discovery.pending.enqueue(QString());
+    _discoveries.insert(folder->alias(), discovery);
+    startRequests();
+}
+
+RemoteDiscoveryPrefetcher::Result RemoteDiscoveryPrefetcher::takeResult(const QString &alias, const QString &etag)
+{
+    if( !_discoveries.contains(alias) ) {
+        return Unknown;
+    }
+    const Discovery discovery = _discoveries.take(alias);
+    if( !discovery.done || discovery.rootEtag.isEmpty() || discovery.rootEtag != etag ) {
+        return Unknown;
+    }
+    qDebug() << "RemoteDiscoveryPrefetcher:" << discovery.changed << "changed directories in" << alias;
+    return discovery.changed >= manyChangedDirectories ? ManyChanges : FewChanges;
+}
+
+void RemoteDiscoveryPrefetcher::startRequests()
+{
+    // requests in flight for all folders together, as many as the server takes
+    const int maxRunningRequests = ListingConcurrency::instance()->level();
+    QHash<QString, Discovery>::iterator it;
+    for( it = _discoveries.begin(); it != _discoveries.end() && _running < maxRunningRequests; ++it ) {
+        Discovery &discovery = it.value();
+        while( _running < maxRunningRequests && !discovery.done && !discovery.pending.isEmpty() ) {
+            Job job;
+            job.alias = it.key();
+            job.directory = discovery.pending.dequeue();
+            job.discoveryId = discovery.id;
+
+            QString path = discovery.secondPath;
+            if( !job.directory.isEmpty() ) {
+                if( !path.endsWith(QLatin1Char('/')) ) {
+                    path += QLatin1Char('/');
+                }
+                path += job.directory;
+            }
+            RequestDirectoryEtagsJob *request = new RequestDirectoryEtagsJob(path, this);
+            connect(request, SIGNAL(directoriesRetreived(QString,QHash<QString,QString>)),
+                    this, SLOT(slotDirectoriesRetreived(QString,QHash<QString,QString>)));
+            connect(request, SIGNAL(networkError()), this, SLOT(slotNetworkError()));
+            _jobs.insert(request, job);
+            ++_running;
+            ++discovery.running;
+            ++discovery.requests;
+        }
+    }
+}
+
+RemoteDiscoveryPrefetcher::Discovery *RemoteDiscoveryPrefetcher::finishRequest(QObject *request, QString *directory)
+{
+    if( !_jobs.contains(request) ) {
+        return 0;
+    }
+    const Job job = _jobs.take(request);
+    --_running;
+    QHash<QString, Discovery>::iterator it = _discoveries.find(job.alias);
+    if( it == _discoveries.end() || it->id != job.discoveryId ) {
+        // the folder is syncing already
+        return 0;
+    }
+    --it->running;
+    *directory = job.directory;
+    return &it.value();
+}
+
+void RemoteDiscoveryPrefetcher::slotDirectoriesRetreived(const QString &etag,
+                                                         const QHash<QString, QString> &directoryEtags)
+{
+    QString directory;
+    Discovery *discovery = finishRequest(sender(), &directory);
+    if( discovery ) {
+        if( directory.isEmpty() ) {
+            discovery->rootEtag = etag;
+        }
+        // only a changed directory can contain changes
+        QHash<QString, QString>::const_iterator it;
+        for( it = directoryEtags.constBegin(); it != directoryEtags.constEnd(); ++it ) {
+            const QString path = directory.isEmpty() ? it.key() : directory + QLatin1Char('/') + it.key();
+            if( discovery->journalEtags.value(path) != it.value() ) {
+                ++discovery->changed;
+                discovery->pending.enqueue(path);
+            }
+        }
+        if( discovery->changed >= manyChangedDirectories || discovery->requests >= maxRequestsPerFolder ) {
+            // enough to decide
+            discovery->pending.clear();
+            discovery->done = true;
+        } else if( discovery->pending.isEmpty() && discovery->running == 0 ) {
+            discovery->done = true;
+        }
+    }
+    startRequests();
+}
+
+void RemoteDiscoveryPrefetcher::slotNetworkError()
+{
+    QString directory;
+    Discovery *discovery = finishRequest(sender(), &directory);
+    if( discovery ) {
+        // the sync itself finds out what is wrong
+        discovery->pending.clear();
+        discovery->rootEtag.clear();
+        discovery->done = true;
+    }
+    startRequests();
+}
+
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_REMOTEDISCOVERYPREFETCHER_H
+#define MIRALL_REMOTEDISCOVERYPREFETCHER_H
+
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QString>
+
+namespace Mirall {
+
+class Folder;
+
+/**
+ * @brief Finds out how much changed on the server for folders waiting to sync.
+ *
+ * While one folder syncs, the next ones in the queue are walked with Depth:1
+ * PROPFINDs, a few requests at a time. Only directories whose etag differs
+ * from the journal are entered, so an unchanged tree costs one request.
+ *
+ * csync does the real discovery itself and can not be handed a tree. What
+ * it can be told is to fetch the whole tree with one recursive PROPFIND
+ * instead of one request per directory, which pays off when many
+ * directories changed. The result is only used while the root etag is the
+ * one the folder knows, otherwise the server changed in the meantime.
+ */
+class RemoteDiscoveryPrefetcher : public QObject
+{
+    Q_OBJECT
+public:
+    enum Result { Unknown, FewChanges, ManyChanges };
+
+    explicit RemoteDiscoveryPrefetcher(QObject *parent = 0);
+
+    /** Starts the discovery of the folder, unless it is running or done already. */
+    void prefetch(Folder *folder);
+
+    /** The result for the folder if it was made for the etag, and forgets it. */
+    Result takeResult(const QString &alias, const QString &etag);
+
+private slots:
+    void slotDirectoriesRetreived(const QString &etag, const QHash<QString, QString> &directoryEtags);
+    void slotNetworkError();
+
+private:
+    struct Discovery {
+        Discovery() : id(0), requests(0), running(0), changed(0), done(false) {}
+        int                     id;
+        QString                 secondPath;
+        QString                 rootEtag;
+        QHash<QString, QString> journalEtags; // directory -> etag
+        QQueue<QString>         pending;      // changed directories to enter
+        int                     requests;
+        int                     running;
+        int                     changed;
+        bool                    done;
+    };
+
+    struct Job {
+        QString alias;
+        QString directory;
+        int     discoveryId; // results of a discovery that was taken are dropped
+    };
+
+    static bool loadJournal(const QString &journalFile, QHash<QString, QString> *etags);
+    void startRequests();
+    Discovery *finishRequest(QObject *job, QString *directory);
+
+    QHash<QString, Discovery> _discoveries; // alias ->
+    QHash<QObject *, Job>     _jobs;
+    int _running;
+    int _nextId;
+};
+
+}
+
+#endif // MIRALL_REMOTEDISCOVERYPREFETCHER_H
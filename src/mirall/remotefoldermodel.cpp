@@ -0,0 +1,385 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/remotefoldermodel.h"
+#include "mirall/owncloudinfo.h"
+#include "mirall/theme.h"
+#include "mirall/listingconcurrency.h"
+
+#include <QDebug>
+#include <QFileIconProvider>
+#include <QIcon>
+#include <QMap>
+
+// children of an expanded directory that get listed ahead
+#define PREFETCH_LIMIT 20
+
+namespace Mirall {
+
+QHash<QString, QHash<QString, RemoteFolderModel::Listing> > RemoteFolderModel::_cache;
+
+RemoteFolderModel::RemoteFolderModel(QObject *parent)
+    : QAbstractItemModel(parent),
+      _root(new Node(QString::null, QString::null, 0)),
+      _accountUrl(ownCloudInfo::instance()->webdavUrl()),
+      _running(0)
+{
+    _account = new Node(Theme::instance()->appNameGUI(), QLatin1String("/"), _root);
+    _root->children.append(_account);
+    _root->childByName.insert(_account->name, _account);
+    _root->listed = true;
+}
+
+RemoteFolderModel::~RemoteFolderModel()
+{
+    delete _root;
+}
+
+QModelIndex RemoteFolderModel::index(int row, int column, const QModelIndex &parent) const
+{
+    Node *parentNode = nodeForIndex(parent);
+    if (column != 0 || row < 0 || row >= parentNode->children.size()) {
+        return QModelIndex();
+    }
+    return createIndex(row, 0, parentNode->children.at(row));
+}
+
+QModelIndex RemoteFolderModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid()) {
+        return QModelIndex();
+    }
+    Node *node = nodeForIndex(child);
+    if (node->parent == _root) {
+        return QModelIndex();
+    }
+    return createIndex(node->parent->row, 0, node->parent);
+}
+
+int RemoteFolderModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) {
+        return 0;
+    }
+    return nodeForIndex(parent)->children.size();
+}
+
+int RemoteFolderModel::columnCount(const QModelIndex &) const
+{
+    return 1;
+}
+
+QVariant RemoteFolderModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return QVariant();
+    }
+    Node *node = nodeForIndex(index);
+
+    switch (role) {
+    case Qt::DisplayRole:
+        return node->name;
+    case Qt::DecorationRole:
+        if (node == _account) {
+            return Theme::instance()->applicationIcon();
+        }
+        if (_folderIcon.isNull()) {
+            _folderIcon = QFileIconProvider().icon(QFileIconProvider::Folder);
+        }
+        return _folderIcon;
+    case Qt::ToolTipRole:
+        if (node == _account) {
+            return tr("Choose this to sync the entire account");
+        }
+        return node->path;
+    case Qt::UserRole:
+        return node->path;
+    default:
+        return QVariant();
+    }
+}
+
+bool RemoteFolderModel::hasChildren(const QModelIndex &parent) const
+{
+    Node *node = nodeForIndex(parent);
+    // until it is listed, every directory might have children.
+    return !node->listed || !node->children.isEmpty();
+}
+
+bool RemoteFolderModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) {
+        return false;
+    }
+    Node *node = nodeForIndex(parent);
+    return !node->fetching && (!node->listed || !node->childrenPrefetched);
+}
+
+void RemoteFolderModel::fetchMore(const QModelIndex &parent)
+{
+    if (!parent.isValid()) {
+        return;
+    }
+    Node *node = nodeForIndex(parent);
+    if (node->listed && !node->childrenPrefetched) {
+        // was listed ahead, now it is expanded: go on with the next level.
+        prefetchChildren(node);
+        return;
+    }
+    fetch(node, false);
+}
+
+QModelIndex RemoteFolderModel::accountIndex() const
+{
+    return createIndex(0, 0, _account);
+}
+
+QString RemoteFolderModel::path(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return QString::null;
+    }
+    return nodeForIndex(index)->path;
+}
+
+void RemoteFolderModel::refresh()
+{
+    fetch(_account, false);
+}
+
+RemoteFolderModel::Node *RemoteFolderModel::nodeForIndex(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return _root;
+    }
+    return static_cast<Node*>(index.internalPointer());
+}
+
+QModelIndex RemoteFolderModel::indexForNode(Node *node) const
+{
+    if (node == _root) {
+        return QModelIndex();
+    }
+    return createIndex(node->row, 0, node);
+}
+
+RemoteFolderModel::Node *RemoteFolderModel::nodeForPath(const QString &path) const
+{
+    Node *node = _account;
+    if (path == QLatin1String("/")) {
+        return node;
+    }
+    foreach (const QString &name, path.split(QLatin1Char('/'), QString::SkipEmptyParts)) {
+        node = node->childByName.value(name);
+        if (!node) {
+            return 0;
+        }
+    }
+    return node;
+}
+
+void RemoteFolderModel::fetch(Node *node, bool prefetch)
+{
+    if (node->fetching) {
+        if (!prefetch && _prefetchOnly.value(node->path)) {
+            // the user waits for it now.
+            _prefetchOnly[node->path] = false;
+            if (_queue.removeOne(node->path)) {
+                _queue.prepend(node->path);
+            }
+        }
+        return;
+    }
+
+    // the account has no etag from a parent, it is always listed.
+    if (node != _account && !node->etag.isEmpty()) {
+        if (node->listed && node->listedEtag == node->etag) {
+            if (!prefetch && !node->childrenPrefetched) {
+                prefetchChildren(node);
+            }
+            return;
+        }
+        const QHash<QString, Listing> &cache = _cache[_accountUrl];
+        QHash<QString, Listing>::const_iterator cached = cache.constFind(node->path);
+        if (cached != cache.constEnd() && cached->etag == node->etag) {
+            applyListing(node, cached->directories, !prefetch);
+            node->listedEtag = node->etag;
+            return;
+        }
+    }
+
+    node->fetching = true;
+    _prefetchOnly.insert(node->path, prefetch);
+    if (prefetch) {
+        _queue.append(node->path);
+    } else {
+        _queue.prepend(node->path);
+    }
+    startFetches();
+}
+
+void RemoteFolderModel::startFetches()
+{
+    // as many listings at the same time as the server takes
+    while (_running < ListingConcurrency::instance()->level() && !_queue.isEmpty()) {
+        const QString path = _queue.takeFirst();
+        RequestDirectoryEtagsJob *job = new RequestDirectoryEtagsJob(path, this);
+        connect(job, SIGNAL(directoriesRetreived(QString,QHash<QString,QString>)),
+                SLOT(slotDirectoriesRetreived(QString,QHash<QString,QString>)));
+        connect(job, SIGNAL(networkError()), SLOT(slotListingFailed()));
+        _jobs.insert(job, path);
+        _running++;
+    }
+}
+
+void RemoteFolderModel::slotDirectoriesRetreived(const QString &, const QHash<QString, QString> &directoryEtags)
+{
+    const QString path = _jobs.take(sender());
+    const bool prefetch = _prefetchOnly.take(path);
+    _running--;
+
+    Node *node = nodeForPath(path);
+    if (node) {
+        node->fetching = false;
+        applyListing(node, directoryEtags, !prefetch);
+        node->listedEtag = node->etag;
+        if (!node->etag.isEmpty()) {
+            Listing listing;
+            listing.etag = node->etag;
+            listing.directories = directoryEtags;
+            _cache[_accountUrl].insert(path, listing);
+        }
+    }
+    startFetches();
+}
+
+void RemoteFolderModel::slotListingFailed()
+{
+    const QString path = _jobs.take(sender());
+    _prefetchOnly.remove(path);
+    _running--;
+
+    qDebug() << "Listing of remote folder" << path << "failed.";
+    Node *node = nodeForPath(path);
+    if (node) {
+        // stays unlisted, expanding it again retries.
+        node->fetching = false;
+    }
+    startFetches();
+}
+
+void RemoteFolderModel::applyListing(Node *node, const QHash<QString, QString> &directories, bool prefetchNextLevel)
+{
+    const QModelIndex parentIndex = indexForNode(node);
+
+    // directories that are gone
+    for (int i = node->children.size() - 1; i >= 0; --i) {
+        Node *child = node->children.at(i);
+        if (directories.contains(child->name)) {
+            continue;
+        }
+        beginRemoveRows(parentIndex, i, i);
+        node->children.removeAt(i);
+        node->childByName.remove(child->name);
+        for (int j = i; j < node->children.size(); ++j) {
+            node->children.at(j)->row = j;
+        }
+        endRemoveRows();
+        delete child;
+    }
+
+    // changed and new ones
+    QStringList newNames;
+    QHashIterator<QString, QString> it(directories);
+    while (it.hasNext()) {
+        it.next();
+        Node *child = node->childByName.value(it.key());
+        if (!child) {
+            newNames.append(it.key());
+        } else if (child->etag != it.value()) {
+            child->etag = it.value();
+            if (child->listed) {
+                // something changed below, list it again in the background.
+                fetch(child, true);
+            }
+        }
+    }
+
+    const QString prefix = (node == _account) ? QString() : node->path + QLatin1Char('/');
+    if (node->children.isEmpty() && !newNames.isEmpty()) {
+        // the common case, all children at once.
+        QMap<QString, QString> sorted;
+        foreach (const QString &name, newNames) {
+            sorted.insertMulti(name.toLower(), name);
+        }
+        beginInsertRows(parentIndex, 0, newNames.size() - 1);
+        foreach (const QString &name, sorted) {
+            Node *child = new Node(name, prefix + name, node);
+            child->etag = directories.value(name);
+            child->row = node->children.size();
+            node->children.append(child);
+            node->childByName.insert(name, child);
+        }
+        endInsertRows();
+    } else {
+        foreach (const QString &name, newNames) {
+            const int pos = insertPosition(node, name);
+            beginInsertRows(parentIndex, pos, pos);
+            Node *child = new Node(name, prefix + name, node);
+            child->etag = directories.value(name);
+            node->children.insert(pos, child);
+            node->childByName.insert(name, child);
+            for (int j = pos; j < node->children.size(); ++j) {
+                node->children.at(j)->row = j;
+            }
+            endInsertRows();
+        }
+    }
+
+    const bool wasListed = node->listed;
+    node->listed = true;
+    if (!wasListed) {
+        // the expand indicator might change.
+        emit dataChanged(parentIndex, parentIndex);
+    }
+
+    if (prefetchNextLevel) {
+        prefetchChildren(node);
+    }
+}
+
+void RemoteFolderModel::prefetchChildren(Node *node)
+{
+    node->childrenPrefetched = true;
+    for (int i = 0; i < node->children.size() && i < PREFETCH_LIMIT; ++i) {
+        fetch(node->children.at(i), true);
+    }
+}
+
+int RemoteFolderModel::insertPosition(Node *parent, const QString &name) const
+{
+    int low = 0;
+    int high = parent->children.size();
+    while (low < high) {
+        const int mid = (low + high) / 2;
+        if (QString::compare(parent->children.at(mid)->name, name, Qt::CaseInsensitive) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+}
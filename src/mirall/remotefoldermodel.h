@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_REMOTEFOLDERMODEL_H
+#define MIRALL_REMOTEFOLDERMODEL_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QIcon>
+#include <QStringList>
+
+namespace Mirall {
+
+/**
+ * @brief Lazy tree model of the directories on the server.
+ *
+ * The children of a directory are listed when the view expands it, and the
+ * children of an expanded directory are listed one level ahead in the
+ * background. Listings are cached together with the etag of the directory,
+ * a cached listing is used again as long as the etag reported by the parent
+ * listing did not change. The cache is shared by all models of the same
+ * account.
+ *
+ * The Qt::UserRole of an index is the remote path, "/" for the account.
+ */
+class RemoteFolderModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    explicit RemoteFolderModel(QObject *parent = 0);
+    ~RemoteFolderModel();
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    QModelIndex parent(const QModelIndex &child) const;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
+
+    /** the index of the account, the only top level item */
+    QModelIndex accountIndex() const;
+
+    QString path(const QModelIndex &index) const;
+
+public slots:
+    /**
+     * Lists the account again. Directories whose etag changed meanwhile
+     * are listed again as well if they were listed before.
+     */
+    void refresh();
+
+private slots:
+    void slotDirectoriesRetreived(const QString &etag, const QHash<QString, QString> &directoryEtags);
+    void slotListingFailed();
+
+private:
+    struct Node {
+        Node(const QString &n, const QString &p, Node *parentNode)
+            : name(n), path(p), parent(parentNode), row(0),
+              listed(false), childrenPrefetched(false), fetching(false) {}
+        ~Node() { qDeleteAll(children); }
+
+        QString name;
+        QString path;
+        QString etag;       // as reported by the listing of the parent
+        QString listedEtag; // etag at the time the children were listed
+        Node *parent;
+        int row;
+        QList<Node*> children; // sorted by name
+        QHash<QString, Node*> childByName;
+        bool listed;
+        bool childrenPrefetched;
+        bool fetching;
+    };
+
+    struct Listing {
+        QString etag;
+        QHash<QString, QString> directories;
+    };
+
+    Node *nodeForIndex(const QModelIndex &index) const;
+    QModelIndex indexForNode(Node *node) const;
+    Node *nodeForPath(const QString &path) const;
+
+    void fetch(Node *node, bool prefetch);
+    void startFetches();
+    // prefetchNextLevel: list the children of the children ahead
+    void applyListing(Node *node, const QHash<QString, QString> &directories, bool prefetchNextLevel);
+    void prefetchChildren(Node *node);
+    int insertPosition(Node *parent, const QString &name) const;
+
+    Node *_root; // invisible, holds the account node
+    Node *_account;
+    QString _accountUrl;
+    mutable QIcon _folderIcon;
+    QHash<QObject*, QString> _jobs; // listing job -> path
+    QStringList _queue;             // paths to list, user requests first
+    QHash<QString, bool> _prefetchOnly;
+    int _running;
+
+    // by account url, then by path
+    static QHash<QString, QHash<QString, Listing> > _cache;
+};
+
+}
+
+#endif // MIRALL_REMOTEFOLDERMODEL_H
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/resourcegovernor.h"
+#include "mirall/mirallconfigfile.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QThread>
+
+#ifdef Q_OS_LINUX
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+// glibc has no wrapper for ioprio_set, see linux/ioprio.h
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_BE    2
+#define IOPRIO_CLASS_IDLE  3
+#define IOPRIO_WHO_PROCESS 1
+#endif
+#ifndef Q_OS_WIN
+#include <cstdlib>
+#endif
+
+#define STATE_CHECK_INTERVAL_MSEC 30000
+
+namespace Mirall {
+
+ResourceGovernor* ResourceGovernor::_instance = 0;
+
+ResourceGovernor* ResourceGovernor::instance()
+{
+    if (!_instance) {
+        _instance = new ResourceGovernor();
+    }
+    return _instance;
+}
+
+ResourceGovernor::ResourceGovernor(QObject *parent)
+    : QObject(parent),
+      _runningDiskJobs(0),
+      _constrained(false),
+      _ioIdle(true),
+      _niceLevel(0),
+      _maxDiskJobs(1)
+{
+    QMutexLocker locker(&_mutex);
+    updateState();
+}
+
+void ResourceGovernor::updateState()
+{
+    if (_lastCheck.isValid() && _lastCheck.elapsed() < STATE_CHECK_INTERVAL_MSEC) {
+        return;
+    }
+    _lastCheck.start();
+
+    MirallConfigFile cfg;
+    QString reason;
+    if (cfg.governorThrottleOnBattery() && onBattery()) {
+        reason = QLatin1String("on battery");
+    } else if (highLoad(cfg.governorLoadThreshold())) {
+        reason = QLatin1String("high system load");
+    }
+
+    const bool constrained = !reason.isEmpty();
+    bool ioIdle = cfg.governorIoIdle();
+    int niceLevel = cfg.governorNiceLevel();
+    int maxDiskJobs = cfg.governorMaxDiskJobs();
+    if (constrained) {
+        ioIdle = true;
+        niceLevel = 19;
+        maxDiskJobs = 1;
+    }
+
+    const bool changed = constrained != _constrained || reason != _reason
+            || ioIdle != _ioIdle || niceLevel != _niceLevel || maxDiskJobs != _maxDiskJobs;
+    _constrained = constrained;
+    _reason = reason;
+    _ioIdle = ioIdle;
+    _niceLevel = niceLevel;
+    if (maxDiskJobs > _maxDiskJobs) {
+        _slotFreed.wakeAll();
+    }
+    _maxDiskJobs = maxDiskJobs;
+
+    if (changed) {
+        qDebug() << "* Resource limits:" << descriptionLocked();
+    }
+}
+
+void ResourceGovernor::applyToCurrentThread()
+{
+    bool ioIdle;
+    int niceLevel;
+    {
+        QMutexLocker locker(&_mutex);
+        updateState();
+        ioIdle = _ioIdle;
+        niceLevel = _niceLevel;
+    }
+
+#ifdef Q_OS_LINUX
+    // on Linux both calls work on the thread if given its tid.
+    const pid_t tid = syscall(SYS_gettid);
+    const int ioprio = ioIdle ? (IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT)
+                              : (IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | 7;
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, ioprio) == -1) {
+        qDebug() << "WRN: ioprio_set failed:" << strerror(errno);
+    }
+    // lowering the nice value again needs privileges, so going back from
+    // constrained mode only works for new threads.
+    if (setpriority(PRIO_PROCESS, tid, niceLevel) == -1) {
+        qDebug() << "WRN: setpriority to" << niceLevel << "failed:" << strerror(errno);
+    }
+#else
+    Q_UNUSED(ioIdle);
+    QThread::currentThread()->setPriority(niceLevel > 10 ? QThread::LowestPriority
+                                                         : QThread::LowPriority);
+#endif
+}
+
+void ResourceGovernor::acquireDiskSlot()
+{
+    QMutexLocker locker(&_mutex);
+    updateState();
+    while (_runningDiskJobs >= _maxDiskJobs) {
+        _slotFreed.wait(&_mutex);
+    }
+    _runningDiskJobs++;
+}
+
+void ResourceGovernor::releaseDiskSlot()
+{
+    QMutexLocker locker(&_mutex);
+    _runningDiskJobs--;
+    _slotFreed.wakeOne();
+}
+
+QString ResourceGovernor::description()
+{
+    QMutexLocker locker(&_mutex);
+    updateState();
+    return descriptionLocked();
+}
+
+QString ResourceGovernor::descriptionLocked() const
+{
+    QString desc = QString::fromLatin1("nice %1, %2 I/O, %3 disk job(s)")
+            .arg(_niceLevel)
+            .arg(_ioIdle ? QLatin1String("idle") : QLatin1String("best effort"))
+            .arg(_maxDiskJobs);
+    if (_constrained) {
+        desc += QLatin1String(", constrained: ") + _reason;
+    }
+    return desc;
+}
+
+bool ResourceGovernor::onBattery()
+{
+#ifdef Q_OS_LINUX
+    QDir supplies(QLatin1String("/sys/class/power_supply"));
+    bool hasMains = false;
+    bool discharging = false;
+    foreach (const QString& name, supplies.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QFile typeFile(supplies.filePath(name + QLatin1String("/type")));
+        if (!typeFile.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        const QByteArray type = typeFile.readAll().trimmed();
+        if (type == "Mains") {
+            hasMains = true;
+            QFile onlineFile(supplies.filePath(name + QLatin1String("/online")));
+            if (onlineFile.open(QIODevice::ReadOnly) && onlineFile.readAll().trimmed() == "1") {
+                return false;
+            }
+        } else if (type == "Battery") {
+            // batteries of peripherals like a wireless mouse have the
+            // scope "Device", they say nothing about the system power.
+            QFile scopeFile(supplies.filePath(name + QLatin1String("/scope")));
+            if (scopeFile.open(QIODevice::ReadOnly) && scopeFile.readAll().trimmed() == "Device") {
+                continue;
+            }
+            QFile statusFile(supplies.filePath(name + QLatin1String("/status")));
+            if (statusFile.open(QIODevice::ReadOnly) && statusFile.readAll().trimmed() == "Discharging") {
+                discharging = true;
+            }
+        }
+    }
+    return hasMains || discharging;
+#else
+    return false;
+#endif
+}
+
+bool ResourceGovernor::highLoad(double threshold)
+{
+#ifndef Q_OS_WIN
+    if (threshold <= 0) {
+        return false;
+    }
+    double load[1];
+    if (getloadavg(load, 1) != 1) {
+        return false;
+    }
+    int cores = QThread::idealThreadCount();
+    if (cores < 1) cores = 1;
+    return load[0] / cores > threshold;
+#else
+    Q_UNUSED(threshold);
+    return false;
+#endif
+}
+
+}
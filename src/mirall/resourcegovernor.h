@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_RESOURCEGOVERNOR_H
+#define MIRALL_RESOURCEGOVERNOR_H
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+
+namespace Mirall {
+
+/**
+ * @brief Keeps the sync threads from getting in the way of interactive work.
+ *
+ * Worker threads call applyToCurrentThread() to get the idle I/O class and
+ * the configured nice level (Linux only). The local discovery, the checksum
+ * and conflict comparisons of the propagator run inside a DiskJobLocker,
+ * which limits how many of them run at the same time. Downloads take a slot
+ * for each block they write, so they do not hold one while waiting for the
+ * network. Upload reads happen inside httpbf while the chunk is sent and
+ * are only covered by the I/O class.
+ *
+ * On battery or if the load average per core is above the configured
+ * threshold, the governor switches to constrained mode: nice 19, idle I/O
+ * and a single disk job. The system state is checked again at most every
+ * 30 seconds, when a thread asks for a slot.
+ *
+ * All methods are thread safe.
+ */
+class ResourceGovernor : public QObject
+{
+    Q_OBJECT
+public:
+    static ResourceGovernor* instance();
+
+    void applyToCurrentThread();
+
+    void acquireDiskSlot();
+    void releaseDiskSlot();
+
+    /** human readable summary of the current limits, for logs and the gui */
+    QString description();
+
+private:
+    explicit ResourceGovernor(QObject *parent = 0);
+    void updateState(); // needs _mutex
+    QString descriptionLocked() const;
+
+    static bool onBattery();
+    static bool highLoad(double threshold);
+
+    QMutex         _mutex;
+    QWaitCondition _slotFreed;
+    QElapsedTimer  _lastCheck;
+    int            _runningDiskJobs;
+
+    bool    _constrained;
+    QString _reason;
+    bool    _ioIdle;
+    int     _niceLevel;
+    int     _maxDiskJobs;
+
+    static ResourceGovernor* _instance;
+};
+
+/**
+ * Holds a disk job slot of the ResourceGovernor for its lifetime.
+ */
+class DiskJobLocker
+{
+public:
+    DiskJobLocker() {
+        ResourceGovernor::instance()->applyToCurrentThread();
+        ResourceGovernor::instance()->acquireDiskSlot();
+    }
+    ~DiskJobLocker() {
+        ResourceGovernor::instance()->releaseDiskSlot();
+    }
+};
+
+}
+
+#endif // MIRALL_RESOURCEGOVERNOR_H
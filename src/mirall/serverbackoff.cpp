@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/serverbackoff.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadStorage>
+#include <QUrl>
+
+#include <neon/ne_dates.h>
+
+#include <stdlib.h>
+#include <time.h>
+
+namespace Mirall {
+
+// first backoff window without a Retry-After header
+static const qint64 initialBackoffMsec = 2000;
+// the exponential backoff does not grow beyond this
+static const qint64 maxBackoffMsec = 10 * 60 * 1000;
+// a Retry-After beyond this is not believed
+static const int maxRetryAfterSecs = 60 * 60;
+
+// qrand() is seeded per thread. Without a seed of its own the sync thread
+// of every client starts the same sequence and the jitter is no jitter.
+static int jitterRand()
+{
+    static QThreadStorage<bool *> seeded;
+    if( !seeded.hasLocalData() ) {
+        seeded.setLocalData(new bool(true));
+        qsrand(uint(time(0)) ^ uint(QCoreApplication::applicationPid())
+               ^ uint(quintptr(QThread::currentThreadId())));
+    }
+    return qrand();
+}
+
+ServerBackoff::ServerBackoff()
+{
+}
+
+ServerBackoff *ServerBackoff::instance()
+{
+    // the sync thread and the main thread both use it, a function local
+    // static is initialized only once.
+    static ServerBackoff backoff;
+    return &backoff;
+}
+
+QString ServerBackoff::serverKey(const QUrl& url)
+{
+    // two instances on one host are different servers
+    const QString scheme = url.scheme().toLower();
+    const bool tls = scheme == QLatin1String("https") || scheme == QLatin1String("ownclouds");
+    return url.host().toLower() + QLatin1Char(':') + QString::number(url.port(tls ? 443 : 80));
+}
+
+bool ServerBackoff::isBusyStatus(int httpStatus)
+{
+    return httpStatus == 503 || httpStatus == 429;
+}
+
+qint64 ServerBackoff::remaining(const QString& server)
+{
+    QMutexLocker lock(&_mutex);
+    QHash<QString, State>::const_iterator it = _states.constFind(server);
+    if( it == _states.constEnd() ) {
+        return 0;
+    }
+    return qMax(qint64(0), it->until - QDateTime::currentMSecsSinceEpoch());
+}
+
+void ServerBackoff::reportBusy(const QString& server, int retryAfter)
+{
+    QMutexLocker lock(&_mutex);
+    State& state = _states[server];
+    state.busyCount++;
+
+    qint64 window;
+    if( retryAfter >= 0 ) {
+        window = qint64(qMin(retryAfter, maxRetryAfterSecs)) * 1000;
+    } else {
+        // 2s, 4s, 8s... with +-25% jitter
+        window = initialBackoffMsec << qMin(state.busyCount - 1, 16);
+        window = qMin(window, maxBackoffMsec);
+        window += (window / 2) * (jitterRand() % 1000) / 1000 - window / 4;
+    }
+
+    // a later busy reply must not shorten a longer window.
+    const qint64 until = QDateTime::currentMSecsSinceEpoch() + window;
+    if( until > state.until ) {
+        state.until = until;
+    }
+    qDebug() << "Server" << server << "is busy (" << state.busyCount << "in a row), backing off for"
+             << window << "ms";
+}
+
+void ServerBackoff::reportSuccess(const QString& server)
+{
+    QMutexLocker lock(&_mutex);
+    _states.remove(server);
+}
+
+int ServerBackoff::parseRetryAfter(const QByteArray& value)
+{
+    const QByteArray v = value.trimmed();
+    if( v.isEmpty() ) {
+        return -1;
+    }
+
+    bool ok;
+    const int secs = v.toInt(&ok);
+    if( ok ) {
+        return secs >= 0 ? secs : -1;
+    }
+
+    const time_t date = ne_httpdate_parse(v.constData());
+    if( date == time_t(-1) ) {
+        return -1;
+    }
+    return qMax(0, int(date - time(0)));
+}
+
+}
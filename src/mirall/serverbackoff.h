@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_SERVERBACKOFF_H
+#define MIRALL_SERVERBACKOFF_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QByteArray>
+
+class QUrl;
+
+namespace Mirall {
+
+/**
+ * @brief Per server backoff state after "server busy" replies.
+ *
+ * When a server answers 503 (or 429), nothing should be sent to it until
+ * the window has passed. The window is taken from the Retry-After header
+ * if there is one, otherwise it grows exponentially with the number of
+ * busy replies in a row, with some jitter so that not all clients come
+ * back at the same time.
+ *
+ * Shared by the propagator (sync thread), the etag polling and
+ * ownCloudInfo (main thread), hence the mutex.
+ */
+class ServerBackoff
+{
+public:
+    static ServerBackoff *instance();
+
+    /** the key the state of a server is kept under, host:port */
+    static QString serverKey(const QUrl& url);
+
+    /** msec until requests to the server may be sent again, 0 if now. */
+    qint64 remaining(const QString& server);
+
+    /**
+     * The server replied busy.
+     * @param retryAfter seconds from the Retry-After header, -1 if there was none
+     */
+    void reportBusy(const QString& server, int retryAfter = -1);
+
+    /** A request went through, the next busy reply starts from scratch. */
+    void reportSuccess(const QString& server);
+
+    /**
+     * Parses a Retry-After value, delta seconds or an HTTP date.
+     * @return seconds from now, -1 if it could not be parsed.
+     */
+    static int parseRetryAfter(const QByteArray& value);
+
+    /** HTTP status codes that mean the server is overloaded. */
+    static bool isBusyStatus(int httpStatus);
+
+private:
+    ServerBackoff();
+
+    struct State {
+        State() : busyCount(0), until(0) {}
+        int    busyCount;
+        qint64 until; // msec since epoch
+    };
+
+    QMutex _mutex;
+    QHash<QString, State> _states;
+};
+
+}
+
+#endif // MIRALL_SERVERBACKOFF_H
@@ -81,6 +81,7 @@ public:
     time_t               _modtime;
     QByteArray           _etag;
     quint64              _size;
+    QString              _moveSource; // remote path when moved here from another folder
 
     // Variables usefull to report to the user
     Status              _status;
@@ -22,6 +22,8 @@
 
 #include "syncjournaldb.h"
 #include "syncjournalfilerecord.h"
+#include "syncfileitem.h"
+#include "allocstats.h"
 
 #define QSQLITE "QSQLITE"
 
@@ -38,6 +40,11 @@ SyncJournalDb::SyncJournalDb(const QString& path, QObject *parent) :
     _dbFile.append(".csync_journal.db");
 }
 
+QString SyncJournalDb::databaseFilePath()
+{
+    return _dbFile;
+}
+
 bool SyncJournalDb::exists()
 {
     QMutexLocker locker(&_mutex);
@@ -140,6 +147,32 @@ bool SyncJournalDb::updateDatabaseStructure()
         QSqlQuery indx("CREATE INDEX metadata_file_id ON metadata(fileid);", _db);
         indx.exec();
     }
+
+    // the file size lets a cheap stat pass tell modified files apart
+    // without hashing or asking csync.
+    if( columns.indexOf(QLatin1String("filesize")) == -1 ) {
+        QSqlQuery addFileSizeColQuery("ALTER TABLE metadata ADD COLUMN filesize BIGINT;", _db);
+        addFileSizeColQuery.exec();
+    }
+
+    // totals per directory, see getDirectoryRollup. Journals of older
+    // clients get them computed once from their records.
+    if( tableColumns("dirrollup").isEmpty() ) {
+        QSqlQuery createQuery("CREATE TABLE IF NOT EXISTS dirrollup("
+                              "phash INTEGER(8),"
+                              "path VARCHAR(4096),"
+                              "size INTEGER(8),"
+                              "files INTEGER,"
+                              "newest INTEGER(8),"
+                              "errors INTEGER,"
+                              "PRIMARY KEY(phash)"
+                              ");" , _db);
+        if( !createQuery.exec() ) {
+            qWarning() << "Error creating table dirrollup : " << createQuery.lastError().text();
+            return false;
+        }
+        return rebuildDirectoryRollups();
+    }
     return true;
 }
 
@@ -167,7 +200,7 @@ QStringList SyncJournalDb::tableColumns( const QString& table )
     return columns;
 }
 
-qint64 SyncJournalDb::getPHash(const QString& file) const
+qint64 SyncJournalDb::getPHash(const QString& file)
 {
     QByteArray utf8File = file.toUtf8();
     int64_t h;
@@ -182,86 +215,374 @@ qint64 SyncJournalDb::getPHash(const QString& file) const
     return h;
 }
 
-bool SyncJournalDb::setFileRecord( const SyncJournalFileRecord& record )
+// the caller holds the mutex and checked the connection
+bool SyncJournalDb::writeFileRecord( const SyncJournalFileRecord& record )
 {
-    QMutexLocker locker(&_mutex);
     qlonglong phash = getPHash(record._path);
 
-    if( checkConnect() ) {
+    // the record that gets replaced leaves the totals first
+    RollupDeltas deltas;
+    if( !addRemovedFiles(deltas, QLatin1String("phash=?"), QString::number(phash)) ) {
+        return false;
+    }
+
+    QSqlQuery writeQuery( "INSERT OR REPLACE INTO metadata "
+                          "(phash, pathlen, path, inode, uid, gid, mode, modtime, type, md5, fileid, filesize) "
+                          "VALUES ( ? , ?, ? , ? , ? , ? , ?,  ? , ? , ?, ?, ? )", _db );
+
+    QByteArray arr = record._path.toUtf8();
+    int plen = arr.length();
+
+    writeQuery.bindValue(0, QString::number(phash));
+    writeQuery.bindValue(1, plen);
+    writeQuery.bindValue(2, record._path );
+    writeQuery.bindValue(3, qint64(record._inode) );
+    writeQuery.bindValue(4, record._uid );
+    writeQuery.bindValue(5, record._gid );
+    writeQuery.bindValue(6, record._mode );
+    writeQuery.bindValue(7, QString::number(record._modtime.toTime_t()));
+    writeQuery.bindValue(8, QString::number(record._type) );
+    writeQuery.bindValue(9, record._etag );
+    writeQuery.bindValue(10, record._fileId );
+    writeQuery.bindValue(11, record._fileSize );
+
+    if( !writeQuery.exec() ) {
+        qWarning() << "Exec error of SQL statement: " << writeQuery.lastQuery() <<  " :"
+                   << writeQuery.lastError().text();
+        return false;
+    }
 
-        QSqlQuery writeQuery( "INSERT OR REPLACE INTO metadata "
-                              "(phash, pathlen, path, inode, uid, gid, mode, modtime, type, md5, fileid) "
-                              "VALUES ( ? , ?, ? , ? , ? , ? , ?,  ? , ? , ?, ? )", _db );
-
-        QByteArray arr = record._path.toUtf8();
-        int plen = arr.length();
-
-        writeQuery.bindValue(0, QString::number(phash));
-        writeQuery.bindValue(1, plen);
-        writeQuery.bindValue(2, record._path );
-        writeQuery.bindValue(3, record._inode );
-        writeQuery.bindValue(4, record._uid );
-        writeQuery.bindValue(5, record._gid );
-        writeQuery.bindValue(6, record._mode );
-        writeQuery.bindValue(7, QString::number(record._modtime.toTime_t()));
-        writeQuery.bindValue(8, QString::number(record._type) );
-        writeQuery.bindValue(9, record._etag );
-        writeQuery.bindValue(10, record._fileId );
+    qDebug() <<  writeQuery.lastQuery() << phash << plen << record._path << record._inode
+             << record._uid << record._gid << record._mode
+             << QString::number(record._modtime.toTime_t()) << QString::number(record._type)
+             << record._etag << record._fileId << record._fileSize;
+
+    if( record._type != SyncFileItem::Directory ) {
+        RollupDelta added;
+        added._size = record._fileSize;
+        added._fileCount = 1;
+        added._addedModtime = record._modtime.toTime_t();
+        addRollupDelta(deltas, record._path, added);
+    }
+    return applyRollupDeltas(deltas);
+}
 
-        if( !writeQuery.exec() ) {
-            qWarning() << "Exec error of SQL statement: " << writeQuery.lastQuery() <<  " :"
-                       << writeQuery.lastError().text();
+bool SyncJournalDb::setFileRecord( const SyncJournalFileRecord& record )
+{
+    // the record and the totals above it change together
+    return setFileRecords(QList<SyncJournalFileRecord>() << record);
+}
+
+bool SyncJournalDb::setFileRecords( const QList<SyncJournalFileRecord>& records )
+{
+    AllocScope allocScope(AllocStats::JournalPhase);
+    QMutexLocker locker(&_mutex);
+
+    if( !checkConnect() ) {
+        qDebug() << "Failed to connect database.";
+        return false;
+    }
+
+    if( !_db.transaction() ) {
+        qWarning() << "Failed to start a transaction:" << _db.lastError().text();
+        return false;
+    }
+    foreach( const SyncJournalFileRecord& record, records ) {
+        if( !writeFileRecord(record) ) {
+            _db.rollback();
             return false;
         }
+    }
+    if( !_db.commit() ) {
+        qWarning() << "Failed to commit the file records:" << _db.lastError().text();
+        _db.rollback();
+        return false;
+    }
+    return true;
+}
 
-        qDebug() <<  writeQuery.lastQuery() << phash << plen << record._path << record._inode
-                 << record._uid << record._gid << record._mode
-                 << QString::number(record._modtime.toTime_t()) << QString::number(record._type)
-                 << record._etag << record._fileId;
+bool SyncJournalDb::deleteFileRecord(const QString& filename, bool recursively)
+{
+    AllocScope allocScope(AllocStats::JournalPhase);
+    QMutexLocker locker(&_mutex);
 
-        return true;
-    } else {
+    if( !checkConnect() ) {
         qDebug() << "Failed to connect database.";
         return false; // checkConnect failed.
     }
+
+    QString where;
+    QString bound;
+    if (recursively) {
+        where = QLatin1String("phash=?");
+        bound = QString::number(getPHash(filename));
+    } else {
+        where = QLatin1String("path LIKE(?||'/%')");
+        bound = filename;
+    }
+
+    if( !_db.transaction() ) {
+        qWarning() << "Failed to start a transaction:" << _db.lastError().text();
+        return false;
+    }
+    RollupDeltas deltas;
+    if( !addRemovedFiles(deltas, where, bound) ) {
+        _db.rollback();
+        return false;
+    }
+
+    QSqlQuery query( QLatin1String("DELETE FROM metadata WHERE ") + where, _db );
+    query.bindValue( 0, bound );
+
+    if( !query.exec() ) {
+        qWarning() << "Exec error of SQL statement: " << query.lastQuery() <<  " : " << query.lastError().text();
+        _db.rollback();
+        return false;
+    }
+    qDebug() <<  query.executedQuery() << bound << filename;
+
+    if( !applyRollupDeltas(deltas) ) {
+        _db.rollback();
+        return false;
+    }
+    if( !_db.commit() ) {
+        qWarning() << "Failed to commit the deletion:" << _db.lastError().text();
+        _db.rollback();
+        return false;
+    }
+    return true;
 }
 
-bool SyncJournalDb::deleteFileRecord(const QString& filename, bool recursively)
+// every directory above path, up to the sync root
+void SyncJournalDb::addRollupDelta( RollupDeltas& deltas, const QString& path, const RollupDelta& delta )
+{
+    QString dir = path;
+    do {
+        const int slash = dir.lastIndexOf(QLatin1Char('/'));
+        dir = slash < 0 ? QString() : dir.left(slash);
+
+        RollupDelta& d = deltas[dir];
+        d._size += delta._size;
+        d._fileCount += delta._fileCount;
+        d._errorCount += delta._errorCount;
+        d._addedModtime = qMax(d._addedModtime, delta._addedModtime);
+        d._removedModtime = qMax(d._removedModtime, delta._removedModtime);
+    } while( !dir.isEmpty() );
+}
+
+// the files matching the condition are about to leave the metadata table
+bool SyncJournalDb::addRemovedFiles( RollupDeltas& deltas, const QString& where, const QString& bound )
+{
+    QSqlQuery query( QLatin1String("SELECT path, modtime, filesize FROM metadata WHERE type!=? AND ") + where, _db );
+    query.bindValue( 0, int(SyncFileItem::Directory) );
+    query.bindValue( 1, bound );
+
+    if( !query.exec() ) {
+        qWarning() << "Exec error of SQL statement: " << query.lastQuery() <<  " : " << query.lastError().text();
+        return false;
+    }
+    while( query.next() ) {
+        RollupDelta removed;
+        removed._size = -query.value(2).toLongLong();
+        removed._fileCount = -1;
+        removed._removedModtime = query.value(1).toLongLong();
+        addRollupDelta(deltas, query.value(0).toString(), removed);
+    }
+    return true;
+}
+
+// a transfer counts as failed while its info has an error count
+bool SyncJournalDb::addTransferErrors( RollupDeltas& deltas, const QString& table, const QString& file, int errorCount )
+{
+    QSqlQuery query( QString::fromLatin1("SELECT errorcount FROM %1 WHERE path=?").arg(table), _db );
+    query.bindValue( 0, file );
+
+    if( !query.exec() ) {
+        qWarning() << "Exec error of SQL statement: " << query.lastQuery() <<  " : " << query.lastError().text();
+        return false;
+    }
+    const bool failed = query.next() && query.value(0).toInt() > 0;
+    if( failed != (errorCount > 0) ) {
+        RollupDelta delta;
+        delta._errorCount = failed ? -1 : 1;
+        addRollupDelta(deltas, file, delta);
+    }
+    return true;
+}
+
+// the caller holds the mutex and changed the metadata already
+bool SyncJournalDb::applyRollupDeltas( const RollupDeltas& deltas )
+{
+    RollupDeltas::const_iterator it = deltas.constBegin();
+    for( ; it != deltas.constEnd(); ++it ) {
+        const QString& dir = it.key();
+        const RollupDelta& delta = it.value();
+        const QString phash = QString::number(getPHash(dir));
+
+        QSqlQuery query( "SELECT size, files, newest, errors FROM dirrollup WHERE phash=?", _db );
+        query.bindValue( 0, phash );
+        if( !query.exec() ) {
+            qWarning() << "Exec error of SQL statement: " << query.lastQuery() <<  " : " << query.lastError().text();
+            return false;
+        }
+        qint64 size = 0;
+        int files = 0;
+        qint64 newest = 0;
+        int errors = 0;
+        if( query.next() ) {
+            size   = query.value(0).toLongLong();
+            files  = query.value(1).toInt();
+            newest = query.value(2).toLongLong();
+            errors = query.value(3).toInt();
+        }
+        query.finish();
+
+        size += delta._size;
+        files += delta._fileCount;
+        errors += delta._errorCount;
+        if( delta._removedModtime > 0 && delta._removedModtime >= newest
+                && delta._addedModtime < delta._removedModtime ) {
+            // the newest file is gone or older now, only then the files are looked at.
+            // A file edited again is at least as new as before and needs no lookup.
+            newest = newestModtimeBelow(dir);
+        } else {
+            newest = qMax(newest, delta._addedModtime);
+        }
+
+        QSqlQuery writeQuery(_db);
+        if( files <= 0 && errors <= 0 ) {
+            writeQuery.prepare( "DELETE FROM dirrollup WHERE phash=?" );
+            writeQuery.bindValue( 0, phash );
+        } else {
+            writeQuery.prepare( "INSERT OR REPLACE INTO dirrollup "
+                                "(phash, path, size, files, newest, errors) "
+                                "VALUES ( ? , ? , ? , ? , ? , ? )" );
+            writeQuery.bindValue( 0, phash );
+            writeQuery.bindValue( 1, dir );
+            writeQuery.bindValue( 2, size );
+            writeQuery.bindValue( 3, files );
+            writeQuery.bindValue( 4, newest );
+            writeQuery.bindValue( 5, errors );
+        }
+        if( !writeQuery.exec() ) {
+            qWarning() << "Exec error of SQL statement: " << writeQuery.lastQuery() <<  " : " << writeQuery.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+qint64 SyncJournalDb::newestModtimeBelow( const QString& dir )
+{
+    QSqlQuery query(_db);
+    if( dir.isEmpty() ) {
+        query.prepare( "SELECT MAX(modtime) FROM metadata WHERE type!=?" );
+    } else {
+        query.prepare( "SELECT MAX(modtime) FROM metadata WHERE type!=? AND path LIKE(?||'/%')" );
+        query.bindValue( 1, dir );
+    }
+    query.bindValue( 0, int(SyncFileItem::Directory) );
+
+    if( !query.exec() || !query.next() ) {
+        return 0;
+    }
+    return query.value(0).toLongLong();
+}
+
+// for journals written before the dirrollup table existed
+bool SyncJournalDb::rebuildDirectoryRollups()
+{
+    RollupDeltas deltas;
+    QSqlQuery files( "SELECT path, modtime, filesize FROM metadata WHERE type!=?", _db );
+    files.bindValue( 0, int(SyncFileItem::Directory) );
+    if( !files.exec() ) {
+        qWarning() << "Exec error of SQL statement: " << files.lastQuery() <<  " : " << files.lastError().text();
+        return false;
+    }
+    while( files.next() ) {
+        RollupDelta added;
+        added._size = files.value(2).toLongLong();
+        added._fileCount = 1;
+        added._addedModtime = files.value(1).toLongLong();
+        addRollupDelta(deltas, files.value(0).toString(), added);
+    }
+    const char *tables[] = { "downloadinfo", "uploadinfo" };
+    for( int i = 0; i < 2; ++i ) {
+        QSqlQuery query( QString::fromLatin1("SELECT path FROM %1 WHERE errorcount>0").arg(QLatin1String(tables[i])), _db );
+        if( !query.exec() ) {
+            qWarning() << "Exec error of SQL statement: " << query.lastQuery() <<  " : " << query.lastError().text();
+            return false;
+        }
+        while( query.next() ) {
+            RollupDelta failed;
+            failed._errorCount = 1;
+            addRollupDelta(deltas, query.value(0).toString(), failed);
+        }
+    }
+
+    if( !_db.transaction() ) {
+        qWarning() << "Failed to start a transaction:" << _db.lastError().text();
+        return false;
+    }
+    if( !applyRollupDeltas(deltas) || !_db.commit() ) {
+        qWarning() << "Failed to compute the directory totals:" << _db.lastError().text();
+        _db.rollback();
+        return false;
+    }
+    qDebug() << "Computed the totals of" << deltas.count() << "directories";
+    return true;
+}
+
+SyncJournalDb::DirectoryRollup SyncJournalDb::getDirectoryRollup( const QString& dir )
 {
+    AllocScope allocScope(AllocStats::JournalPhase);
     QMutexLocker locker(&_mutex);
 
+    DirectoryRollup res;
+
     if( checkConnect() ) {
-        if (recursively) {
-            qlonglong phash = getPHash(filename);
-            QSqlQuery query( "DELETE FROM metadata WHERE phash=?", _db );
-            query.bindValue( 0, QString::number(phash) );
-
-            if( !query.exec() ) {
-                qWarning() << "Exec error of SQL statement: " << query.lastQuery() <<  " : " << query.lastError().text();
-                return false;
-            }
-            qDebug() <<  query.executedQuery() << phash << filename;
-            return true;
-        } else {
-            QSqlQuery query( "DELETE FROM metadata WHERE path LIKE(?||'/%')", _db );
-            query.bindValue( 0, filename );
+        QSqlQuery query( "SELECT size, files, newest, errors FROM dirrollup WHERE phash=?", _db );
+        query.bindValue( 0, QString::number(getPHash(dir)) );
+
+        if( !query.exec() ) {
+            qDebug() << "Database error for directory " << dir << " : " << query.lastQuery() << ", Error:" << query.lastError().text();
+            return res;
+        }
 
-            if( !query.exec() ) {
-                qWarning() << "Exec error of SQL statement: " << query.lastQuery() <<  " : " << query.lastError().text();
-                return false;
+        if( query.next() ) {
+            res._size       = query.value(0).toLongLong();
+            res._fileCount  = query.value(1).toInt();
+            if( res._fileCount > 0 ) {
+                res._newestModtime = QDateTime::fromTime_t(query.value(2).toLongLong());
             }
-            qDebug() <<  query.executedQuery()  << filename;
-            return true;
+            res._errorCount = query.value(3).toInt();
         }
-    } else {
-        qDebug() << "Failed to connect database.";
-        return false; // checkConnect failed.
     }
+    return res;
 }
 
 
+// the columns as selected by getFileRecord
+static SyncJournalFileRecord recordFromQuery( const QSqlQuery& query )
+{
+    SyncJournalFileRecord rec;
+    bool ok;
+    rec._path    = query.value(0).toString();
+    rec._inode   = query.value(1).toULongLong(&ok);
+    rec._uid     = query.value(2).toInt(&ok);
+    rec._gid     = query.value(3).toInt(&ok);
+    rec._mode    = query.value(4).toInt(&ok);
+    rec._modtime = QDateTime::fromTime_t(query.value(5).toLongLong(&ok));
+    rec._type    = query.value(6).toInt(&ok);
+    rec._etag    = query.value(7).toString();
+    rec._fileId  = query.value(8).toString();
+    rec._fileSize = query.value(9).toULongLong(&ok);
+    return rec;
+}
+
 SyncJournalFileRecord SyncJournalDb::getFileRecord( const QString& filename )
 {
+    AllocScope allocScope(AllocStats::JournalPhase);
     QMutexLocker locker(&_mutex);
 
     qlonglong phash = getPHash( filename );
@@ -274,7 +595,7 @@ SyncJournalFileRecord SyncJournalDb::getFileRecord( const QString& filename )
     */
 
     if( checkConnect() ) {
-        QSqlQuery query("SELECT path, inode, uid, gid, mode, modtime, type, md5, fileid FROM "
+        QSqlQuery query("SELECT path, inode, uid, gid, mode, modtime, type, md5, fileid, filesize FROM "
                         "metadata WHERE phash=:ph" ,  _db);
         query.bindValue(":ph", QString::number(phash));
 
@@ -285,16 +606,7 @@ SyncJournalFileRecord SyncJournalDb::getFileRecord( const QString& filename )
         }
 
         if( query.next() ) {
-            bool ok;
-            rec._path    = query.value(0).toString();
-            rec._inode   = query.value(1).toInt(&ok);
-            rec._uid     = query.value(2).toInt(&ok);
-            rec._gid     = query.value(3).toInt(&ok);
-            rec._mode    = query.value(4).toInt(&ok);
-            rec._modtime = QDateTime::fromTime_t(query.value(5).toLongLong(&ok));
-            rec._type    = query.value(6).toInt(&ok);
-            rec._etag    = query.value(7).toString();
-            rec._fileId  = query.value(8).toString();
+            rec = recordFromQuery(query);
         } else {
             QString err = query.lastError().text();
             qDebug() << "Can not query " << query.lastQuery() << ", Error:" << err;
@@ -305,6 +617,7 @@ SyncJournalFileRecord SyncJournalDb::getFileRecord( const QString& filename )
 
 int SyncJournalDb::getFileRecordCount()
 {
+    AllocScope allocScope(AllocStats::JournalPhase);
     if( !checkConnect() )
         return 0;
 
@@ -326,6 +639,7 @@ int SyncJournalDb::getFileRecordCount()
 
 SyncJournalDb::DownloadInfo SyncJournalDb::getDownloadInfo(const QString& file)
 {
+    AllocScope allocScope(AllocStats::JournalPhase);
     QMutexLocker locker(&_mutex);
 
     DownloadInfo res;
@@ -354,11 +668,23 @@ SyncJournalDb::DownloadInfo SyncJournalDb::getDownloadInfo(const QString& file)
 
 void SyncJournalDb::setDownloadInfo(const QString& file, const SyncJournalDb::DownloadInfo& i)
 {
+    AllocScope allocScope(AllocStats::JournalPhase);
     QMutexLocker locker(&_mutex);
 
     if( !checkConnect() )
         return;
 
+    // failed transfers count for the directories above
+    RollupDeltas deltas;
+    if( !_db.transaction() ) {
+        qWarning() << "Failed to start a transaction:" << _db.lastError().text();
+        return;
+    }
+    if( !addTransferErrors(deltas, QLatin1String("downloadinfo"), file, i._valid ? i._errorCount : 0) ) {
+        _db.rollback();
+        return;
+    }
+
     if (i._valid) {
 
         QSqlQuery writeQuery( "INSERT OR REPLACE INTO downloadinfo "
@@ -372,6 +698,7 @@ void SyncJournalDb::setDownloadInfo(const QString& file, const SyncJournalDb::Do
 
         if( !writeQuery.exec() ) {
             qWarning() << "Exec error of SQL statement: " << writeQuery.lastQuery() <<  " :"   << writeQuery.lastError().text();
+            _db.rollback();
             return;
         }
 
@@ -382,14 +709,21 @@ void SyncJournalDb::setDownloadInfo(const QString& file, const SyncJournalDb::Do
 
         if( !query.exec() ) {
             qWarning() << "Exec error of SQL statement: " << query.lastQuery() <<  " : " << query.lastError().text();
+            _db.rollback();
             return;
         }
         qDebug() <<  query.executedQuery()  << file;
     }
+
+    if( !applyRollupDeltas(deltas) || !_db.commit() ) {
+        qWarning() << "Failed to store the transfer info:" << _db.lastError().text();
+        _db.rollback();
+    }
 }
 
 SyncJournalDb::UploadInfo SyncJournalDb::getUploadInfo(const QString& file)
 {
+    AllocScope allocScope(AllocStats::JournalPhase);
     QMutexLocker locker(&_mutex);
 
     UploadInfo res;
@@ -420,11 +754,23 @@ SyncJournalDb::UploadInfo SyncJournalDb::getUploadInfo(const QString& file)
 
 void SyncJournalDb::setUploadInfo(const QString& file, const SyncJournalDb::UploadInfo& i)
 {
+    AllocScope allocScope(AllocStats::JournalPhase);
     QMutexLocker locker(&_mutex);
 
     if( !checkConnect() )
         return;
 
+    // failed transfers count for the directories above
+    RollupDeltas deltas;
+    if( !_db.transaction() ) {
+        qWarning() << "Failed to start a transaction:" << _db.lastError().text();
+        return;
+    }
+    if( !addTransferErrors(deltas, QLatin1String("uploadinfo"), file, i._valid ? i._errorCount : 0) ) {
+        _db.rollback();
+        return;
+    }
+
     if (i._valid) {
 
         QSqlQuery writeQuery( "INSERT OR REPLACE INTO uploadinfo "
@@ -440,6 +786,7 @@ void SyncJournalDb::setUploadInfo(const QString& file, const SyncJournalDb::Uplo
 
         if( !writeQuery.exec() ) {
             qWarning() << "Exec error of SQL statement: " << writeQuery.lastQuery() <<  " :"   << writeQuery.lastError().text();
+            _db.rollback();
             return;
         }
 
@@ -450,10 +797,16 @@ void SyncJournalDb::setUploadInfo(const QString& file, const SyncJournalDb::Uplo
 
         if( !query.exec() ) {
             qWarning() << "Exec error of SQL statement: " << query.lastQuery() <<  " : " << query.lastError().text();
+            _db.rollback();
             return;
         }
         qDebug() <<  query.executedQuery() << file;
     }
+
+    if( !applyRollupDeltas(deltas) || !_db.commit() ) {
+        qWarning() << "Failed to store the transfer info:" << _db.lastError().text();
+        _db.rollback();
+    }
 }
 
 
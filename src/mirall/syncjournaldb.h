@@ -17,6 +17,7 @@
 #include <QObject>
 #include <qmutex.h>
 #include <QDateTime>
+#include <QHash>
 #include <QSqlDatabase>
 
 namespace Mirall {
@@ -29,10 +30,15 @@ public:
     explicit SyncJournalDb(const QString& path, QObject *parent = 0);
     SyncJournalFileRecord getFileRecord( const QString& filename );
     bool setFileRecord( const SyncJournalFileRecord& record );
+    /** Writes all the records in one transaction, either all or none are stored. */
+    bool setFileRecords( const QList<SyncJournalFileRecord>& records );
     bool deleteFileRecord( const QString& filename, bool recursively = false );
     int getFileRecordCount();
     bool exists();
+    QString databaseFilePath();
     QStringList tableColumns( const QString& table );
+    /** The key of a path in the metadata table. */
+    static qint64 getPHash(const QString& );
 
     struct DownloadInfo {
         DownloadInfo() : _errorCount(0), _valid(false) {}
@@ -51,6 +57,21 @@ public:
         bool _valid;
     };
 
+    /**
+     * Totals over all files below a directory, kept up to date by the
+     * record and transfer info setters, so a lookup is a single row.
+     */
+    struct DirectoryRollup {
+        DirectoryRollup() : _size(0), _fileCount(0), _errorCount(0) {}
+        qint64 _size;
+        int _fileCount;
+        QDateTime _newestModtime; // invalid without files
+        int _errorCount; // downloads and uploads that failed and wait for a retry
+    };
+
+    /** The rollup of a directory relative to the sync root, "" is the root. */
+    DirectoryRollup getDirectoryRollup( const QString& dir );
+
     DownloadInfo getDownloadInfo(const QString &file);
     void setDownloadInfo(const QString &file, const DownloadInfo &i);
     UploadInfo getUploadInfo(const QString &file);
@@ -61,8 +82,26 @@ signals:
 public slots:
 
 private:
-    qint64 getPHash(const QString& ) const;
     bool updateDatabaseStructure();
+    bool writeFileRecord( const SyncJournalFileRecord& record );
+
+    // what changes for the directories above a file
+    struct RollupDelta {
+        RollupDelta() : _size(0), _fileCount(0), _errorCount(0), _addedModtime(0), _removedModtime(0) {}
+        qint64 _size;
+        int _fileCount;
+        int _errorCount;
+        qint64 _addedModtime;
+        qint64 _removedModtime;
+    };
+    typedef QHash<QString, RollupDelta> RollupDeltas;
+
+    static void addRollupDelta( RollupDeltas& deltas, const QString& path, const RollupDelta& delta );
+    bool addRemovedFiles( RollupDeltas& deltas, const QString& where, const QString& bound );
+    bool applyRollupDeltas( const RollupDeltas& deltas );
+    qint64 newestModtimeBelow( const QString& dir );
+    bool addTransferErrors( RollupDeltas& deltas, const QString& table, const QString& file, int errorCount );
+    bool rebuildDirectoryRollups();
 
     bool checkConnect();
     QSqlDatabase _db;
@@ -31,10 +31,10 @@ public:
         return !_path.isEmpty();
     }
 
-    // query("SELECT path, inode, uid, gid, mode, modtime, type, md5 FROM metadata WHERE phash=:phash");
+    // query("SELECT path, inode, uid, gid, mode, modtime, type, md5, fileid, filesize FROM metadata WHERE phash=:phash");
 
     QString   _path;
-    int       _inode;
+    quint64   _inode;
     int       _uid;
     int       _gid;
     int       _mode;
@@ -42,6 +42,7 @@ public:
     int       _type;
     QString   _etag;
     QString   _fileId;
+    quint64   _fileSize;
 };
 
 }
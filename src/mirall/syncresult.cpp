@@ -141,6 +141,16 @@ QString SyncResult::folder() const
     return _folder;
 }
 
+void SyncResult::setAllocationCounts( const AllocCounts& counts )
+{
+    _allocationCounts = counts;
+}
+
+AllocCounts SyncResult::allocationCounts() const
+{
+    return _allocationCounts;
+}
+
 SyncResult::~SyncResult()
 {
 
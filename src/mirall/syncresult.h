@@ -20,6 +20,7 @@
 #include <QDateTime>
 
 #include "mirall/syncfileitem.h"
+#include "mirall/allocstats.h"
 
 namespace Mirall
 {
@@ -63,11 +64,16 @@ public:
     void setFolder(const QString& folder);
     QString folder() const;
 
+    // heap allocations of the run per phase, empty unless built WITH_ALLOC_STATS
+    void setAllocationCounts( const AllocCounts& counts );
+    AllocCounts allocationCounts() const;
+
 private:
     Status             _status;
     SyncFileItemVector _syncItems;
     QDateTime          _syncTime;
     QString            _folder;
+    AllocCounts        _allocationCounts;
     /**
      * when the sync tool support this...
      */
@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/synctrace.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QRegExp>
+
+namespace Mirall {
+
+static const char traceHeaderC[] = "# mirall sync trace 1";
+// characters of the name hash that make a token
+static const int tokenLength = 8;
+
+static const char *opName(SyncTrace::Op op)
+{
+    switch (op) {
+    case SyncTrace::MakeDir: return "mkdir";
+    case SyncTrace::Put:     return "put";
+    case SyncTrace::Remove:  return "rm";
+    case SyncTrace::Move:    return "mv";
+    }
+    return "";
+}
+
+QByteArray SyncTrace::formatChange(const Change &change)
+{
+    QByteArray line = change.side == Local ? "L " : "R ";
+    line += QByteArray::number(change.msec) + ' ' + opName(change.op) + ' ' + change.path.toUtf8();
+    if (change.op == Put) {
+        line += ' ' + QByteArray::number(change.size);
+    } else if (change.op == Move) {
+        line += ' ' + change.target.toUtf8();
+    }
+    return line;
+}
+
+bool SyncTrace::load(const QString &fileName)
+{
+    dirs.clear();
+    files.clear();
+    syncs.clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        _errorString = file.errorString();
+        return false;
+    }
+    if (file.readLine().trimmed() != traceHeaderC) {
+        _errorString = QLatin1String("not a sync trace");
+        return false;
+    }
+
+    Sync pending;
+    int lineNo = 1;
+    while (!file.atEnd()) {
+        ++lineNo;
+        const QList<QByteArray> fields = file.readLine().trimmed().split(' ');
+        const QByteArray kind = fields.first();
+        bool ok = true;
+        if (kind.isEmpty() || kind.startsWith('#')) {
+            continue;
+        } else if (kind == "D" && fields.size() == 2) {
+            dirs.append(QString::fromUtf8(fields.at(1)));
+        } else if (kind == "F" && fields.size() == 3) {
+            files.insert(QString::fromUtf8(fields.at(1)), fields.at(2).toLongLong(&ok));
+        } else if (kind == "S" && fields.size() == 2) {
+            pending.msec = fields.at(1).toLongLong(&ok);
+            syncs.append(pending);
+            pending = Sync();
+        } else if ((kind == "L" || kind == "R") && fields.size() >= 4) {
+            Change change;
+            change.side = kind == "L" ? Local : Remote;
+            change.msec = fields.at(1).toLongLong(&ok);
+            change.path = QString::fromUtf8(fields.at(3));
+            const QByteArray op = fields.at(2);
+            if (op == "mkdir" && fields.size() == 4) {
+                change.op = MakeDir;
+            } else if (op == "put" && fields.size() == 5) {
+                change.op = Put;
+                change.size = fields.at(4).toLongLong(&ok);
+            } else if (op == "rm" && fields.size() == 4) {
+                change.op = Remove;
+            } else if (op == "mv" && fields.size() == 5) {
+                change.op = Move;
+                change.target = QString::fromUtf8(fields.at(4));
+            } else {
+                ok = false;
+            }
+            pending.changes.append(change);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            _errorString = QString::fromLatin1("line %1 can not be parsed").arg(lineNo);
+            return false;
+        }
+    }
+    return true;
+}
+
+SyncTraceRecorder::SyncTraceRecorder(const QString &fileName, const QString &localPath)
+    : _file(fileName),
+      _localPath(QDir::cleanPath(localPath)),
+      _startTime(time(0)),
+      _lastSync(0),
+      _syncStart(0)
+{
+    _clock.start();
+    // never written, the tokens can not be reversed with a dictionary
+    _salt = QCryptographicHash::hash(QByteArray::number(QDateTime::currentMSecsSinceEpoch())
+                                     + QByteArray::number(qrand()) + fileName.toUtf8(),
+                                     QCryptographicHash::Sha1);
+
+    if (!_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "SyncTraceRecorder: can not write" << fileName << _file.errorString();
+        return;
+    }
+    qDebug() << "SyncTraceRecorder: recording" << _localPath << "to" << fileName;
+    _file.write(traceHeaderC);
+    _file.write("\n");
+    writeTree();
+}
+
+QString SyncTraceRecorder::anonymize(const QString &path)
+{
+    QStringList parts = path.split(QLatin1Char('/'), QString::SkipEmptyParts);
+    for (int i = 0; i < parts.size(); ++i) {
+        QString &name = parts[i];
+        QHash<QString, QString>::const_iterator cached = _names.constFind(name);
+        if (cached != _names.constEnd()) {
+            name = cached.value();
+            continue;
+        }
+        const QByteArray hash = QCryptographicHash::hash(_salt + name.toUtf8(), QCryptographicHash::Sha1).toHex();
+        QString token = QLatin1Char('n') + QString::fromLatin1(hash.left(tokenLength));
+        // the extension decides about ignore patterns and the like, keep short plain ones
+        const int dot = name.lastIndexOf(QLatin1Char('.'));
+        if (dot > 0) {
+            const QString ext = name.mid(dot + 1);
+            if (QRegExp(QLatin1String("[A-Za-z0-9]{1,5}")).exactMatch(ext)) {
+                token += QLatin1Char('.') + ext;
+            }
+        }
+        _names.insert(name, token);
+        name = token;
+    }
+    return parts.join(QLatin1String("/"));
+}
+
+void SyncTraceRecorder::writeTree()
+{
+    QStringList dirs;
+    QStringList files;
+    QDirIterator it(_localPath, QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QString relative = it.filePath().mid(_localPath.size() + 1);
+        if (relative.startsWith(QLatin1String(".csync_journal.db"))) {
+            continue;
+        }
+        const QFileInfo info = it.fileInfo();
+        if (info.isDir()) {
+            dirs.append(QLatin1String("D ") + anonymize(relative));
+        } else {
+            files.append(QString::fromLatin1("F %1 %2").arg(anonymize(relative)).arg(info.size()));
+        }
+    }
+    // parents before their children
+    dirs.sort();
+    files.sort();
+    foreach (const QString &line, dirs + files) {
+        _file.write(line.toUtf8() + '\n');
+    }
+    _file.flush();
+}
+
+void SyncTraceRecorder::syncStarted()
+{
+    _syncStart = _clock.elapsed();
+}
+
+void SyncTraceRecorder::write(const SyncTrace::Change &change)
+{
+    _file.write(SyncTrace::formatChange(change) + '\n');
+}
+
+void SyncTraceRecorder::syncFinished(const SyncFileItemVector &items)
+{
+    if (!isOpen()) {
+        return;
+    }
+    foreach (const SyncFileItem &item, items) {
+        SyncTrace::Change change;
+        change.side = item._dir == SyncFileItem::Down ? SyncTrace::Remote : SyncTrace::Local;
+        change.path = anonymize(item._file);
+        change.size = item._size;
+        change.msec = _syncStart;
+
+        switch (item._instruction) {
+        case CSYNC_INSTRUCTION_NEW:
+        case CSYNC_INSTRUCTION_SYNC:
+        case CSYNC_INSTRUCTION_CONFLICT:
+            change.op = item._type == SyncFileItem::Directory ? SyncTrace::MakeDir : SyncTrace::Put;
+            if (item._modtime > 0) {
+                change.msec = qBound(_lastSync, qint64(item._modtime - _startTime) * 1000, _syncStart);
+            }
+            break;
+        case CSYNC_INSTRUCTION_REMOVE:
+            change.op = SyncTrace::Remove;
+            break;
+        case CSYNC_INSTRUCTION_RENAME:
+            change.op = SyncTrace::Move;
+            change.target = anonymize(item._renameTarget);
+            break;
+        default:
+            continue;
+        }
+        if (item._instruction == CSYNC_INSTRUCTION_CONFLICT) {
+            // changed on both sides
+            SyncTrace::Change local = change;
+            local.side = SyncTrace::Local;
+            write(local);
+            change.side = SyncTrace::Remote;
+        }
+        write(change);
+    }
+    _file.write("S " + QByteArray::number(_syncStart) + '\n');
+    _file.flush();
+    _lastSync = _syncStart;
+}
+
+}
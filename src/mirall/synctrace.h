@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_SYNCTRACE_H
+#define MIRALL_SYNCTRACE_H
+
+#include "mirall/syncfileitem.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <time.h>
+
+namespace Mirall {
+
+/**
+ * @brief The workload of a folder over a series of syncs.
+ *
+ * A trace has the tree as it was when the recording started and, for
+ * every sync, the changes it found on either side. It is a text file:
+ *
+ *   # mirall sync trace 1
+ *   D <dir>
+ *   F <file> <size>
+ *   L|R <msec> mkdir|put|rm|mv <path> [<size>|<target>]
+ *   S <msec>
+ *
+ * D and F lines are the tree. L and R lines are local and remote changes,
+ * they belong to the next S line, the sync that found them. The times
+ * are msec from the start of the recording. The names are anonymized,
+ * see SyncTraceRecorder, only the extensions are kept.
+ */
+class SyncTrace
+{
+public:
+    enum Side { Local, Remote };
+    enum Op { MakeDir, Put, Remove, Move };
+
+    struct Change {
+        Change() : side(Local), op(Put), msec(0), size(0) {}
+        Side    side;
+        Op      op;
+        qint64  msec;
+        QString path;
+        QString target;  // of a Move
+        qint64  size;    // of a Put
+    };
+
+    struct Sync {
+        Sync() : msec(0) {}
+        qint64          msec;
+        QVector<Change> changes;
+    };
+
+    QStringList            dirs;
+    QMap<QString, qint64>  files;
+    QVector<Sync>          syncs;
+
+    bool load(const QString &fileName);
+    QString errorString() const { return _errorString; }
+
+    static QByteArray formatChange(const Change &change);
+
+private:
+    QString _errorString;
+};
+
+/**
+ * @brief Writes the SyncTrace of a folder while it syncs.
+ *
+ * Each name in a path is replaced by a hash salted with a random value
+ * that is not written, so the same name is the same token throughout the
+ * trace but can not be looked up. Sizes, the tree shape and the kind of
+ * changes stay as they are.
+ *
+ * A change is timed by its mtime, clamped to the time between the
+ * previous sync and the one that found it. Removals and renames have no
+ * mtime of their own and get the time of the sync.
+ */
+class SyncTraceRecorder
+{
+public:
+    /** Starts the trace with the current tree of localPath. */
+    SyncTraceRecorder(const QString &fileName, const QString &localPath);
+
+    bool isOpen() const { return _file.isOpen(); }
+
+    void syncStarted();
+    void syncFinished(const SyncFileItemVector &items);
+
+    /** the anonymized form of a path relative to the sync root */
+    QString anonymize(const QString &path);
+
+private:
+    void writeTree();
+    void write(const SyncTrace::Change &change);
+
+    QFile         _file;
+    QString       _localPath;
+    QByteArray    _salt;
+    QHash<QString, QString> _names;
+    QElapsedTimer _clock;
+    time_t        _startTime;
+    qint64        _lastSync;
+    qint64        _syncStart;
+};
+
+}
+
+#endif // MIRALL_SYNCTRACE_H
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/tarstreamreader.h"
+
+#include <QObject>
+
+#include <string.h>
+
+namespace Mirall {
+
+static const size_t blockSize = 512;
+// long names and pax headers are small, anything beyond is broken
+static const qint64 maxMetaSize = 64 * 1024;
+
+// octal, or base-256 for big values as GNU tar writes them
+static qint64 parseNumber(const char *field, int len)
+{
+    qint64 value = 0;
+    if( uchar(field[0]) & 0x80 ) {
+        value = uchar(field[0]) & 0x3f;
+        for( int i = 1; i < len; ++i ) {
+            value = (value << 8) | uchar(field[i]);
+        }
+        return value;
+    }
+    int i = 0;
+    while( i < len && field[i] == ' ' ) {
+        ++i;
+    }
+    for( ; i < len && field[i] >= '0' && field[i] <= '7'; ++i ) {
+        value = value * 8 + (field[i] - '0');
+    }
+    return value;
+}
+
+static QString fieldString(const char *field, int len)
+{
+    int n = 0;
+    while( n < len && field[n] ) {
+        ++n;
+    }
+    return QString::fromUtf8(field, n);
+}
+
+static QString cleanName(QString name)
+{
+    while( name.startsWith(QLatin1String("./")) ) {
+        name.remove(0, 2);
+    }
+    while( name.endsWith(QLatin1Char('/')) ) {
+        name.chop(1);
+    }
+    return name;
+}
+
+TarStreamReader::TarStreamReader(Handler *handler)
+    : _handler(handler),
+      _state(Header),
+      _kind(Skipped),
+      _headerFill(0),
+      _remaining(0),
+      _padding(0),
+      _nextName(false),
+      _nextSize(false),
+      _nextMtime(false),
+      _zeroBlocks(0)
+{
+}
+
+bool TarStreamReader::fail(const QString &error)
+{
+    _errorString = error;
+    _state = Failed;
+    return false;
+}
+
+bool TarStreamReader::feed(const char *data, size_t len)
+{
+    while( len > 0 ) {
+        switch( _state ) {
+        case Header: {
+            const size_t n = qMin(len, blockSize - _headerFill);
+            memcpy(_header + _headerFill, data, n);
+            _headerFill += n;
+            data += n;
+            len -= n;
+            if( _headerFill < blockSize ) {
+                break;
+            }
+            _headerFill = 0;
+
+            bool zero = true;
+            for( size_t i = 0; i < blockSize && zero; ++i ) {
+                zero = _header[i] == 0;
+            }
+            if( zero ) {
+                // two zero blocks end the archive
+                if( ++_zeroBlocks >= 2 ) {
+                    _state = End;
+                }
+                break;
+            }
+            _zeroBlocks = 0;
+            if( !parseHeader() ) {
+                return false;
+            }
+            break;
+        }
+        case Data: {
+            const size_t n = size_t(qMin(qint64(len), _remaining));
+            if( _kind == FileData ) {
+                if( !_handler->entryData(data, n) ) {
+                    return fail(QObject::tr("Extracting the archive was stopped."));
+                }
+            } else if( _kind == LongName || _kind == PaxHeader ) {
+                _meta.append(data, int(n));
+            }
+            data += n;
+            len -= n;
+            _remaining -= n;
+            if( _remaining == 0 && !finishData() ) {
+                return false;
+            }
+            break;
+        }
+        case Padding: {
+            const size_t n = qMin(len, _padding);
+            data += n;
+            len -= n;
+            _padding -= n;
+            if( _padding == 0 ) {
+                _state = Header;
+            }
+            break;
+        }
+        case End:
+            // whatever the writer padded the archive with
+            return true;
+        case Failed:
+            return false;
+        }
+    }
+    return _state != Failed;
+}
+
+bool TarStreamReader::parseHeader()
+{
+    if( memcmp(_header + 257, "ustar", 5) != 0 ) {
+        return fail(QObject::tr("The server did not send a tar archive."));
+    }
+
+    // the checksum is computed with the checksum field set to spaces
+    qint64 sum = 0;
+    for( size_t i = 0; i < blockSize; ++i ) {
+        sum += (i >= 148 && i < 156) ? ' ' : uchar(_header[i]);
+    }
+    if( sum != parseNumber(_header + 148, 8) ) {
+        return fail(QObject::tr("The archive is corrupted."));
+    }
+
+    const char type = _header[156];
+    qint64 size = parseNumber(_header + 124, 12);
+
+    if( type == 'L' || type == 'x' ) {
+        if( size > maxMetaSize ) {
+            return fail(QObject::tr("The archive is corrupted."));
+        }
+        _kind = type == 'L' ? LongName : PaxHeader;
+        _meta.clear();
+    } else if( type == '0' || type == '\0' || type == '7' || type == '5' ) {
+        Entry entry;
+        if( _nextName ) {
+            entry.name = _next.name;
+        } else {
+            entry.name = fieldString(_header, 100);
+            // the prefix field only exists in the POSIX flavour
+            if( memcmp(_header + 257, "ustar\0", 6) == 0 && _header[345] ) {
+                entry.name = fieldString(_header + 345, 155) + QLatin1Char('/') + entry.name;
+            }
+        }
+        entry.name = cleanName(entry.name);
+        if( _nextSize ) {
+            size = _next.size;
+        }
+        entry.mtime = _nextMtime ? _next.mtime : time_t(parseNumber(_header + 136, 12));
+        entry.isDirectory = type == '5';
+        entry.size = entry.isDirectory ? 0 : size;
+        _nextName = _nextSize = _nextMtime = false;
+
+        if( !_handler->beginEntry(entry) ) {
+            return fail(QObject::tr("Extracting the archive was stopped."));
+        }
+        _kind = entry.isDirectory ? Skipped : FileData;
+    } else {
+        // links, devices, global pax headers...
+        _kind = Skipped;
+        _nextName = _nextSize = _nextMtime = false;
+    }
+
+    if( size < 0 ) {
+        return fail(QObject::tr("The archive is corrupted."));
+    }
+    _remaining = size;
+    _padding = size_t((blockSize - size % blockSize) % blockSize);
+    _state = Data;
+    if( size == 0 ) {
+        return finishData();
+    }
+    return true;
+}
+
+void TarStreamReader::parsePax()
+{
+    // records are "<length> <key>=<value>\n", the length counts the whole record
+    int pos = 0;
+    while( pos < _meta.size() ) {
+        const int space = _meta.indexOf(' ', pos);
+        if( space < 0 ) {
+            return;
+        }
+        bool ok;
+        const int recordLen = _meta.mid(pos, space - pos).toInt(&ok);
+        if( !ok || recordLen <= 0 || pos + recordLen > _meta.size() ) {
+            return;
+        }
+        const QByteArray record = _meta.mid(space + 1, pos + recordLen - space - 2);
+        const int eq = record.indexOf('=');
+        if( eq > 0 ) {
+            const QByteArray key = record.left(eq);
+            const QByteArray value = record.mid(eq + 1);
+            if( key == "path" ) {
+                _next.name = QString::fromUtf8(value);
+                _nextName = true;
+            } else if( key == "size" ) {
+                _next.size = value.toLongLong(&_nextSize);
+            } else if( key == "mtime" ) {
+                // may have a fraction
+                _next.mtime = time_t(value.toDouble(&_nextMtime));
+            }
+        }
+        pos += recordLen;
+    }
+}
+
+bool TarStreamReader::finishData()
+{
+    switch( _kind ) {
+    case FileData:
+        if( !_handler->endEntry() ) {
+            return fail(QObject::tr("Extracting the archive was stopped."));
+        }
+        break;
+    case LongName:
+        _next.name = fieldString(_meta.constData(), _meta.size());
+        _nextName = true;
+        break;
+    case PaxHeader:
+        parsePax();
+        break;
+    case Skipped:
+        break;
+    }
+    _state = _padding > 0 ? Padding : Header;
+    return true;
+}
+
+}
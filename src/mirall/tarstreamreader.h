@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_TARSTREAMREADER_H
+#define MIRALL_TARSTREAMREADER_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <time.h>
+
+namespace Mirall {
+
+/**
+ * @brief Extracts a tar archive while it is being received.
+ *
+ * The data is fed in chunks of any size as it comes from the network,
+ * the entries are passed on to the Handler without buffering the file
+ * contents. Understands ustar, the GNU long names and the path, size and
+ * mtime records of pax headers, which is what archive streamers write.
+ * Entries other than files and directories are skipped.
+ */
+class TarStreamReader
+{
+public:
+    struct Entry {
+        Entry() : size(0), mtime(0), isDirectory(false) {}
+        QString name;       // relative path as in the archive, without a trailing '/'
+        qint64  size;
+        time_t  mtime;
+        bool    isDirectory;
+    };
+
+    /* Files get beginEntry, entryData for each chunk and endEntry,
+     * directories only beginEntry. Return false to stop with an error. */
+    class Handler {
+    public:
+        virtual ~Handler() {}
+        virtual bool beginEntry(const Entry &entry) = 0;
+        virtual bool entryData(const char *data, size_t len) = 0;
+        virtual bool endEntry() = 0;
+    };
+
+    explicit TarStreamReader(Handler *handler);
+
+    /** Feeds the next chunk of the archive. Returns false on an error. */
+    bool feed(const char *data, size_t len);
+
+    /** The end of archive marker was read. */
+    bool atEnd() const { return _state == End; }
+
+    QString errorString() const { return _errorString; }
+
+private:
+    enum State { Header, Data, Padding, End, Failed };
+    enum Kind { FileData, Skipped, LongName, PaxHeader };
+
+    bool parseHeader();
+    void parsePax();
+    bool finishData();
+    bool fail(const QString &error);
+
+    Handler   *_handler;
+    State      _state;
+    Kind       _kind;
+    char       _header[512];
+    size_t     _headerFill;
+    qint64     _remaining;   // bytes of the current entry still to come
+    size_t     _padding;     // bytes up to the next 512 byte boundary
+    QByteArray _meta;        // contents of a long name or pax entry
+    Entry      _next;        // overrides from a long name or pax entry
+    bool       _nextName;
+    bool       _nextSize;
+    bool       _nextMtime;
+    int        _zeroBlocks;
+    QString    _errorString;
+};
+
+}
+
+#endif // MIRALL_TARSTREAMREADER_H
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "mirall/uploadreadahead.h"
+
+#include <QFile>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Mirall {
+
+// files ahead of the current upload that are read
+static const int readAheadFiles = 8;
+// page cache the files ahead may take together
+static const qint64 readAheadBudget = 32 * 1024 * 1024;
+// of larger files only the beginning is read
+static const qint64 readAheadPerFile = 8 * 1024 * 1024;
+
+UploadReadAhead::UploadReadAhead()
+    : _advised(0)
+{
+}
+
+void UploadReadAhead::addFile(const QString &fileName, qint64 size)
+{
+    File file;
+    file.name = fileName;
+    file.size = size;
+    _index.insert(fileName, _files.size());
+    _files.append(file);
+}
+
+void UploadReadAhead::uploadStarted(const QString &fileName)
+{
+    QHash<QString, int>::const_iterator it = _index.constFind(fileName);
+    if (it == _index.constEnd()) {
+        return;
+    }
+    const int current = it.value();
+    _advised = qMax(_advised, current + 1);
+
+    // what was advised before and is still ahead counts against the budget
+    qint64 bytes = 0;
+    for (int i = current + 1; i < _advised; ++i) {
+        bytes += qMin(_files.at(i).size, readAheadPerFile);
+    }
+    while (_advised < _files.size() && _advised - current <= readAheadFiles) {
+        const File &file = _files.at(_advised);
+        const qint64 length = qMin(file.size, readAheadPerFile);
+        if (bytes + length > readAheadBudget) {
+            break;
+        }
+        advise(file.name, length);
+        bytes += length;
+        ++_advised;
+    }
+}
+
+bool UploadReadAhead::advise(const QString &fileName, qint64 length)
+{
+#if defined(Q_OS_UNIX)
+    const int fd = open(QFile::encodeName(fileName).constData(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+#if defined(Q_OS_MAC)
+    struct radvisory advisory;
+    advisory.ra_offset = 0;
+    advisory.ra_count = int(length);
+    const bool ok = fcntl(fd, F_RDADVISE, &advisory) == 0;
+#else
+    // starts the reads and returns, the pages stay cached after the close
+    const bool ok = posix_fadvise(fd, 0, length, POSIX_FADV_WILLNEED) == 0;
+#endif
+    close(fd);
+    return ok;
+#else
+    Q_UNUSED(fileName);
+    Q_UNUSED(length);
+    return false;
+#endif
+}
+
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) by Klaas Freitag <freitag@owncloud.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef MIRALL_UPLOADREADAHEAD_H
+#define MIRALL_UPLOADREADAHEAD_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace Mirall {
+
+/**
+ * @brief Has the kernel read the next upload files while one is sent.
+ *
+ * The uploads run one after the other, each one first waits for the disk
+ * and then for the network. Knowing the files in the order of the jobs,
+ * the read ahead asks the kernel to read the next few of them into the
+ * page cache (posix_fadvise WILLNEED, F_RDADVISE on Mac) as soon as an
+ * upload starts, so their disk time overlaps with the current transfer.
+ *
+ * Bounded in files and bytes, large files only get their beginning read,
+ * the sequential read ahead of the kernel takes over from there. Does
+ * nothing on Windows.
+ */
+class UploadReadAhead
+{
+public:
+    UploadReadAhead();
+
+    /** Appends a file to upload, in the order the jobs run. */
+    void addFile(const QString &fileName, qint64 size);
+
+    /** The upload of the file starts, prefetch the ones after it. */
+    void uploadStarted(const QString &fileName);
+
+    /** Asks the kernel to read the first length bytes of the file. */
+    static bool advise(const QString &fileName, qint64 length);
+
+private:
+    struct File {
+        QString name;
+        qint64  size;
+    };
+
+    QVector<File>      _files;
+    QHash<QString, int> _index;  // file name -> position in _files
+    int                _advised; // the files before were advised
+};
+
+}
+
+#endif // MIRALL_UPLOADREADAHEAD_H
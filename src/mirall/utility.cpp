@@ -37,6 +37,8 @@
 #ifdef Q_OS_UNIX
 #include <sys/statvfs.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
 #include <unistd.h>
 #endif
 
@@ -101,6 +103,16 @@ QString Utility::octetsToString( qint64 octets )
     return (value > 9.95)  ? s.arg(qRound(value)) : s.arg(value, 0, 'g', 2);
 }
 
+QString Utility::durationToString( qint64 seconds )
+{
+    if (seconds >= 3600) {
+        return QCoreApplication::translate("Utility", "%1h %2m").arg(seconds / 3600).arg((seconds % 3600) / 60);
+    } else if (seconds >= 60) {
+        return QCoreApplication::translate("Utility", "%1m %2s").arg(seconds / 60).arg(seconds % 60);
+    }
+    return QCoreApplication::translate("Utility", "%1s").arg(seconds);
+}
+
 // Qtified version of get_platforms() in csync_owncloud.c
 QString Utility::platform()
 {
@@ -161,6 +173,63 @@ void Utility::setLaunchOnStartup(const QString &appName, const QString& guiName,
     setLaunchOnStartup_private(appName, guiName, enable);
 }
 
+bool Utility::isNetworkFileSystem(const QString &path)
+{
+    return isNetworkFileSystem_private(path);
+}
+
+qint64 Utility::userIdleTime()
+{
+    return userIdleTime_private();
+}
+
+qint64 Utility::residentMemory()
+{
+    return residentMemory_private();
+}
+
+int Utility::openFileCount()
+{
+    return openFileCount_private();
+}
+
+int Utility::shutdownConnections(quint16 port)
+{
+#ifdef Q_OS_UNIX
+    // neon does not hand out its socket. shutdown() is safe while another
+    // thread reads from the socket and wakes it up, close() would not.
+    int count = 0;
+    const long maxFd = qMin(sysconf(_SC_OPEN_MAX), 65536L);
+    for( int fd = 0; fd < maxFd; ++fd ) {
+        int type = 0;
+        socklen_t typeLen = sizeof(type);
+        if( getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &typeLen) < 0 || type != SOCK_STREAM ) {
+            continue;
+        }
+        struct sockaddr_storage peer;
+        socklen_t peerLen = sizeof(peer);
+        if( getpeername(fd, reinterpret_cast<struct sockaddr *>(&peer), &peerLen) < 0 ) {
+            continue;
+        }
+        quint16 peerPort;
+        if( peer.ss_family == AF_INET ) {
+            peerPort = ntohs(reinterpret_cast<struct sockaddr_in *>(&peer)->sin_port);
+        } else if( peer.ss_family == AF_INET6 ) {
+            peerPort = ntohs(reinterpret_cast<struct sockaddr_in6 *>(&peer)->sin6_port);
+        } else {
+            continue;
+        }
+        if( peerPort == port && shutdown(fd, SHUT_RDWR) == 0 ) {
+            ++count;
+        }
+    }
+    return count;
+#else
+    Q_UNUSED(port);
+    return 0;
+#endif
+}
+
 qint64 Utility::freeDiskSpace(const QString &path, bool *ok)
 {
 #if defined(Q_OS_MAC) || defined(Q_OS_FREEBSD)
@@ -28,12 +28,27 @@ namespace Utility
     QString formatFingerprint( const QByteArray& );
     void setupFavLink( const QString &folder );
     QString octetsToString( qint64 octets );
+    /** a short human readable form like "2h 5m" */
+    QString durationToString( qint64 seconds );
     QString platform();
     QByteArray userAgentString();
     void raiseDialog(QWidget *);
     bool hasLaunchOnStartup(const QString &appName);
     void setLaunchOnStartup(const QString &appName, const QString& guiName, bool launch);
     qint64 freeDiskSpace(const QString &path, bool *ok = 0);
+    /** true if path is on NFS, SMB or a similar network file system */
+    bool isNetworkFileSystem(const QString &path);
+    /** msec since the last keyboard or mouse input of the user, -1 if unknown */
+    qint64 userIdleTime();
+    /** resident memory of this process in bytes, -1 if unknown */
+    qint64 residentMemory();
+    /** number of open file descriptors or handles of this process, -1 if unknown */
+    int openFileCount();
+    /**
+     * Shuts down the TCP connections of this process to the port, also those
+     * another thread is blocked on. Returns how many, always 0 on Windows.
+     */
+    int shutdownConnections(quint16 port);
     QString toCSyncScheme(const QString &urlStr);
     void showInFileManager(const QString &localPath);
     /** Like QLocale::toString(double, 'f', prec), but drops trailing zeros after the decimal point */
@@ -13,6 +13,10 @@
 
 #include <CoreServices/CoreServices.h>
 #include <CoreFoundation/CoreFoundation.h>
+#include <ApplicationServices/ApplicationServices.h>
+#include <sys/param.h>
+#include <sys/mount.h>
+#include <mach/mach.h>
 
 static void setupFavLink_private(const QString &folder)
 {
@@ -108,3 +112,36 @@ void setLaunchOnStartup_private(const QString &appName, const QString& guiName,
     CFRelease(urlRef);
 }
 
+
+static qint64 userIdleTime_private()
+{
+    const CFTimeInterval secs = CGEventSourceSecondsSinceLastEventType(kCGEventSourceStateCombinedSessionState,
+                                                                       kCGAnyInputEventType);
+    return qint64(secs * 1000);
+}
+
+static qint64 residentMemory_private()
+{
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return -1;
+    }
+    return info.resident_size;
+}
+
+static int openFileCount_private()
+{
+    // includes the descriptor used for listing
+    return QDir(QLatin1String("/dev/fd")).entryList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot).count();
+}
+
+static bool isNetworkFileSystem_private(const QString &path)
+{
+    struct statfs sb;
+    if (statfs(QFile::encodeName(path).constData(), &sb) < 0) {
+        return false;
+    }
+    const QByteArray type(sb.f_fstypename);
+    return type == "nfs" || type == "smbfs" || type == "afpfs" || type == "webdav";
+}
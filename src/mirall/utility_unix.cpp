@@ -12,6 +12,13 @@
  * for more details.
  */
 
+#ifdef Q_OS_LINUX
+#include <sys/vfs.h>
+#else
+#include <sys/param.h>
+#include <sys/mount.h>
+#endif
+
 static void setupFavLink_private(const QString &folder) {
     // Nautilus: add to ~/.gtk-bookmarks
     QFile gtkBookmarks(QDir::homePath()+QLatin1String("/.gtk-bookmarks"));
@@ -67,3 +74,71 @@ void setLaunchOnStartup_private(const QString &appName, const QString& guiName,
         }
     }
 }
+
+static qint64 userIdleTime_private()
+{
+    // the sync library links neither X11 nor D-Bus, unknown.
+    return -1;
+}
+
+static qint64 residentMemory_private()
+{
+#ifdef Q_OS_LINUX
+    QFile statm(QLatin1String("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    // size resident shared ..., in pages
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2) {
+        return -1;
+    }
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+static int openFileCount_private()
+{
+#ifdef Q_OS_LINUX
+    const QDir fds(QLatin1String("/proc/self/fd"));
+#else
+    const QDir fds(QLatin1String("/dev/fd"));
+#endif
+    if (!fds.exists()) {
+        return -1;
+    }
+    // includes the descriptor used for listing
+    return fds.entryList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot).count();
+}
+
+static bool isNetworkFileSystem_private(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    struct statfs sb;
+    if (statfs(QFile::encodeName(path).constData(), &sb) < 0) {
+        return false;
+    }
+    switch (quint32(sb.f_type)) {
+    case 0x6969:     // NFS
+    case 0x517B:     // SMB
+    case 0xFF534D42: // CIFS
+    case 0xFE534D42: // SMB2
+    case 0x564C:     // NCP
+    case 0x5346414F: // AFS
+    case 0x73757245: // CODA
+    case 0x01021997: // 9P
+        return true;
+    default:
+        return false;
+    }
+#else
+    struct statfs sb;
+    if (statfs(QFile::encodeName(path).constData(), &sb) < 0) {
+        return false;
+    }
+    const QByteArray type(sb.f_fstypename);
+    return type == "nfs" || type == "smbfs" || type == "cifs" || type == "afpfs";
+#endif
+}
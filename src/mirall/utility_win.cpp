@@ -47,3 +47,40 @@ void setLaunchOnStartup_private(const QString &appName, const QString& guiName,
         settings.remove(appName);
     }
 }
+
+static qint64 userIdleTime_private()
+{
+    LASTINPUTINFO info;
+    info.cbSize = sizeof(info);
+    if (!GetLastInputInfo(&info)) {
+        return -1;
+    }
+    // both wrap after 49 days, the unsigned difference does not care
+    return DWORD(GetTickCount() - info.dwTime);
+}
+
+static qint64 residentMemory_private()
+{
+    // would need psapi, which the sync library does not link
+    return -1;
+}
+
+static int openFileCount_private()
+{
+    DWORD handles = 0;
+    if (!GetProcessHandleCount(GetCurrentProcess(), &handles)) {
+        return -1;
+    }
+    return handles;
+}
+
+static bool isNetworkFileSystem_private(const QString &path)
+{
+    const QString nativePath = QDir::toNativeSeparators(QDir().absoluteFilePath(path));
+    if (nativePath.startsWith(QLatin1String("\\\\"))) {
+        // UNC path
+        return true;
+    }
+    const QString root = nativePath.left(3); // "C:\"
+    return GetDriveTypeW(reinterpret_cast<const wchar_t *>(root.utf16())) == DRIVE_REMOTE;
+}
@@ -0,0 +1,325 @@
+/*
+   This software is in the public domain, furnished "as is", without technical
+   support, and with no warranty, express or implied, as to its usefulness for
+   any purpose.
+*/
+
+#ifndef MIRALL_DAVSTANDIN_H
+#define MIRALL_DAVSTANDIN_H
+
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <ctime>
+
+/*
+ * Just enough of an ownCloud WebDAV server for csync and the propagator,
+ * kept in memory. Every change gives the item and all its parents a new
+ * etag, like the real server does.
+ */
+class DavStandIn : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Node {
+        Node() : isDir(false), mtime(0) {}
+        bool       isDir;
+        QByteArray data;
+        QByteArray etag;
+        QByteArray fileId;
+        time_t     mtime;
+    };
+
+    DavStandIn() : _lastEtag(0), _lastFileId(0), _propfinds(0) {
+        _nodes.insert(QString(), newNode(true));
+        connect(&_server, SIGNAL(newConnection()), SLOT(slotNewConnection()));
+    }
+
+    bool listen() { return _server.listen(QHostAddress::LocalHost); }
+
+    QString url() const {
+        return QString::fromLatin1("http://127.0.0.1:%1/").arg(_server.serverPort());
+    }
+
+    bool exists(const QString &path) const { return _nodes.contains(path); }
+
+    // listings answered so far
+    int propfindCount() const { return _propfinds; }
+
+    // changes done by another client
+    bool mkdir(const QString &path) {
+        if( _nodes.contains(path) || !isDir(parentOf(path)) ) {
+            return false;
+        }
+        _nodes.insert(path, newNode(true));
+        touch(path);
+        return true;
+    }
+
+    bool put(const QString &path, const QByteArray &data, time_t mtime) {
+        if( !isDir(parentOf(path)) || isDir(path) ) {
+            return false;
+        }
+        if( !_nodes.contains(path) ) {
+            _nodes.insert(path, newNode(false));
+        }
+        _nodes[path].data = data;
+        _nodes[path].mtime = mtime;
+        touch(path);
+        return true;
+    }
+
+    bool remove(const QString &path) {
+        if( path.isEmpty() || !_nodes.contains(path) ) {
+            return false;
+        }
+        foreach( const QString &p, subtree(path) ) {
+            _nodes.remove(p);
+        }
+        touch(parentOf(path));
+        return true;
+    }
+
+    bool move(const QString &from, const QString &to) {
+        if( from.isEmpty() || !_nodes.contains(from) || _nodes.contains(to) || !isDir(parentOf(to))
+            || to.startsWith(from + QLatin1Char('/')) ) {
+            return false;
+        }
+        foreach( const QString &p, subtree(from) ) {
+            _nodes.insert(to + p.mid(from.size()), _nodes.take(p));
+        }
+        touch(parentOf(from));
+        touch(to);
+        return true;
+    }
+
+private slots:
+    void slotNewConnection() {
+        while( QTcpSocket *socket = _server.nextPendingConnection() ) {
+            connect(socket, SIGNAL(readyRead()), SLOT(slotReadyRead()));
+            connect(socket, SIGNAL(disconnected()), SLOT(slotDisconnected()));
+        }
+    }
+
+    // the stand-in runs in the measured process, it must not leak either
+    void slotDisconnected() {
+        QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+        _buffers.remove(socket);
+        socket->deleteLater();
+    }
+
+    void slotReadyRead() {
+        QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+        QByteArray &buffer = _buffers[socket];
+        buffer += socket->readAll();
+
+        // keep-alive, there may be more than one request in the buffer
+        forever {
+            const int headerEnd = buffer.indexOf("\r\n\r\n");
+            if( headerEnd < 0 ) {
+                return;
+            }
+            QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+            const QList<QByteArray> requestLine = lines.takeFirst().trimmed().split(' ');
+            QHash<QByteArray, QByteArray> headers;
+            foreach( const QByteArray &line, lines ) {
+                const int colon = line.indexOf(':');
+                if( colon > 0 ) {
+                    headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+                }
+            }
+            const int length = headers.value("content-length").toInt();
+            if( buffer.size() < headerEnd + 4 + length ) {
+                return;
+            }
+            const QByteArray body = buffer.mid(headerEnd + 4, length);
+            buffer.remove(0, headerEnd + 4 + length);
+            if( requestLine.size() < 2 ) {
+                socket->disconnectFromHost();
+                _buffers.remove(socket);
+                return;
+            }
+            socket->write(handle(requestLine.at(0), requestLine.at(1), headers, body));
+        }
+    }
+
+private:
+    Node newNode(bool dir) {
+        Node node;
+        node.isDir = dir;
+        node.mtime = time(0);
+        node.fileId = QByteArray::number(++_lastFileId).rightJustified(8, '0') + "soak";
+        return node;
+    }
+
+    static QString parentOf(const QString &path) {
+        const int slash = path.lastIndexOf(QLatin1Char('/'));
+        return slash < 0 ? QString() : path.left(slash);
+    }
+
+    bool isDir(const QString &path) const {
+        return _nodes.contains(path) && _nodes.value(path).isDir;
+    }
+
+    QStringList subtree(const QString &path) const {
+        QStringList paths;
+        paths.append(path);
+        const QString prefix = path + QLatin1Char('/');
+        for( QMap<QString, Node>::const_iterator it = _nodes.lowerBound(prefix);
+             it != _nodes.constEnd() && it.key().startsWith(prefix); ++it ) {
+            paths.append(it.key());
+        }
+        return paths;
+    }
+
+    void touch(QString path) {
+        forever {
+            _nodes[path].etag = QByteArray::number(++_lastEtag, 16);
+            if( path.isEmpty() ) {
+                break;
+            }
+            path = parentOf(path);
+        }
+    }
+
+    // "/remote.php/webdav/a%20b/" -> "a b"
+    static QString davPath(const QByteArray &target) {
+        QByteArray path = target;
+        const int dav = path.indexOf("/remote.php/webdav");
+        if( dav >= 0 ) {
+            path = path.mid(dav + 18);
+        }
+        QString decoded = QString::fromUtf8(QByteArray::fromPercentEncoding(path));
+        while( decoded.startsWith(QLatin1Char('/')) ) decoded.remove(0, 1);
+        while( decoded.endsWith(QLatin1Char('/')) ) decoded.chop(1);
+        return decoded;
+    }
+
+    static QByteArray response(int code, const QByteArray &reason, const QByteArray &body = QByteArray(),
+                               const QByteArray &headers = QByteArray(), qint64 length = -1) {
+        QByteArray r = "HTTP/1.1 " + QByteArray::number(code) + ' ' + reason + "\r\n";
+        r += "Content-Length: " + QByteArray::number(length < 0 ? body.size() : length) + "\r\n";
+        r += headers;
+        r += "\r\n";
+        return r + body;
+    }
+
+    QByteArray itemHeaders(const Node &node) const {
+        return "ETag: \"" + node.etag + "\"\r\nOC-FileId: " + node.fileId + "\r\n";
+    }
+
+    QByteArray propResponse(const QString &path, const Node &node) const {
+        QByteArray href = "/remote.php/webdav/" + QUrl::toPercentEncoding(path, "/");
+        if( node.isDir && !path.isEmpty() ) {
+            href += '/';
+        }
+        const QByteArray modified = QLocale::c().toString(QDateTime::fromTime_t(node.mtime).toUTC(),
+                                    QLatin1String("ddd, dd MMM yyyy hh:mm:ss 'GMT'")).toLatin1();
+        QByteArray r = "<d:response><d:href>" + href + "</d:href><d:propstat><d:prop>";
+        r += "<d:getlastmodified>" + modified + "</d:getlastmodified>";
+        r += "<d:getetag>\"" + node.etag + "\"</d:getetag>";
+        r += "<oc:id>" + node.fileId + "</oc:id>";
+        if( node.isDir ) {
+            r += "<d:resourcetype><d:collection/></d:resourcetype>";
+        } else {
+            r += "<d:resourcetype/><d:getcontentlength>" + QByteArray::number(node.data.size()) + "</d:getcontentlength>";
+        }
+        r += "</d:prop><d:status>HTTP/1.1 200 OK</d:status></d:propstat></d:response>";
+        return r;
+    }
+
+    QByteArray handle(const QByteArray &method, const QByteArray &target,
+                      const QHash<QByteArray, QByteArray> &headers, const QByteArray &body) {
+        const QString path = davPath(target);
+
+        if( method == "OPTIONS" ) {
+            return response(200, "OK", QByteArray(), "DAV: 1,2\r\n");
+        }
+        if( method == "MKCOL" ) {
+            if( _nodes.contains(path) ) {
+                return response(405, "Method Not Allowed");
+            }
+            return mkdir(path) ? response(201, "Created") : response(409, "Conflict");
+        }
+        if( method == "PUT" ) {
+            const bool created = !_nodes.contains(path);
+            const QByteArray mtime = headers.value("x-oc-mtime");
+            if( !put(path, body, mtime.isEmpty() ? time(0) : time_t(mtime.toLongLong())) ) {
+                return response(409, "Conflict");
+            }
+            QByteArray extra = itemHeaders(_nodes.value(path));
+            if( !mtime.isEmpty() ) {
+                extra += "X-OC-MTime: accepted\r\n";
+            }
+            return created ? response(201, "Created", QByteArray(), extra)
+                           : response(204, "No Content", QByteArray(), extra);
+        }
+        if( !_nodes.contains(path) ) {
+            return response(404, "Not Found");
+        }
+
+        Node &node = _nodes[path];
+        if( method == "GET" || method == "HEAD" ) {
+            const QByteArray data = node.isDir ? QByteArray() : node.data;
+            return response(200, "OK", method == "GET" ? data : QByteArray(), itemHeaders(node), data.size());
+        }
+        if( method == "DELETE" ) {
+            remove(path);
+            return response(204, "No Content");
+        }
+        if( method == "PROPPATCH" ) {
+            QRegExp lastModified(QLatin1String("lastmodified[^>]*>(\\d+)<"));
+            if( lastModified.indexIn(QString::fromUtf8(body)) >= 0 ) {
+                node.mtime = lastModified.cap(1).toLongLong();
+            }
+            return response(207, "Multi-Status", "<?xml version=\"1.0\"?><d:multistatus xmlns:d=\"DAV:\"/>");
+        }
+        if( method == "MOVE" ) {
+            const QString destination = davPath(headers.value("destination"));
+            if( !isDir(parentOf(destination)) || destination.startsWith(path + QLatin1Char('/')) ) {
+                return response(409, "Conflict");
+            }
+            if( _nodes.contains(destination) ) {
+                if( headers.value("overwrite") == "F" ) {
+                    return response(412, "Precondition Failed");
+                }
+                remove(destination);
+            }
+            move(path, destination);
+            return response(201, "Created");
+        }
+        if( method == "PROPFIND" ) {
+            _propfinds++;
+            const QByteArray depth = headers.value("depth", "infinity");
+            QByteArray xml = "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+                             "<d:multistatus xmlns:d=\"DAV:\" xmlns:oc=\"http://owncloud.org/ns\">";
+            xml += propResponse(path, node);
+            if( depth != "0" && node.isDir ) {
+                foreach( const QString &p, subtree(path) ) {
+                    if( p == path ) {
+                        continue;
+                    }
+                    const QString rest = path.isEmpty() ? p : p.mid(path.size() + 1);
+                    if( depth == "1" && rest.contains(QLatin1Char('/')) ) {
+                        continue;
+                    }
+                    xml += propResponse(p, _nodes.value(p));
+                }
+            }
+            xml += "</d:multistatus>";
+            return response(207, "Multi-Status", xml, "Content-Type: application/xml; charset=utf-8\r\n");
+        }
+        return response(405, "Method Not Allowed");
+    }
+
+    QTcpServer _server;
+    QMap<QString, Node> _nodes;   // by path, the root is ""
+    QHash<QTcpSocket*, QByteArray> _buffers;
+    qint64 _lastEtag;
+    qint64 _lastFileId;
+    int _propfinds;
+};
+
+#endif
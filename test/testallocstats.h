@@ -0,0 +1,70 @@
+/*
+   This software is in the public domain, furnished "as is", without technical
+   support, and with no warranty, express or implied, as to its usefulness for
+   any purpose.
+*/
+
+#ifndef MIRALL_TESTALLOCSTATS_H
+#define MIRALL_TESTALLOCSTATS_H
+
+#include <QtTest>
+
+#include "mirall/allocstats.h"
+#include "mirall/syncresult.h"
+
+using namespace Mirall;
+
+class TestAllocStats : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testReport()
+    {
+        QVERIFY( AllocStats::report(AllocCounts()).isEmpty() );
+
+        AllocCounts counts(AllocStats::PhaseCount);
+        counts[AllocStats::TreeWalkPhase].allocations = 3;
+        counts[AllocStats::TreeWalkPhase].bytes = 100;
+        counts[AllocStats::TreeWalkPhase].frees = 2;
+        const QString report = AllocStats::report(counts);
+        QVERIFY( report.startsWith(QLatin1String("tree walk: 3 allocs, 100 B, 2 frees; job build: 0 allocs")) );
+        QVERIFY( report.contains(QLatin1String("logging: 0 allocs")) );
+    }
+
+    void testSyncResultKeepsCounts()
+    {
+        SyncResult result;
+        QVERIFY( result.allocationCounts().isEmpty() );
+
+        AllocCounts counts(AllocStats::PhaseCount);
+        counts[AllocStats::JournalPhase].allocations = 42;
+        result.setAllocationCounts(counts);
+        QCOMPARE( result.allocationCounts().size(), int(AllocStats::PhaseCount) );
+        QCOMPARE( result.allocationCounts().at(AllocStats::JournalPhase).allocations, qint64(42) );
+    }
+
+    void testCountsPerPhase()
+    {
+        if( !AllocStats::isEnabled() ) {
+            QVERIFY( AllocStats::snapshot().isEmpty() );
+            return; // not built WITH_ALLOC_STATS
+        }
+        AllocStats::reset();
+        {
+            AllocScope scope(AllocStats::JournalPhase);
+            QByteArray data(4096, 'x');
+            QCOMPARE( data.size(), 4096 );
+        }
+        QByteArray outside(4096, 'y');
+        QCOMPARE( outside.size(), 4096 );
+
+        const AllocCounts counts = AllocStats::snapshot();
+        QCOMPARE( counts.size(), int(AllocStats::PhaseCount) );
+        QVERIFY( counts.at(AllocStats::JournalPhase).allocations >= 1 );
+        QVERIFY( counts.at(AllocStats::JournalPhase).bytes >= 4096 );
+        QCOMPARE( counts.at(AllocStats::TreeWalkPhase).allocations, qint64(0) );
+    }
+};
+
+#endif
@@ -0,0 +1,127 @@
+/*
+   This software is in the public domain, furnished "as is", without technical
+   support, and with no warranty, express or implied, as to its usefulness for
+   any purpose.
+*/
+
+#ifndef MIRALL_TESTCONNECTIONVALIDATOR_H
+#define MIRALL_TESTCONNECTIONVALIDATOR_H
+
+#include <QtTest>
+#include <QSettings>
+
+#include "mirall/connectionvalidator.h"
+#include "mirall/fileutils.h"
+#include "mirall/mirallconfigfile.h"
+#include "mirall/theme.h"
+#include "creds/dummycredentials.h"
+
+using namespace Mirall;
+
+// nothing listens there, every check fails right away
+static const char unreachableUrlC[] = "http://127.0.0.1:1/";
+static const int validationTimeoutMsec = 10 * 1000;
+
+class ValidationWaiter : public QObject
+{
+    Q_OBJECT
+
+public:
+    ValidationWaiter() : status(ConnectionValidator::Undefined), optimistic(false), done(false) {}
+
+    ConnectionValidator::Status status;
+    bool optimistic;
+    bool done;
+
+public slots:
+    void slotOptimistic() { optimistic = true; }
+    void slotResult(ConnectionValidator::Status s) { status = s; done = true; }
+};
+
+class TestConnectionValidator : public QObject
+{
+    Q_OBJECT
+
+private:
+    void validate(ValidationWaiter *waiter, bool useCache = true) {
+        ConnectionValidator validator;
+        validator.setUseCachedServerInfo(useCache);
+        connect(&validator, SIGNAL(connectionOptimistic()), waiter, SLOT(slotOptimistic()));
+        connect(&validator, SIGNAL(connectionResult(ConnectionValidator::Status)),
+                waiter, SLOT(slotResult(ConnectionValidator::Status)));
+        validator.checkConnection();
+        QTime timer;
+        timer.start();
+        while( !waiter->done && timer.elapsed() < validationTimeoutMsec ) {
+            QTest::qWait(50);
+        }
+        QVERIFY( waiter->done );
+    }
+
+private slots:
+    void initTestCase()
+    {
+        const QString base = QDir::tempPath() + QLatin1String("/owncloud-validator");
+        FileUtils::removeDir(base);
+        QVERIFY( QDir().mkpath(base) );
+        MirallConfigFile::setConfDir(base);
+        MirallConfigFile cfg;
+        cfg.writeOwncloudConfig(Theme::instance()->appName(), QLatin1String(unreachableUrlC), new DummyCredentials);
+    }
+
+    void testCacheIsPerConnection()
+    {
+        MirallConfigFile cfg;
+        cfg.clearCachedServerVersion();
+        cfg.setCachedServerVersion(QLatin1String("5.0.10"), QLatin1String("other"));
+        QVERIFY( cfg.cachedServerVersion().isEmpty() );
+        QCOMPARE( cfg.cachedServerVersion(QLatin1String("other")), QString::fromLatin1("5.0.10") );
+
+        cfg.setCachedServerVersion(QLatin1String("5.0.11"));
+        QCOMPARE( cfg.cachedServerVersion(), QString::fromLatin1("5.0.11") );
+        QCOMPARE( cfg.cachedServerVersion(cfg.defaultConnection()), QString::fromLatin1("5.0.11") );
+    }
+
+    void testStaleCacheIsNotUsed()
+    {
+        MirallConfigFile cfg;
+        cfg.setCachedServerVersion(QLatin1String("5.0.10"));
+        {
+            QSettings settings(cfg.configFile(), QSettings::IniFormat);
+            settings.beginGroup(cfg.defaultConnection());
+            settings.setValue(QLatin1String("serverVersionChecked"), QDateTime::currentDateTime().addDays(-2));
+        }
+        QVERIFY( cfg.cachedServerVersion().isEmpty() );
+
+        ValidationWaiter waiter;
+        validate(&waiter);
+        QVERIFY( !waiter.optimistic );
+        QVERIFY( waiter.status != ConnectionValidator::Connected );
+    }
+
+    void testFailedCheckClearsCache()
+    {
+        MirallConfigFile cfg;
+        cfg.setCachedServerVersion(QLatin1String("5.0.10"));
+
+        ValidationWaiter waiter;
+        validate(&waiter);
+        QVERIFY( waiter.optimistic );
+        QVERIFY( waiter.status != ConnectionValidator::Connected );
+        // the next start waits for the server again
+        QVERIFY( cfg.cachedServerVersion().isEmpty() );
+    }
+
+    void testRetryDoesNotUseCache()
+    {
+        MirallConfigFile cfg;
+        cfg.setCachedServerVersion(QLatin1String("5.0.10"));
+
+        ValidationWaiter waiter;
+        validate(&waiter, false);
+        QVERIFY( !waiter.optimistic );
+        QVERIFY( waiter.status != ConnectionValidator::Connected );
+    }
+};
+
+#endif
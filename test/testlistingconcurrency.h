@@ -0,0 +1,64 @@
+/*
+   This software is in the public domain, furnished "as is", without technical
+   support, and with no warranty, express or implied, as to its usefulness for
+   any purpose.
+*/
+
+#ifndef MIRALL_TESTLISTINGCONCURRENCY_H
+#define MIRALL_TESTLISTINGCONCURRENCY_H
+
+#include <QtTest>
+
+#include "mirall/listingconcurrency.h"
+
+using namespace Mirall;
+
+class TestListingConcurrency : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testLevelIsBounded()
+    {
+        ListingConcurrency concurrency(20, 1, 8);
+        QCOMPARE(concurrency.level(), 8);
+        concurrency.setLevel(0);
+        QCOMPARE(concurrency.level(), 1);
+    }
+
+    void testFailureHalves()
+    {
+        ListingConcurrency concurrency(8, 1, 8);
+        concurrency.reportFailure();
+        QCOMPARE(concurrency.level(), 4);
+        concurrency.reportFailure();
+        concurrency.reportFailure();
+        concurrency.reportFailure();
+        QCOMPARE(concurrency.level(), 1);
+    }
+
+    void testIncreaseAfterWindow()
+    {
+        ListingConcurrency concurrency(2, 1, 8);
+        // a window is four listings per level
+        for (int i = 0; i < 7; ++i) {
+            concurrency.reportListing(100);
+        }
+        QCOMPARE(concurrency.level(), 2);
+        concurrency.reportListing(100);
+        QCOMPARE(concurrency.level(), 3);
+    }
+
+    void testLatencySpikeDecreases()
+    {
+        ListingConcurrency concurrency(4, 1, 8);
+        concurrency.reportListing(100);
+        concurrency.reportListing(100);
+        QCOMPARE(concurrency.level(), 4);
+        // the smoothed latency goes above three times the best one
+        concurrency.reportListing(2000);
+        QCOMPARE(concurrency.level(), 2);
+    }
+};
+
+#endif
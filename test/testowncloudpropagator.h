@@ -10,19 +10,328 @@
 #include <QtTest>
 
 #include "mirall/owncloudpropagator.h"
+#include "mirall/propagatorarena.h"
+#include "mirall/tarstreamreader.h"
+#include "mirall/pagecachedropper.h"
+#include "mirall/fileiobatch.h"
+#include "mirall/fileutils.h"
+#include "mirall/syncjournaldb.h"
+#include "mirall/syncjournalfilerecord.h"
+#include "mirall/syncfileitem.h"
+
+#include <neon/ne_uri.h>
+
+#ifdef Q_OS_LINUX
+#include <sys/vfs.h>
+#endif
 
 using namespace Mirall;
 
+// collects what the TarStreamReader extracted
+class TarCollector : public TarStreamReader::Handler
+{
+public:
+    QStringList names;
+    QList<QByteArray> contents;
+    QList<time_t> mtimes;
+
+    bool beginEntry(const TarStreamReader::Entry &entry) {
+        names.append(entry.isDirectory ? entry.name + QLatin1Char('/') : entry.name);
+        contents.append(QByteArray());
+        mtimes.append(entry.mtime);
+        return true;
+    }
+    bool entryData(const char *data, size_t len) {
+        contents.last().append(data, int(len));
+        return true;
+    }
+    bool endEntry() { return true; }
+};
+
+static QByteArray tarHeader(const QByteArray &name, qint64 size, char type)
+{
+    QByteArray header(512, '\0');
+    memcpy(header.data(), name.constData(), qMin(name.size(), 100));
+    memcpy(header.data() + 100, "0000644", 7);
+    memcpy(header.data() + 124, QByteArray::number(size, 8).rightJustified(11, '0').constData(), 11);
+    memcpy(header.data() + 136, "12345670123", 11);
+    header[156] = type;
+    memcpy(header.data() + 257, "ustar\0" "00", 8);
+    memset(header.data() + 148, ' ', 8);
+    int sum = 0;
+    for( int i = 0; i < 512; ++i ) {
+        sum += uchar(header[i]);
+    }
+    memcpy(header.data() + 148, QByteArray::number(sum, 8).rightJustified(6, '0').constData(), 6);
+    header[154] = '\0';
+    return header;
+}
+
+static SyncJournalFileRecord journalRecord(const QString &path, quint64 size, time_t mtime,
+                                           int type = SyncFileItem::File)
+{
+    SyncJournalFileRecord rec;
+    rec._path = path;
+    rec._inode = 0;
+    rec._uid = 0;
+    rec._gid = 0;
+    rec._mode = 0;
+    rec._modtime = QDateTime::fromTime_t(mtime);
+    rec._type = type;
+    rec._fileSize = size;
+    return rec;
+}
+
+static QByteArray tarBlocks(QByteArray data)
+{
+    return data.append(QByteArray((512 - data.size() % 512) % 512, '\0'));
+}
+
 class TestOwncloudPropagator : public QObject
 {
     Q_OBJECT
 
+private:
+    static void skip(const char *reason)
+    {
+#if QT_VERSION >= 0x050000
+        QSKIP(reason);
+#else
+        QSKIP(reason, SkipSingle);
+#endif
+    }
+
+    // the journal is closed before the caller removes its directory
+    void checkDirectoryRollup(const QString &dir)
+    {
+        SyncJournalDb journal(dir);
+        QVERIFY( journal.setFileRecord(journalRecord(QLatin1String("a"), 0, 3000, SyncFileItem::Directory)) );
+        QVERIFY( journal.setFileRecord(journalRecord(QLatin1String("a/b/f1"), 10, 1000)) );
+        QVERIFY( journal.setFileRecord(journalRecord(QLatin1String("a/f2"), 20, 2000)) );
+        QVERIFY( journal.setFileRecord(journalRecord(QLatin1String("c/f3"), 5, 500)) );
+
+        SyncJournalDb::DirectoryRollup root = journal.getDirectoryRollup(QString());
+        QCOMPARE( root._size, qint64(35) );
+        QCOMPARE( root._fileCount, 3 );
+        QCOMPARE( root._newestModtime.toTime_t(), uint(2000) );
+        SyncJournalDb::DirectoryRollup a = journal.getDirectoryRollup(QLatin1String("a"));
+        QCOMPARE( a._size, qint64(30) );
+        QCOMPARE( a._fileCount, 2 );
+        QCOMPARE( journal.getDirectoryRollup(QLatin1String("a/b"))._size, qint64(10) );
+
+        // the newest file gets older, the newest time is looked up again
+        QVERIFY( journal.setFileRecord(journalRecord(QLatin1String("a/f2"), 25, 1500)) );
+        a = journal.getDirectoryRollup(QLatin1String("a"));
+        QCOMPARE( a._size, qint64(35) );
+        QCOMPARE( a._newestModtime.toTime_t(), uint(1500) );
+
+        // the newest file is edited again, newer and with the same mtime
+        QVERIFY( journal.setFileRecord(journalRecord(QLatin1String("a/f2"), 30, 1800)) );
+        a = journal.getDirectoryRollup(QLatin1String("a"));
+        QCOMPARE( a._size, qint64(40) );
+        QCOMPARE( a._newestModtime.toTime_t(), uint(1800) );
+        QCOMPARE( journal.getDirectoryRollup(QString())._newestModtime.toTime_t(), uint(1800) );
+        QVERIFY( journal.setFileRecord(journalRecord(QLatin1String("a/f2"), 35, 1800)) );
+        a = journal.getDirectoryRollup(QLatin1String("a"));
+        QCOMPARE( a._size, qint64(45) );
+        QCOMPARE( a._newestModtime.toTime_t(), uint(1800) );
+
+        QVERIFY( journal.deleteFileRecord(QLatin1String("a/b/f1"), true) );
+        QCOMPARE( journal.getDirectoryRollup(QLatin1String("a/b"))._fileCount, 0 );
+        QVERIFY( !journal.getDirectoryRollup(QLatin1String("a/b"))._newestModtime.isValid() );
+        QCOMPARE( journal.getDirectoryRollup(QLatin1String("a"))._fileCount, 1 );
+
+        SyncJournalDb::UploadInfo upload;
+        upload._valid = true;
+        upload._errorCount = 2;
+        journal.setUploadInfo(QLatin1String("c/f3"), upload);
+        upload._errorCount = 3;
+        journal.setUploadInfo(QLatin1String("c/f3"), upload);
+        QCOMPARE( journal.getDirectoryRollup(QLatin1String("c"))._errorCount, 1 );
+        QCOMPARE( journal.getDirectoryRollup(QString())._errorCount, 1 );
+        journal.setUploadInfo(QLatin1String("c/f3"), SyncJournalDb::UploadInfo());
+        QCOMPARE( journal.getDirectoryRollup(QString())._errorCount, 0 );
+
+        // without recursively, the records below go
+        QVERIFY( journal.deleteFileRecord(QLatin1String("a")) );
+        QCOMPARE( journal.getDirectoryRollup(QLatin1String("a"))._fileCount, 0 );
+        root = journal.getDirectoryRollup(QString());
+        QCOMPARE( root._size, qint64(5) );
+        QCOMPARE( root._fileCount, 1 );
+        QCOMPARE( root._newestModtime.toTime_t(), uint(500) );
+    }
+
 private slots:
     void testUpdateErrorFromSession()
     {
 //        OwncloudPropagator propagator( NULL, QLatin1String("test1"), QLatin1String("test2"), new ProgressDatabase);
         QVERIFY( true );
     }
+
+    void testArenaEscapedPath()
+    {
+        PropagatorArena arena(64);
+        const QString dir = QLatin1String("/remote.php/webdav/");
+        QStringList files;
+        files << QLatin1String("plain.txt")
+              << QLatin1String("with space/and#hash?.txt")
+              << QString::fromUtf8("Ümläute/日本語.txt")
+              << (QLatin1String("surrogate") + QChar(0xd83d) + QChar(0xde00));
+
+        foreach( const QString& file, files ) {
+            const char *escaped = arena.escapedPath(dir, file);
+            QScopedPointer<char, QScopedPointerPodDeleter> unescaped(ne_path_unescape(escaped));
+            QCOMPARE( QByteArray(unescaped.data()), (dir + file).toUtf8() );
+            QVERIFY( !QByteArray(escaped).contains(' ') );
+        }
+        QCOMPARE( QByteArray(arena.number(1234567890123LL)), QByteArray("1234567890123") );
+        QCOMPARE( QByteArray(arena.quoted("abc")), QByteArray("\"abc\"") );
+
+        // after a reset the same memory is handed out again.
+        arena.reset();
+        QCOMPARE( arena.bytesUsed(), size_t(0) );
+        const char *first = arena.escapedPath(dir, files.first());
+        arena.reset();
+        QCOMPARE( arena.escapedPath(dir, files.first()), first );
+    }
+
+    void testTarStreamReader()
+    {
+        const QByteArray longName = "dir/" + QByteArray(150, 'x') + ".txt";
+        QByteArray archive;
+        archive += tarHeader("./dir/", 0, '5');
+        archive += tarHeader("dir/hello.txt", 5, '0') + tarBlocks("hello");
+        archive += tarHeader("dir/empty", 0, '0');
+        archive += tarHeader("././@LongLink", longName.size() + 1, 'L') + tarBlocks(longName + '\0');
+        archive += tarHeader("dir/truncated-name", 600, '0') + tarBlocks(QByteArray(600, 'y'));
+        archive += tarHeader("dir/link", 0, '2');
+        archive += QByteArray(1024, '\0');
+
+        // the network hands out the data in chunks of any size
+        TarCollector collector;
+        TarStreamReader reader(&collector);
+        for( int i = 0; i < archive.size(); i += 7 ) {
+            QVERIFY( reader.feed(archive.constData() + i, qMin(7, archive.size() - i)) );
+        }
+        QVERIFY( reader.atEnd() );
+
+        QCOMPARE( collector.names, QStringList() << QLatin1String("dir/") << QLatin1String("dir/hello.txt")
+                  << QLatin1String("dir/empty") << QString::fromLatin1(longName) );
+        QCOMPARE( collector.contents.at(1), QByteArray("hello") );
+        QVERIFY( collector.contents.at(2).isEmpty() );
+        QCOMPARE( collector.contents.at(3), QByteArray(600, 'y') );
+        QCOMPARE( collector.mtimes.at(1), time_t(012345670123LL) );
+
+        // a zip or an error page is refused.
+        TarCollector other;
+        TarStreamReader zip(&other);
+        QByteArray notTar(512, 'P');
+        QVERIFY( !zip.feed(notTar.constData(), notTar.size()) );
+        QVERIFY( !zip.errorString().isEmpty() );
+    }
+
+    void testDirectoryRollup()
+    {
+        const QString dir = QDir::tempPath() + QLatin1String("/owncloud-rollup");
+        // a failed run leaves its journal behind
+        FileUtils::removeDir(dir);
+        QVERIFY( QDir().mkpath(dir) );
+        // the journal opens the file csync created, an empty one will do
+        QFile dbFile(dir + QLatin1String("/.csync_journal.db"));
+        QVERIFY( dbFile.open(QIODevice::WriteOnly | QIODevice::Truncate) );
+        dbFile.close();
+
+        checkDirectoryRollup(dir);
+        FileUtils::removeDir(dir);
+    }
+
+    // how much of a large download stays in the page cache, buffered and with drop behind
+    void benchmarkPageCacheResidency()
+    {
+        const qint64 size = 64 * 1024 * 1024;
+        QVERIFY( PageCacheDropper::isLarge(size) );
+
+        // the build directory, /tmp is often a tmpfs which has nothing to drop
+        const QString pattern = QDir::currentPath() + QLatin1String("/pagecache-XXXXXX");
+        QTemporaryFile buffered(pattern);
+        QTemporaryFile dropped(pattern);
+        QVERIFY( buffered.open() );
+        QVERIFY( dropped.open() );
+#ifdef Q_OS_LINUX
+        struct statfs fs;
+        if( statfs(QFile::encodeName(dropped.fileName()).constData(), &fs) == 0
+                && fs.f_type == 0x01021994 /* TMPFS_MAGIC */ ) {
+            skip("the page cache of a tmpfs can not be dropped");
+            return;
+        }
+#endif
+        const QByteArray block(64 * 1024, 'x');
+
+        for( qint64 written = 0; written < size; written += block.size() ) {
+            QCOMPARE( buffered.write(block), qint64(block.size()) );
+        }
+        buffered.flush();
+
+        QBENCHMARK_ONCE {
+            PageCacheDropper dropper(&dropped, PageCacheDropper::Writing);
+            for( qint64 written = 0; written < size; written += block.size() ) {
+                QCOMPARE( dropped.write(block), qint64(block.size()) );
+                dropper.advance(dropped.pos());
+            }
+            dropped.flush();
+            dropper.finish();
+        }
+
+        const qint64 baseline = PageCacheDropper::residentBytes(buffered.fileName());
+        const qint64 resident = PageCacheDropper::residentBytes(dropped.fileName());
+        if( baseline < 0 || resident < 0 ) {
+            skip("the page cache residency can not be queried here");
+            return;
+        }
+        qDebug() << "resident after writing" << size / 1024 << "KiB: buffered" << baseline / 1024
+                 << "KiB, drop behind" << resident / 1024 << "KiB";
+        if( baseline < size / 2 ) {
+            skip("the buffered file was evicted already, no baseline to compare with");
+            return;
+        }
+        QVERIFY( resident < size / 10 );
+    }
+
+    // removing a tree of small files, one unlink syscall per file or batched
+    void benchmarkFileIoBatchUnlink_data()
+    {
+        QTest::addColumn<int>("backend");
+        QTest::newRow("syscalls") << int(FileIoBatch::Syscalls);
+        QTest::newRow("batched") << int(FileIoBatch::Automatic);
+    }
+
+    void benchmarkFileIoBatchUnlink()
+    {
+        QFETCH(int, backend);
+        const int files = 10000;
+        const QString dir = QDir::tempPath() + QLatin1String("/fileiobatch-benchmark");
+        // a failed run leaves its files behind
+        FileUtils::removeDir(dir);
+        QVERIFY( QDir().mkpath(dir) );
+
+        for( int i = 0; i < files; ++i ) {
+            QFile f(dir + QString::fromLatin1("/file%1").arg(i));
+            QVERIFY( f.open(QIODevice::WriteOnly) );
+            f.write("x");
+        }
+
+        FileIoBatch batch(64, FileIoBatch::Backend(backend));
+        QBENCHMARK_ONCE {
+            for( int i = 0; i < files; ++i ) {
+                batch.unlink(dir + QString::fromLatin1("/file%1").arg(i));
+            }
+            QCOMPARE( batch.submit(), 0 );
+        }
+        qDebug() << "io_uring:" << batch.usesIoUring();
+        const bool empty = QDir().rmdir(dir);
+        FileUtils::removeDir(dir);
+        QVERIFY( empty );
+    }
 };
 
 #endif
@@ -0,0 +1,65 @@
+/*
+   This software is in the public domain, furnished "as is", without technical
+   support, and with no warranty, express or implied, as to its usefulness for
+   any purpose.
+*/
+
+#ifndef MIRALL_TESTPROGRESSDISPATCHER_H
+#define MIRALL_TESTPROGRESSDISPATCHER_H
+
+#include <QtTest>
+
+#include "mirall/progressdispatcher.h"
+
+using namespace Mirall;
+
+class TestProgressDispatcher : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testFirstSampleIsTakenAsIs()
+    {
+        Progress::TransferRate rate;
+        QCOMPARE(rate.rate(), 0.0);
+        rate.addSample(2000, 1000);
+        QCOMPARE(rate.rate(), 2000.0);
+    }
+
+    void testRateIsSmoothed()
+    {
+        Progress::TransferRate rate(1000);
+        // a single spike must not take over the estimate
+        rate.addSample(11000, 1000);
+        QCOMPARE(rate.rate(), 4000.0);
+        // a steady rate wins in the end
+        for (int i = 0; i < 50; ++i) {
+            rate.addSample(500, 1000);
+        }
+        QVERIFY(qAbs(rate.rate() - 500.0) < 1.0);
+    }
+
+    void testInvalidSamplesAreIgnored()
+    {
+        Progress::TransferRate rate(1000);
+        rate.addSample(1000, 0);
+        rate.addSample(-5, 1000);
+        QCOMPARE(rate.rate(), 1000.0);
+    }
+
+    void testEstimatedTimeLeft()
+    {
+        QCOMPARE(Progress::estimatedTimeLeft(0, 0, 0, 0), qint64(0));
+        QCOMPARE(Progress::estimatedTimeLeft(100, 1000, 1000, 0), qint64(10));
+        QCOMPARE(Progress::estimatedTimeLeft(100, 1000, 0, 10000), qint64(10));
+        // each direction at its own rate
+        QCOMPARE(Progress::estimatedTimeLeft(100, 1000, 1000, 10000), qint64(20));
+        // a needed rate is not known
+        QCOMPARE(Progress::estimatedTimeLeft(0, 1000, 1000, 10000), qint64(-1));
+        QCOMPARE(Progress::estimatedTimeLeft(100, 0, 1000, 10000), qint64(-1));
+        // an unknown rate does not matter if nothing goes that way
+        QCOMPARE(Progress::estimatedTimeLeft(0, 1000, 0, 10000), qint64(10));
+    }
+};
+
+#endif
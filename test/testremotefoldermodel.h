@@ -0,0 +1,144 @@
+/*
+   This software is in the public domain, furnished "as is", without technical
+   support, and with no warranty, express or implied, as to its usefulness for
+   any purpose.
+*/
+
+#ifndef MIRALL_TESTREMOTEFOLDERMODEL_H
+#define MIRALL_TESTREMOTEFOLDERMODEL_H
+
+#include <QtTest>
+
+#include "davstandin.h"
+#include "mirall/remotefoldermodel.h"
+#include "mirall/fileutils.h"
+#include "mirall/mirallconfigfile.h"
+#include "mirall/theme.h"
+#include "creds/dummycredentials.h"
+
+using namespace Mirall;
+
+static const int listingTimeoutMsec = 10 * 1000;
+
+class TestRemoteFolderModel : public QObject
+{
+    Q_OBJECT
+
+private:
+    DavStandIn _server;
+    DavStandIn _otherServer;
+    QString _base;
+
+    void useServer(const DavStandIn &server) {
+        MirallConfigFile cfg;
+        cfg.writeOwncloudConfig(Theme::instance()->appName(), server.url(), new DummyCredentials);
+    }
+
+    bool waitForRows(const RemoteFolderModel &model, const QModelIndex &index, int rows) {
+        QTime timer;
+        timer.start();
+        while( model.rowCount(index) != rows && timer.elapsed() < listingTimeoutMsec ) {
+            QTest::qWait(10);
+        }
+        return model.rowCount(index) == rows;
+    }
+
+    static QModelIndex child(const RemoteFolderModel &model, const QModelIndex &parent, const QString &name) {
+        for( int row = 0; row < model.rowCount(parent); ++row ) {
+            const QModelIndex index = model.index(row, 0, parent);
+            if( index.data().toString() == name ) {
+                return index;
+            }
+        }
+        return QModelIndex();
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY( _server.listen() );
+        QVERIFY( _otherServer.listen() );
+
+        _base = QDir::tempPath() + QLatin1String("/owncloud-remotefoldermodel");
+        FileUtils::removeDir(_base);
+        QVERIFY( QDir().mkpath(_base) );
+        MirallConfigFile::setConfDir(_base);
+
+        // the same steps on both servers, so the etags are the same as well
+        QVERIFY( _server.mkdir(QLatin1String("a")) );
+        QVERIFY( _server.mkdir(QLatin1String("b")) );
+        QVERIFY( _server.mkdir(QLatin1String("a/c")) );
+        QVERIFY( _server.put(QLatin1String("f.txt"), "f", time(0)) );
+
+        QVERIFY( _otherServer.mkdir(QLatin1String("a")) );
+        QVERIFY( _otherServer.mkdir(QLatin1String("b")) );
+        QVERIFY( _otherServer.mkdir(QLatin1String("a/x")) );
+        QVERIFY( _otherServer.put(QLatin1String("f.txt"), "f", time(0)) );
+    }
+
+    void cleanupTestCase()
+    {
+        FileUtils::removeDir(_base);
+    }
+
+    void testListing()
+    {
+        useServer(_server);
+        RemoteFolderModel model;
+        const QModelIndex account = model.accountIndex();
+        QCOMPARE( model.path(account), QString::fromLatin1("/") );
+        QCOMPARE( model.rowCount(account), 0 );
+        QVERIFY( model.hasChildren(account) );
+
+        model.refresh();
+        // only the directories
+        QVERIFY( waitForRows(model, account, 2) );
+        QCOMPARE( model.index(0, 0, account).data().toString(), QString::fromLatin1("a") );
+        QCOMPARE( model.index(1, 0, account).data().toString(), QString::fromLatin1("b") );
+        QCOMPARE( model.parent(model.index(0, 0, account)), account );
+
+        // the children of the account are listed ahead
+        const QModelIndex a = child(model, account, QLatin1String("a"));
+        QVERIFY( waitForRows(model, a, 1) );
+        const QModelIndex c = model.index(0, 0, a);
+        QCOMPARE( c.data(Qt::UserRole).toString(), QString::fromLatin1("a/c") );
+        // an empty directory loses its expand indicator once it is listed
+        const QModelIndex b = child(model, account, QLatin1String("b"));
+        QTime timer;
+        timer.start();
+        while( model.hasChildren(b) && timer.elapsed() < listingTimeoutMsec ) {
+            QTest::qWait(10);
+        }
+        QVERIFY( !model.hasChildren(b) );
+    }
+
+    void testCachedListingIsUsed()
+    {
+        useServer(_server);
+        RemoteFolderModel model;
+        const int listings = _server.propfindCount();
+        model.refresh();
+        const QModelIndex account = model.accountIndex();
+        QVERIFY( waitForRows(model, account, 2) );
+        QVERIFY( waitForRows(model, child(model, account, QLatin1String("a")), 1) );
+        QTest::qWait(100);
+        // nothing changed since testListing, only the account is listed again
+        QCOMPARE( _server.propfindCount() - listings, 1 );
+    }
+
+    void testCacheIsPerAccount()
+    {
+        useServer(_otherServer);
+        RemoteFolderModel model;
+        model.refresh();
+        const QModelIndex account = model.accountIndex();
+        QVERIFY( waitForRows(model, account, 2) );
+        const QModelIndex a = child(model, account, QLatin1String("a"));
+        QVERIFY( waitForRows(model, a, 1) );
+        // "a" has the same etag on both servers, the listing of the first
+        // one must not show up here.
+        QCOMPARE( model.index(0, 0, a).data().toString(), QString::fromLatin1("x") );
+    }
+};
+
+#endif
@@ -0,0 +1,612 @@
+/*
+   This software is in the public domain, furnished "as is", without technical
+   support, and with no warranty, express or implied, as to its usefulness for
+   any purpose.
+*/
+
+#ifndef MIRALL_TESTSOAK_H
+#define MIRALL_TESTSOAK_H
+
+#include <QtTest>
+
+#include "davstandin.h"
+#include "mirall/folder.h"
+#include "mirall/folderman.h"
+#include "mirall/fileutils.h"
+#include "mirall/latencyprobe.h"
+#include "mirall/mirallconfigfile.h"
+#include "mirall/owncloudpropagator.h"
+#include "mirall/syncjournaldb.h"
+#include "mirall/synctrace.h"
+#include "mirall/theme.h"
+#include "mirall/utility.h"
+#include "creds/dummycredentials.h"
+
+#ifndef Q_OS_WIN
+#include <sys/time.h>
+#endif
+
+#include <neon/ne_session.h>
+#include <neon/ne_socket.h>
+
+extern "C" int c_utimes(const char *, const struct timeval *);
+
+using namespace Mirall;
+
+// Runs for a long time with the default cycles, only built with -DWITH_SOAK_TEST=ON.
+
+// the first tenth of the cycles fills caches and the journal, it is not measured
+static const int soakWarmupDivisor = 10;
+static const int soakDefaultCycles = 2000;
+static const int soakSyncTimeoutMsec = 60 * 1000;
+
+// tolerated growth over the measured cycles, from the least squares trend
+static const double maxRssGrowthPerCycle = 2048;     // bytes
+static const double maxFdGrowth = 2;
+static const double maxWatchGrowth = 2;
+static const double maxJournalGrowthPerCycle = 256;  // bytes
+// the syncs at the end may take that much longer than the ones at the start
+static const double maxLatencyRatio = 1.5;
+static const double latencySlackMsec = 50;
+
+// changes made on each side for the latency benchmark
+static const int latencyChanges = 20;
+// the watcher is enabled again two seconds after a sync
+static const int watcherPauseMsec = 2500;
+
+// syncs recorded for the replay benchmark when no trace is given
+static const int traceRecordCycles = 30;
+
+// files uploaded by the propagation benchmark, OWNCLOUD_BENCHMARK_FILES overrides
+static const int propagationDefaultFiles = 100000;
+static const int propagationFilesPerDir = 1000;
+
+/*
+ * Runs the propagator in a thread of its own, like CSyncThread does. The
+ * neon calls block, the stand-in has to answer them from the main thread.
+ */
+class PropagationRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    PropagationRunner(quint16 port, const QString &localDir, const QString &remoteDir,
+                      SyncJournalDb *journal, const SyncFileItemVector &items)
+        : elapsedMsec(0), committed(0), _port(port), _localDir(localDir), _remoteDir(remoteDir),
+          _journal(journal), _items(items), _session(0), _propagator(0) {}
+
+    qint64 elapsedMsec;
+    int committed;
+
+public slots:
+    void run() {
+        ne_sock_init();
+        _session = ne_session_create("http", "127.0.0.1", _port);
+        _propagator = new OwncloudPropagator(_session, _localDir, _remoteDir, _journal, &_abortRequested);
+        _propagator->_downloadLimit = 0;
+        _propagator->_uploadLimit = 0;
+        connect(_propagator, SIGNAL(completed(SyncFileItem)), SLOT(slotCompleted(SyncFileItem)));
+        connect(_propagator, SIGNAL(finished()), SLOT(slotFinished()));
+        committed = 0;
+        _timer.start();
+        _propagator->start(_items);
+    }
+
+private slots:
+    void slotCompleted(const SyncFileItem &item) {
+        if( item._status == SyncFileItem::Success ) {
+            ++committed;
+        }
+    }
+
+    void slotFinished() {
+        elapsedMsec = _timer.elapsed();
+        delete _propagator;
+        _propagator = 0;
+        ne_session_destroy(_session);
+        _session = 0;
+        thread()->quit();
+    }
+
+private:
+    quint16 _port;
+    QString _localDir;
+    QString _remoteDir;
+    SyncJournalDb *_journal;
+    SyncFileItemVector _items;
+    ne_session *_session;
+    OwncloudPropagator *_propagator;
+    QAtomicInt _abortRequested;
+    QElapsedTimer _timer;
+};
+
+// what a long running client looks like after each sync
+struct SoakSample {
+    int    cycle;
+    qint64 rss;
+    int    fds;
+    int    watches;
+    qint64 journalBytes;
+    qint64 latencyMsec;
+};
+
+// least squares slope of the values over their index
+static double growthPerCycle(const QVector<double> &values)
+{
+    const int n = values.size();
+    if( n < 2 ) {
+        return 0;
+    }
+    double sumX = 0, sumY = 0, sumXY = 0, sumXX = 0;
+    for( int i = 0; i < n; ++i ) {
+        sumX += i;
+        sumY += values.at(i);
+        sumXY += i * values.at(i);
+        sumXX += double(i) * i;
+    }
+    return (n * sumXY - sumX * sumY) / (n * sumXX - sumX * sumX);
+}
+
+static double mean(const QVector<double> &values, int from, int count)
+{
+    double sum = 0;
+    for( int i = from; i < from + count; ++i ) {
+        sum += values.at(i);
+    }
+    return count ? sum / count : 0;
+}
+
+class TestSoak : public QObject
+{
+    Q_OBJECT
+
+private:
+    QString _root;        // local sync folder
+    QString _remoteRoot;  // the folder on the stand-in
+    DavStandIn _server;
+
+    void writeLocal(const QString &path, int size) {
+        QFile f(path);
+        QVERIFY( f.open(QIODevice::WriteOnly) );
+        f.write(QByteArray(size, char('a' + qrand() % 26)));
+    }
+
+    // one cycle of what users and other clients do: new, changed, removed
+    // and renamed files on both sides, directories coming and going on the
+    // server. The names come from fixed pools, so the tree stays bounded.
+    void churn(const QString &root, const QString &remoteRoot, int cycle) {
+        for( int i = 0; i < 3; ++i ) {
+            const QString file = QString::fromLatin1("d%1/f%2.txt").arg(qrand() % 10).arg(qrand() % 20);
+            const QFileInfo info(root + file);
+            if( !info.exists() ) {
+                writeLocal(root + file, 1 + qrand() % 4096);
+            } else if( qrand() % 2 ) {
+                writeLocal(root + file, int(info.size()) + 1 + qrand() % 512);
+            } else {
+                QVERIFY( QFile::remove(root + file) );
+            }
+        }
+        if( cycle % 5 == 0 ) {
+            const QString from = QString::fromLatin1("d%1/f%2.txt").arg(qrand() % 10).arg(qrand() % 20);
+            const QString to = QString::fromLatin1("d%1/f%2.txt").arg(qrand() % 10).arg(qrand() % 20);
+            if( QFile::exists(root + from) && !QFile::exists(root + to) ) {
+                QVERIFY( QFile::rename(root + from, root + to) );
+            }
+        }
+
+        // the local side never touches these, no conflicts
+        if( cycle % 3 == 0 ) {
+            const QString file = remoteRoot + QString::fromLatin1("/d%1/r%2.txt").arg(qrand() % 10).arg(qrand() % 10);
+            if( _server.exists(file) && qrand() % 3 == 0 ) {
+                QVERIFY( _server.remove(file) );
+            } else {
+                QVERIFY( _server.put(file, QByteArray(1 + qrand() % 4096, 'r'), time(0)) );
+            }
+        }
+        if( cycle % 10 == 0 ) {
+            const QString dir = remoteRoot + QString::fromLatin1("/d%1/rsub").arg(qrand() % 10);
+            if( _server.exists(dir) ) {
+                QVERIFY( _server.remove(dir) );
+            } else {
+                QVERIFY( _server.mkdir(dir) );
+                QVERIFY( _server.put(dir + QLatin1String("/x.txt"), "x", time(0)) );
+            }
+        }
+    }
+
+    // waits for a sync of the folder that something else starts
+    bool waitForSync(Folder *folder) {
+        QEventLoop loop;
+        QTimer timeout;
+        timeout.setSingleShot(true);
+        connect(folder, SIGNAL(syncFinished(SyncResult)), &loop, SLOT(quit()));
+        connect(&timeout, SIGNAL(timeout()), &loop, SLOT(quit()));
+        timeout.start(soakSyncTimeoutMsec);
+        loop.exec();
+        return timeout.isActive() && folder->syncResult().status() == SyncResult::Success;
+    }
+
+    bool sync(Folder *folder) {
+        QMetaObject::invokeMethod(folder, "startSync", Qt::QueuedConnection, Q_ARG(QStringList, QStringList()));
+        return waitForSync(folder);
+    }
+
+    // creates the missing directories of a remote path
+    bool remoteMkpath(const QString &path) {
+        QString dir;
+        foreach( const QString &part, path.split(QLatin1Char('/'), QString::SkipEmptyParts) ) {
+            dir += (dir.isEmpty() ? QString() : QLatin1String("/")) + part;
+            if( !_server.exists(dir) && !_server.mkdir(dir) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static QString parentPath(const QString &path) {
+        const int slash = path.lastIndexOf(QLatin1Char('/'));
+        return slash < 0 ? QString() : path.left(slash);
+    }
+
+    // the content only tells the writes apart, the mtime is what csync sees
+    static QByteArray replayContent(qint64 size, int serial) {
+        return QByteArray(int(size), char('a' + serial % 26));
+    }
+
+    // applies a change of a trace to the local tree or the stand-in. Returns
+    // false if it does not fit, e.g. the removal of a file below a directory
+    // that is gone already.
+    bool replayChange(const SyncTrace::Change &change, const QString &root, const QString &remoteRoot,
+                      time_t mtime, int serial) {
+        if( change.side == SyncTrace::Local ) {
+            const QString path = root + change.path;
+            switch( change.op ) {
+            case SyncTrace::MakeDir:
+                return QDir().mkpath(path);
+            case SyncTrace::Put: {
+                QDir().mkpath(root + parentPath(change.path));
+                QFile f(path);
+                if( !f.open(QIODevice::WriteOnly) ) {
+                    return false;
+                }
+                f.write(replayContent(change.size, serial));
+                f.close();
+                struct timeval times[2];
+                times[0].tv_sec = times[1].tv_sec = mtime;
+                times[0].tv_usec = times[1].tv_usec = 0;
+                return c_utimes(path.toUtf8().data(), times) == 0;
+            }
+            case SyncTrace::Remove:
+                if( QFileInfo(path).isDir() ) {
+                    return FileUtils::removeDir(path);
+                }
+                return QFile::remove(path);
+            case SyncTrace::Move:
+                QDir().mkpath(root + parentPath(change.target));
+                return QDir().rename(path, root + change.target);
+            }
+            return false;
+        }
+
+        const QString path = remoteRoot + QLatin1Char('/') + change.path;
+        switch( change.op ) {
+        case SyncTrace::MakeDir:
+            return remoteMkpath(path);
+        case SyncTrace::Put:
+            return remoteMkpath(parentPath(path)) && _server.put(path, replayContent(change.size, serial), mtime);
+        case SyncTrace::Remove:
+            return _server.remove(path);
+        case SyncTrace::Move: {
+            const QString target = remoteRoot + QLatin1Char('/') + change.target;
+            return remoteMkpath(parentPath(target)) && _server.move(path, target);
+        }
+        }
+        return false;
+    }
+
+    static bool earlierChange(const SyncTrace::Change &a, const SyncTrace::Change &b) {
+        return a.msec < b.msec;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        qsrand(42);
+        QVERIFY( _server.listen() );
+
+        const QString base = QDir::tempPath() + QLatin1String("/owncloud-soak");
+        FileUtils::removeDir(base);
+        QVERIFY( QDir().mkpath(base + QLatin1String("/config")) );
+        MirallConfigFile::setConfDir(base + QLatin1String("/config"));
+        MirallConfigFile cfg;
+        cfg.writeOwncloudConfig(Theme::instance()->appName(), _server.url(), new DummyCredentials);
+
+        _root = base + QLatin1String("/local/");
+        _remoteRoot = QLatin1String("soak");
+        QVERIFY( _server.mkdir(_remoteRoot) );
+        for( int d = 0; d < 10; ++d ) {
+            // keep.txt is never touched, the folder never becomes empty
+            QVERIFY( QDir().mkpath(_root + QString::fromLatin1("d%1").arg(d)) );
+            writeLocal(_root + QString::fromLatin1("d%1/keep.txt").arg(d), 100);
+        }
+    }
+
+    // from the watcher event or the etag poll to the committed file, through
+    // the FolderMan queue like in the client
+    void benchmarkChangeLatency()
+    {
+        LatencyProbe *probe = LatencyProbe::instance();
+        probe->setEnabled(true);
+        probe->reset();
+
+        const QString alias = QLatin1String("latency");
+        const QString root = QDir::tempPath() + QLatin1String("/owncloud-soak/latency/");
+        QVERIFY( QDir().mkpath(root) );
+        QVERIFY( _server.mkdir(alias) );
+        FolderMan *folderMan = FolderMan::instance();
+        folderMan->addFolderDefinition(alias, root, alias);
+        Folder *folder = folderMan->setupFolderFromConfigFile(alias);
+        QVERIFY( folder );
+        QMetaObject::invokeMethod(folderMan, "slotScheduleSync", Q_ARG(QString, alias));
+        QVERIFY( waitForSync(folder) );
+
+        for( int i = 0; i < latencyChanges; ++i ) {
+            QTest::qWait(watcherPauseMsec);
+            QFile f(root + QString::fromLatin1("local%1.txt").arg(i));
+            QVERIFY( f.open(QIODevice::WriteOnly) );
+            f.write(QByteArray(1024, 'l'));
+            f.close();
+            while( probe->sampleCount(LatencyProbe::LocalChange, LatencyProbe::Total) <= i ) {
+                QVERIFY( waitForSync(folder) );
+            }
+        }
+        for( int i = 0; i < latencyChanges; ++i ) {
+            QVERIFY( _server.put(alias + QString::fromLatin1("/remote%1.txt").arg(i), QByteArray(1024, 'r'), time(0)) );
+            QMetaObject::invokeMethod(folder, "slotPollTimerTimeout");
+            // a sync the watcher started for the downloads does not count
+            while( probe->sampleCount(LatencyProbe::RemoteChange, LatencyProbe::Total) <= i ) {
+                QVERIFY( waitForSync(folder) );
+            }
+        }
+
+        qDebug() << probe->report();
+        QCOMPARE( probe->sampleCount(LatencyProbe::LocalChange, LatencyProbe::Total), latencyChanges );
+        QCOMPARE( probe->sampleCount(LatencyProbe::RemoteChange, LatencyProbe::Total), latencyChanges );
+        for( int s = 0; s < LatencyProbe::StageCount; ++s ) {
+            const LatencyProbe::Stage stage = LatencyProbe::Stage(s);
+            QVERIFY( probe->percentile(LatencyProbe::LocalChange, stage, 50) >= 0 );
+        }
+
+        probe->setEnabled(false);
+        folderMan->slotRemoveFolder(alias);
+    }
+
+    // replays a recorded workload, OWNCLOUD_SYNC_TRACE names the trace. Without
+    // one, a short churn is recorded first. The changes of a sync are applied
+    // in the order of their times, the gaps between them and between the syncs
+    // are not waited for, so every run does the same work.
+    void benchmarkTraceReplay()
+    {
+        const QString base = QDir::tempPath() + QLatin1String("/owncloud-soak/");
+        QString traceFile = QString::fromLocal8Bit(qgetenv("OWNCLOUD_SYNC_TRACE"));
+        if( traceFile.isEmpty() ) {
+            const QString root = base + QLatin1String("record/");
+            const QString remoteRoot = QLatin1String("record");
+            QVERIFY( _server.mkdir(remoteRoot) );
+            for( int d = 0; d < 10; ++d ) {
+                QVERIFY( QDir().mkpath(root + QString::fromLatin1("d%1").arg(d)) );
+                writeLocal(root + QString::fromLatin1("d%1/keep.txt").arg(d), 100);
+            }
+            Folder folder(remoteRoot, root, remoteRoot);
+            QVERIFY( sync(&folder) );
+
+            traceFile = base + QLatin1String("record.trace");
+            SyncTraceRecorder recorder(traceFile, root);
+            QVERIFY( recorder.isOpen() );
+            for( int cycle = 0; cycle < traceRecordCycles; ++cycle ) {
+                churn(root, remoteRoot, cycle);
+                if( QTest::currentTestFailed() ) {
+                    return;
+                }
+                recorder.syncStarted();
+                QVERIFY( sync(&folder) );
+                recorder.syncFinished(folder.syncResult().syncFileItemVector());
+            }
+        }
+
+        SyncTrace trace;
+        QVERIFY2( trace.load(traceFile), qPrintable(trace.errorString()) );
+        QVERIFY( !trace.syncs.isEmpty() );
+
+        // the tree the trace starts with, downloaded by a first sync that is not measured
+        const QString root = base + QLatin1String("replay/");
+        const QString remoteRoot = QLatin1String("replay");
+        QVERIFY( QDir().mkpath(root) );
+        QVERIFY( _server.mkdir(remoteRoot) );
+        const time_t start = time(0) - 24 * 3600;
+        int serial = 0;
+        foreach( const QString &dir, trace.dirs ) {
+            QVERIFY( remoteMkpath(remoteRoot + QLatin1Char('/') + dir) );
+        }
+        QMap<QString, qint64>::const_iterator file = trace.files.constBegin();
+        for( ; file != trace.files.constEnd(); ++file ) {
+            const QString path = remoteRoot + QLatin1Char('/') + file.key();
+            QVERIFY( remoteMkpath(parentPath(path)) );
+            QVERIFY( _server.put(path, replayContent(file.value(), serial), start) );
+            ++serial;
+        }
+        Folder folder(remoteRoot, root, remoteRoot);
+        QVERIFY( sync(&folder) );
+
+        QVector<qint64> syncMsec;
+        int applied = 0;
+        int skipped = 0;
+        QBENCHMARK_ONCE {
+            foreach( const SyncTrace::Sync &s, trace.syncs ) {
+                QVector<SyncTrace::Change> changes = s.changes;
+                qStableSort(changes.begin(), changes.end(), earlierChange);
+                foreach( const SyncTrace::Change &change, changes ) {
+                    // a new mtime for every write, or csync could miss it
+                    ++serial;
+                    if( replayChange(change, root, remoteRoot, start + serial, serial) ) {
+                        ++applied;
+                    } else {
+                        ++skipped;
+                        qDebug() << "replay skipped" << SyncTrace::formatChange(change);
+                    }
+                }
+                QElapsedTimer timer;
+                timer.start();
+                QVERIFY2( sync(&folder), qPrintable(QString::fromLatin1("sync %1 failed").arg(syncMsec.size())) );
+                syncMsec.append(timer.elapsed());
+            }
+        }
+
+        QVector<qint64> sorted = syncMsec;
+        qSort(sorted);
+        qint64 total = 0;
+        foreach( qint64 msec, syncMsec ) {
+            total += msec;
+        }
+        qDebug() << "replayed" << syncMsec.size() << "syncs," << applied << "changes applied," << skipped << "skipped";
+        qDebug() << "sync time total" << total << "ms, p50" << sorted.at(sorted.size() / 2)
+                 << "ms, p90" << sorted.at(sorted.size() * 9 / 10) << "ms, max" << sorted.last() << "ms";
+    }
+
+    // job throughput of the propagator: uploads tiny files into new
+    // directories, without the discovery of a sync around it
+    void benchmarkPropagation()
+    {
+        const int files = qgetenv("OWNCLOUD_BENCHMARK_FILES").isEmpty() ? propagationDefaultFiles
+                                                                        : qgetenv("OWNCLOUD_BENCHMARK_FILES").toInt();
+        const QString root = QDir::tempPath() + QLatin1String("/owncloud-soak/propagation/");
+        const QString remoteRoot = QLatin1String("propagation");
+        QVERIFY( _server.mkdir(remoteRoot) );
+
+        SyncFileItemVector items;
+        const time_t mtime = time(0) - 3600;
+        for( int i = 0; i < files; ++i ) {
+            const QString dir = QString::fromLatin1("d%1").arg(i / propagationFilesPerDir);
+            if( i % propagationFilesPerDir == 0 ) {
+                QVERIFY( QDir().mkpath(root + dir) );
+                SyncFileItem item;
+                item._file = dir;
+                item._isDirectory = true;
+                item._instruction = CSYNC_INSTRUCTION_NEW;
+                item._dir = SyncFileItem::Up;
+                item._modtime = mtime;
+                items.append(item);
+            }
+            SyncFileItem item;
+            item._file = dir + QString::fromLatin1("/file %1.txt").arg(i);
+            item._isDirectory = false;
+            item._instruction = CSYNC_INSTRUCTION_NEW;
+            item._dir = SyncFileItem::Up;
+            item._modtime = mtime;
+            item._size = 1 + i % 64;
+            writeLocal(root + item._file, int(item._size));
+            items.append(item);
+        }
+
+        // the journal opens the file csync would have created, an empty one will do
+        QFile dbFile(root + QLatin1String(".csync_journal.db"));
+        QVERIFY( dbFile.open(QIODevice::WriteOnly | QIODevice::Truncate) );
+        dbFile.close();
+        SyncJournalDb journal(root);
+
+        const QString remoteDir = QUrl(_server.url()).path() + QLatin1String("remote.php/webdav/") + remoteRoot;
+        PropagationRunner runner(QUrl(_server.url()).port(), root, remoteDir, &journal, items);
+        QThread thread;
+        runner.moveToThread(&thread);
+        QEventLoop loop;
+        connect(&thread, SIGNAL(finished()), &loop, SLOT(quit()));
+        thread.start();
+        QBENCHMARK_ONCE {
+            QMetaObject::invokeMethod(&runner, "run", Qt::QueuedConnection);
+            loop.exec();
+        }
+
+        QCOMPARE( runner.committed, items.size() );
+        QVERIFY( _server.exists(remoteRoot + QLatin1String("/d0/file 0.txt")) );
+        qDebug() << files << "files in" << runner.elapsedMsec << "ms,"
+                 << (runner.elapsedMsec ? files * 1000 / runner.elapsedMsec : 0) << "jobs/s";
+        FileUtils::removeDir(root);
+    }
+
+    void testSoak()
+    {
+        const int cycles = qMax(soakWarmupDivisor * 2,
+                                qgetenv("OWNCLOUD_SOAK_CYCLES").isEmpty() ? soakDefaultCycles
+                                                                        : qgetenv("OWNCLOUD_SOAK_CYCLES").toInt());
+        Folder folder(QLatin1String("soak"), _root, _remoteRoot);
+        QVERIFY( sync(&folder) );
+
+        QFile log(QDir::tempPath() + QLatin1String("/owncloud-soak.csv"));
+        QVERIFY( log.open(QIODevice::WriteOnly | QIODevice::Truncate) );
+        log.write("cycle,rss,fds,watches,journal,latency_ms\n");
+
+        QVector<SoakSample> samples;
+        for( int cycle = 0; cycle < cycles; ++cycle ) {
+            churn(_root, _remoteRoot, cycle);
+            if( QTest::currentTestFailed() ) {
+                return;
+            }
+            QElapsedTimer timer;
+            timer.start();
+            QVERIFY2( sync(&folder), qPrintable(QString::fromLatin1("sync %1 failed").arg(cycle)) );
+
+            SoakSample s;
+            s.cycle = cycle;
+            s.latencyMsec = timer.elapsed();
+            s.rss = Utility::residentMemory();
+            s.fds = Utility::openFileCount();
+            s.watches = folder.watchCount();
+            s.journalBytes = QFileInfo(folder.journalDbFile()).size();
+            samples.append(s);
+            log.write(QString::fromLatin1("%1,%2,%3,%4,%5,%6\n").arg(cycle).arg(s.rss).arg(s.fds)
+                      .arg(s.watches).arg(s.journalBytes).arg(s.latencyMsec).toLatin1());
+            if( cycle % 100 == 0 ) {
+                qDebug() << "soak cycle" << cycle << "rss" << s.rss << "fds" << s.fds << "watches" << s.watches
+                         << "journal" << s.journalBytes << "latency" << s.latencyMsec << "ms";
+            }
+        }
+        qDebug() << "soak samples written to" << log.fileName();
+
+        QVector<double> rss, fds, watches, journal, latency;
+        for( int i = cycles / soakWarmupDivisor; i < samples.size(); ++i ) {
+            rss.append(samples.at(i).rss);
+            fds.append(samples.at(i).fds);
+            watches.append(samples.at(i).watches);
+            journal.append(samples.at(i).journalBytes);
+            latency.append(samples.at(i).latencyMsec);
+        }
+        const int measured = latency.size();
+
+        // -1 where the platform can not tell
+        if( samples.last().rss >= 0 ) {
+            const double growth = growthPerCycle(rss);
+            qDebug() << "rss growth per cycle:" << growth << "bytes";
+            QVERIFY2( growth <= maxRssGrowthPerCycle, "resident memory keeps growing" );
+        }
+        if( samples.last().fds >= 0 ) {
+            const double growth = growthPerCycle(fds) * measured;
+            qDebug() << "fd growth:" << growth;
+            QVERIFY2( growth <= maxFdGrowth, "file descriptors leak" );
+        }
+        const double watchGrowth = growthPerCycle(watches) * measured;
+        qDebug() << "watch growth:" << watchGrowth;
+        QVERIFY2( watchGrowth <= maxWatchGrowth, "watches are not removed" );
+
+        const double journalGrowth = growthPerCycle(journal);
+        qDebug() << "journal growth per cycle:" << journalGrowth << "bytes";
+        QVERIFY2( journalGrowth <= maxJournalGrowthPerCycle, "the journal keeps growing" );
+
+        const int tenth = measured / soakWarmupDivisor;
+        const double first = mean(latency, 0, tenth);
+        const double last = mean(latency, measured - tenth, tenth);
+        qDebug() << "sync latency first" << first << "ms, last" << last << "ms";
+        QVERIFY2( last <= first * maxLatencyRatio + latencySlackMsec, "syncs get slower over time" );
+    }
+};
+
+#endif
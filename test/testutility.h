@@ -11,6 +11,13 @@
 
 #include "mirall/utility.h"
 
+#ifndef Q_OS_WIN
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
 using namespace Mirall::Utility;
 
 class TestUtility : public QObject
@@ -53,6 +60,15 @@ private slots:
         QCOMPARE(octetsToString(1024LL*1024*1024*1024), QString("1 TB"));
     }
 
+    void testDurationToString()
+    {
+        QCOMPARE(durationToString(0), QString("0s"));
+        QCOMPARE(durationToString(59), QString("59s"));
+        QCOMPARE(durationToString(60), QString("1m 0s"));
+        QCOMPARE(durationToString(3599), QString("59m 59s"));
+        QCOMPARE(durationToString(3600*2 + 5*60 + 7), QString("2h 5m"));
+    }
+
     void testLaunchOnStartup()
     {
         qsrand(QDateTime::currentDateTime().toTime_t());
@@ -75,6 +91,39 @@ private slots:
         QVERIFY(toCSyncScheme("https://example.com/owncloud/") ==
                               "ownclouds://example.com/owncloud/");
     }
+
+#ifndef Q_OS_WIN
+    void testShutdownConnections()
+    {
+        const int server = socket(AF_INET, SOCK_STREAM, 0);
+        QVERIFY( server >= 0 );
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        QVERIFY( bind(server, (struct sockaddr *)&addr, sizeof(addr)) == 0 );
+        QVERIFY( listen(server, 1) == 0 );
+        socklen_t len = sizeof(addr);
+        QVERIFY( getsockname(server, (struct sockaddr *)&addr, &len) == 0 );
+
+        const int client = socket(AF_INET, SOCK_STREAM, 0);
+        QVERIFY( ::connect(client, (struct sockaddr *)&addr, sizeof(addr)) == 0 );
+        const int accepted = accept(server, 0, 0);
+        QVERIFY( accepted >= 0 );
+
+        // nothing to read yet, a blocking read would wait
+        char c;
+        QCOMPARE( int(recv(client, &c, 1, MSG_DONTWAIT)), -1 );
+        // the listening and the accepted socket have other peers
+        QCOMPARE( shutdownConnections(ntohs(addr.sin_port)), 1 );
+        // end of stream instead of waiting
+        QCOMPARE( int(recv(client, &c, 1, MSG_DONTWAIT)), 0 );
+
+        ::close(accepted);
+        ::close(client);
+        ::close(server);
+    }
+#endif
 };
 
 #endif